@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+ */
+
+#ifndef FLV_MEDIA_C_API_H
+#define FLV_MEDIA_C_API_H
+
+/*
+ * C interface of libflvmedia.
+ *
+ * Functions return 0 on success and -1 on failure unless noted otherwise. Nothing here throws, and all
+ * structs are plain data owned by the caller. Pointers into file data stay valid until the file is closed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define FLV_MEDIA_API __attribute__((visibility("default")))
+#else
+#define FLV_MEDIA_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLV_MEDIA_TAG_AUDIO 8
+#define FLV_MEDIA_TAG_VIDEO 9
+#define FLV_MEDIA_TAG_SCRIPT 18
+
+typedef struct flv_media_file flv_media_file;
+
+typedef struct flv_media_tag {
+    uint8_t type;        /* FLV_MEDIA_TAG_* */
+    uint32_t timestamp;  /* milliseconds */
+    uint64_t offset;     /* of the tag header in the file */
+    const uint8_t *data; /* tag body */
+    size_t size;
+} flv_media_tag;
+
+typedef struct flv_media_packet {
+    uint8_t type; /* FLV_MEDIA_TAG_AUDIO or FLV_MEDIA_TAG_VIDEO */
+    uint8_t key_frame;
+    uint8_t frame_class; /* 0 disposable, 1 referenced B, 2 reference, 3 key */
+    uint32_t dts;        /* milliseconds */
+    uint32_t pts;
+    uint32_t generation; /* changes with the codec configuration */
+    const uint8_t *data; /* Annex-B, OBUs, IVF frame or ADTS, valid during the callback only */
+    size_t size;
+} flv_media_packet;
+
+typedef void (*flv_media_packet_callback)(void *opaque, const flv_media_packet *packet);
+
+typedef struct flv_media_probe_info {
+    uint64_t file_size;
+    uint64_t bytes_read;
+    uint64_t tags;
+    uint32_t duration; /* milliseconds */
+    char video_codec[16];
+    uint32_t width;
+    uint32_t height;
+    double frame_rate;
+    double video_bitrate; /* bits per second */
+    uint64_t key_frames;
+    char audio_codec[16];
+    int32_t sample_rate;
+    int32_t channels;
+    double audio_bitrate;
+} flv_media_probe_info;
+
+/* "major.minor.patch" of the library */
+FLV_MEDIA_API const char *flv_media_version(void);
+
+/* Maps a file, NULL when it can not be opened or is not FLV */
+FLV_MEDIA_API flv_media_file *flv_media_open(const char *path);
+/* Wraps FLV data in memory without copying it, the memory has to outlive the handle */
+FLV_MEDIA_API flv_media_file *flv_media_open_memory(const uint8_t *data, size_t size);
+FLV_MEDIA_API void flv_media_close(flv_media_file *file);
+
+/*
+ * Tag iteration. Start with *cursor = 0; returns 1 and advances the cursor for every tag, 0 at the end of the
+ * data or at a tag that does not fit into it.
+ */
+FLV_MEDIA_API int flv_media_next_tag(const flv_media_file *file, uint64_t *cursor, flv_media_tag *tag);
+
+/* Demuxes the whole file, one callback per audio or video frame */
+FLV_MEDIA_API int flv_media_demux(const flv_media_file *file, flv_media_packet_callback callback, void *opaque);
+
+/* Stream statistics from the tag headers, without mapping the file */
+FLV_MEDIA_API int flv_media_probe(const char *path, flv_media_probe_info *info);
+/* The same as one line of JSON, release it with flv_media_free(); NULL on failure */
+FLV_MEDIA_API char *flv_media_probe_json(const char *path);
+
+FLV_MEDIA_API void flv_media_free(void *pointer);
+
+typedef void (*flv_media_log_callback)(void *opaque, const char *message);
+
+/*
+ * The library prints nothing. With a callback, script data, codec configurations and problems met while opening,
+ * reading or demuxing are passed to it one line at a time, without the newline. Set it before any other call,
+ * NULL stops it. errno is left as the failed call set it.
+ */
+FLV_MEDIA_API void flv_media_set_log_callback(flv_media_log_callback callback, void *opaque);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLV_MEDIA_C_API_H */
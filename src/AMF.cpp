@@ -3,66 +3,81 @@
 //
 
 #include "AMF.h"
+#include "Log.h"
 #include <cassert>
+#include <cstring>
 #include <iomanip>
 #include <netinet/in.h>
 #include <sstream>
 #include <stdexcept>
 
-AMFValue::AMFValue(AMFType type) : type_(type) {}
-
-AMFValue::AMFValue(const char *s) {
-    type_ = AMF_STRING;
-    value_ = new std::string(s);
+AMFValue::AMFValue(AMFType type, const allocator_type &allocator) : type_(AMF_NULL), resource_(allocator.resource()) {
+    Construct(type);
 }
 
-AMFValue::AMFValue(const std::string &s) {
-    type_ = AMF_STRING;
-    value_ = new std::string(s);
-}
+AMFValue::AMFValue(const char *s, const allocator_type &allocator) : AMFValue(std::string_view(s), allocator) {}
 
-AMFValue::AMFValue(double n) {
-    type_ = AMF_NUMBER;
-    value_ = new double(n);
+AMFValue::AMFValue(std::string_view s, const allocator_type &allocator)
+    : type_(AMF_STRING), resource_(allocator.resource()) {
+    new (&string_) String(s, resource_);
 }
 
-AMFValue::AMFValue(int i) {
-    type_ = AMF_NUMBER;
-    value_ = new double((double)i);
+AMFValue::AMFValue(double n) : type_(AMF_NUMBER), resource_(std::pmr::get_default_resource()), number_(n) {}
+
+AMFValue::AMFValue(int i) : AMFValue((double)i) {}
+
+AMFValue::AMFValue(bool b) : type_(AMF_BOOLEAN), resource_(std::pmr::get_default_resource()), boolean_(b) {}
+
+AMFValue::AMFValue(const AMFValue &from, const allocator_type &allocator)
+    : type_(AMF_NULL), resource_(allocator.resource()) {
+    CopyFrom(from);
 }
 
-AMFValue::AMFValue(bool b) {
-    type_ = AMF_BOOLEAN;
-    value_ = new bool(b);
+AMFValue::AMFValue(AMFValue &&from) noexcept : type_(AMF_NULL), resource_(from.resource_) {
+    *this = std::move(from);
 }
 
-AMFValue::AMFValue(const AMFValue &from) : type_(AMF_NULL) {
-    *this = from;
+AMFValue::AMFValue(AMFValue &&from, const allocator_type &allocator)
+    : type_(AMF_NULL), resource_(allocator.resource()) {
+    *this = std::move(from);
 }
 
 AMFValue &AMFValue::operator=(const AMFValue &from) {
+    if (this != &from) {
+        Destroy();
+        CopyFrom(from);
+    }
+    return *this;
+}
+
+/// Steals the contents when both sides share a memory resource, copies otherwise
+AMFValue &AMFValue::operator=(AMFValue &&from) {
     if (this == &from) {
         return *this;
     }
+    if (*resource_ != *from.resource_) {
+        return *this = (const AMFValue &)from;
+    }
 
     Destroy();
     type_ = from.type_;
     switch (type_) {
+        case AMF_NUMBER:
+            number_ = from.number_;
+            break;
+        case AMF_BOOLEAN:
+            boolean_ = from.boolean_;
+            break;
         case AMF_STRING:
-            value_ = new std::string(*(std::string *)from.value_);
+        case AMF_LONG_STRING:
+            new (&string_) String(std::move(from.string_));
             break;
         case AMF_OBJECT:
         case AMF_ECMA_ARRAY:
-            value_ = new ObjectType(*(ObjectType *)from.value_);
+            new (&object_) ObjectType(std::move(from.object_));
             break;
         case AMF_STRICT_ARRAY:
-            value_ = new ArrayType(*(ArrayType *)from.value_);
-            break;
-        case AMF_NUMBER:
-            value_ = new double(*(double *)from.value_);
-            break;
-        case AMF_BOOLEAN:
-            value_ = new bool(*(bool *)from.value_);
+            new (&array_) ArrayType(std::move(from.array_));
             break;
         default:
             break;
@@ -74,156 +89,233 @@ AMFValue::~AMFValue() {
     Destroy();
 }
 
-void AMFValue::Destroy() {
+void AMFValue::Construct(AMFType type) {
+    type_ = type;
+    if (type_ == AMF_OBJECT || type_ == AMF_ECMA_ARRAY) {
+        new (&object_) ObjectType(resource_);
+    } else if (type_ == AMF_STRICT_ARRAY) {
+        new (&array_) ArrayType(resource_);
+    } else if (type_ == AMF_STRING || type_ == AMF_LONG_STRING) {
+        new (&string_) String(resource_);
+    }
+}
+
+void AMFValue::CopyFrom(const AMFValue &from) {
+    type_ = from.type_;
     switch (type_) {
         case AMF_NUMBER:
-            delete (double *)value_;
+            number_ = from.number_;
             break;
         case AMF_BOOLEAN:
-            delete (bool *)value_;
+            boolean_ = from.boolean_;
+            break;
+        case AMF_STRING:
+        case AMF_LONG_STRING:
+            new (&string_) String(from.string_, resource_);
+            break;
+        case AMF_OBJECT:
+        case AMF_ECMA_ARRAY:
+            new (&object_) ObjectType(from.object_, resource_);
             break;
+        case AMF_STRICT_ARRAY:
+            new (&array_) ArrayType(from.array_, resource_);
+            break;
+        default:
+            break;
+    }
+}
+
+void AMFValue::Destroy() {
+    switch (type_) {
         case AMF_STRING:
         case AMF_LONG_STRING:
-            delete (std::string *)value_;
+            string_.~String();
             break;
         case AMF_OBJECT:
         case AMF_ECMA_ARRAY:
-            delete (ObjectType *)value_;
+            object_.~ObjectType();
             break;
         case AMF_STRICT_ARRAY:
-            delete (ArrayType *)value_;
+            array_.~ArrayType();
+            break;
         default:
             break;
     }
-    value_ = nullptr;
+    type_ = AMF_NULL;
 }
 
 AMFType AMFValue::Type() const {
     return type_;
 }
 
-void *AMFValue::GetValue() const {
-    return value_;
+const void *AMFValue::GetValue() const {
+    switch (type_) {
+        case AMF_NUMBER:
+            return &number_;
+        case AMF_BOOLEAN:
+            return &boolean_;
+        case AMF_STRING:
+        case AMF_LONG_STRING:
+            return &string_;
+        case AMF_OBJECT:
+        case AMF_ECMA_ARRAY:
+            return &object_;
+        case AMF_STRICT_ARRAY:
+            return &array_;
+        default:
+            return nullptr;
+    }
+}
+
+void AMFValue::Set(std::string_view key, const AMFValue &val) {
+    Set(key, AMFValue(val, resource_));
 }
 
-void AMFValue::Set(const std::string &s, const AMFValue &val) {
+void AMFValue::Set(std::string_view key, AMFValue &&val) {
     if (type_ != AMF_OBJECT && type_ != AMF_ECMA_ARRAY) {
-        printf("AMF not a object");
+        Log("AMF not a object");
         return;
     }
 
-    if (!value_) {
-        value_ = new ObjectType;
-    }
-    if (value_) {
-        ((ObjectType *)value_)->emplace(s, val);
+    for (auto &item : object_) {
+        if (item.first == key) {
+            item.second = std::move(val);
+            return;
+        }
     }
+    object_.emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::move(val)));
 }
 
 void AMFValue::Add(const AMFValue &val) {
+    Add(AMFValue(val, resource_));
+}
+
+void AMFValue::Add(AMFValue &&val) {
     if (type_ != AMF_STRICT_ARRAY) {
-        printf("AMF not a array");
+        Log("AMF not a array");
         return;
     }
+    array_.push_back(std::move(val));
+}
+
+const AMFValue::String *AMFValue::GetString() const {
+    return type_ == AMF_STRING || type_ == AMF_LONG_STRING ? &string_ : nullptr;
+}
 
-    if (!value_) {
-        value_ = new ArrayType;
+bool AMFValue::GetNumber(double &n) const {
+    if (type_ != AMF_NUMBER) {
+        return false;
     }
-    if (value_) {
-        ((ArrayType *)value_)->push_back(val);
+    n = number_;
+    return true;
+}
+
+bool AMFValue::GetBoolean(bool &b) const {
+    if (type_ != AMF_BOOLEAN) {
+        return false;
     }
+    b = boolean_;
+    return true;
+}
+
+const AMFValue::ObjectType *AMFValue::GetObjectMap() const {
+    return type_ == AMF_OBJECT || type_ == AMF_ECMA_ARRAY ? &object_ : nullptr;
+}
+
+const AMFValue::ArrayType *AMFValue::GetArray() const {
+    return type_ == AMF_STRICT_ARRAY ? &array_ : nullptr;
 }
-const std::string &AMFValue::AsString() const {
-    if (type_ != AMF_STRING || !value_) {
-        throw std::runtime_error("AMF not a string");
+
+const AMFValue::String &AMFValue::AsString() const {
+    if (auto s = GetString()) {
+        return *s;
     }
-    return *(std::string *)value_;
+    throw std::runtime_error("AMF not a string");
 }
 
 double AMFValue::AsNumber() const {
-    if (type_ != AMF_NUMBER || !value_) {
+    double n;
+    if (!GetNumber(n)) {
         throw std::runtime_error("AMF not a number");
     }
-    return *(double *)value_;
+    return n;
 }
 
 bool AMFValue::AsBoolean() const {
-    if (type_ != AMF_BOOLEAN || !value_) {
+    bool b;
+    if (!GetBoolean(b)) {
         throw std::runtime_error("AMF not a boolean");
     }
-    return *(bool *)value_;
+    return b;
 }
 
 const AMFValue::ObjectType &AMFValue::AsObjectMap() const {
-    if (type_ != AMF_OBJECT && type_ != AMF_ECMA_ARRAY || !value_) {
-        throw std::runtime_error("AMF not a object");
+    if (auto object = GetObjectMap()) {
+        return *object;
     }
-
-    return *(ObjectType *)value_;
+    throw std::runtime_error("AMF not a object");
 }
 
-AMFValue AMFValue::operator[](const char *key) const {
-    if (type_ != AMF_OBJECT && type_ != AMF_ECMA_ARRAY) {
-        throw std::runtime_error("AMF not a object");
-    }
-
-    if (!value_) {
-        throw std::runtime_error("AMF data is null");
+const AMFValue &AMFValue::operator[](std::string_view key) const {
+    for (auto &item : AsObjectMap()) {
+        if (item.first == key) {
+            return item.second;
+        }
     }
 
-    auto i = ((ObjectType *)value_)->find(key);
-    if (i == ((ObjectType *)value_)->end()) {
-        static AMFValue val(AMF_NULL);
-        return val;
-    }
-    return i->second;
+    static const AMFValue val(AMF_NULL);
+    return val;
 }
 
 const AMFValue::ArrayType &AMFValue::AsArray() const {
-    if (type_ != AMF_STRICT_ARRAY || !value_) {
-        throw std::runtime_error("AMF not a array");
+    if (auto array = GetArray()) {
+        return *array;
     }
-
-    return *(ArrayType *)value_;
+    throw std::runtime_error("AMF not a array");
 }
 
-std::string AMFValue::Dump() {
+std::string AMFValue::Dump() const {
     std::stringstream ss;
+    Dump(ss);
+    return ss.str();
+}
+
+void AMFValue::Dump(std::ostream &os) const {
     switch (type_) {
         case AMF_NUMBER:
-            ss << (size_t)(*(double *)value_);
+            os << (size_t)number_;
             break;
         case AMF_BOOLEAN:
-            ss << *(bool *)value_;
+            os << boolean_;
             break;
         case AMF_STRING:
         case AMF_LONG_STRING:
-            ss << *(std::string *)value_;
+            os << string_;
             break;
         case AMF_OBJECT:
-        case AMF_ECMA_ARRAY: {
-            auto object = (ObjectType *)value_;
-            for (auto &o : *object) {
-                ss << "\t" << std::left << std::setw(20) << o.first << ": " << o.second.Dump() << "\n";
+        case AMF_ECMA_ARRAY:
+            for (auto &o : object_) {
+                os << "\t" << std::left << std::setw(20) << o.first << ": ";
+                o.second.Dump(os);
+                os << "\n";
             }
-        } break;
+            break;
         case AMF_STRICT_ARRAY:
         default:
             break;
     }
-    return ss.str();
 }
 
 /// AMFEncoder
 AMFEncoder &AMFEncoder::operator<<(const char *s) {
     if (s) {
-        return *this << std::string(s);
+        return *this << std::string_view(s);
     }
     buffer_ += char(AMF_NULL);
     return *this;
 }
 
-AMFEncoder &AMFEncoder::operator<<(const std::string &s) {
+AMFEncoder &AMFEncoder::operator<<(std::string_view s) {
     if (!s.empty()) {
         buffer_ += char(AMF_STRING);
         assert(s.size() <= 0xffff);
@@ -264,13 +356,15 @@ AMFEncoder &AMFEncoder::operator<<(const bool b) {
 AMFEncoder &AMFEncoder::operator<<(const AMFValue &value) {
     switch (value.Type()) {
         case AMF_STRING:
-            *this << *(std::string *)value.GetValue();
+            // a string value stays a string when empty, only bare empty strings are written as null
+            buffer_ += char(AMF_STRING);
+            WriteKay(value.AsString());
             break;
         case AMF_NUMBER:
-            *this << *(double *)value.GetValue();
+            *this << value.AsNumber();
             break;
         case AMF_BOOLEAN:
-            *this << *(bool *)value.GetValue();
+            *this << value.AsBoolean();
             break;
         case AMF_NULL:
             *this << nullptr;
@@ -280,18 +374,18 @@ AMFEncoder &AMFEncoder::operator<<(const AMFValue &value) {
             break;
         case AMF_OBJECT: {
             buffer_ += char(AMF_OBJECT);
-            auto objectMap = *(AMFValue::ObjectType *)value.GetValue();
-            for (auto it = objectMap.rbegin(); it != objectMap.rend(); ++it) {
-                WriteKay(it->first);
-                *this << it->second;
+            auto &objectMap = value.AsObjectMap();
+            for (auto &it : objectMap) {
+                WriteKay(it.first);
+                *this << it.second;
             }
 
             WriteKay("");
             buffer_ += char(AMF_OBJECT_END);
         } break;
         case AMF_ECMA_ARRAY: {
-            buffer_ + char(AMF_ECMA_ARRAY);
-            auto objectMap = *(AMFValue::ObjectType *)value.GetValue();
+            buffer_ += char(AMF_ECMA_ARRAY);
+            auto &objectMap = value.AsObjectMap();
             uint32_t sz = htonl(objectMap.size());
             buffer_.append((char *)&sz, 4);
             for (auto &it : objectMap) {
@@ -303,7 +397,7 @@ AMFEncoder &AMFEncoder::operator<<(const AMFValue &value) {
         } break;
         case AMF_STRICT_ARRAY: {
             buffer_ += char(AMF_STRICT_ARRAY);
-            auto array = *(AMFValue::ArrayType *)value.GetValue();
+            auto &array = value.AsArray();
             uint32_t sz = htonl(array.size());
             buffer_.append((char *)&sz, 4);
             for (auto &val : array) {
@@ -324,73 +418,95 @@ void AMFEncoder::Clear() {
     buffer_.clear();
 }
 
-void AMFEncoder::WriteKay(const std::string &key) {
+void AMFEncoder::WriteKay(std::string_view key) {
     assert(key.size() <= 0xffff);
     buffer_ += char((key.size() >> 8) & 0xff);
     buffer_ += char((key.size() & 0xff));
     buffer_ += key;
 }
 
-/// AMFDecoder
-AMFDecoder::AMFDecoder(const uint8_t *buffer, size_t size, int version)
-    : buffer_(buffer), pos_(0), size_(size), version_(version) {}
-
-uint8_t AMFDecoder::Front() {
-    if (pos_ >= size_) {
-        throw std::runtime_error("Not enough data");
+/// AMFStatus
+const char *AMFStatus::GetErrorName(AMFError error) {
+    switch (error) {
+        case AMF_OK:
+            return "ok";
+        case AMF_ERROR_TRUNCATED:
+            return "AMF data truncated";
+        case AMF_ERROR_UNEXPECTED_TYPE:
+            return "Unexpected AMF type";
+        case AMF_ERROR_UNSUPPORTED_TYPE:
+            return "Unsupported AMF type";
+        case AMF_ERROR_MISSING_OBJECT_END:
+            return "Expected AMF object end";
+        case AMF_ERROR_TOO_DEEP:
+            return "AMF nested too deep";
+        default:
+            return "unknown";
     }
-
-    return buffer_[pos_];
 }
 
-uint8_t AMFDecoder::PopFront() {
-    if (version_ == 0 && Front() == AMF_SWITCH_AMF3) {
-        printf("entering AMF3 mode");
-        pos_++;
-        version_ = 3;
+std::string AMFStatus::ToString() const {
+    if (Ok()) {
+        return GetErrorName(error);
     }
+    return std::string(GetErrorName(error)) + " at offset " + std::to_string(offset);
+}
 
-    if (pos_ >= size_) {
-        printf("Not enough data\n");
-        return 0;
-    }
+/// AMFDecoder
+AMFDecoder::AMFDecoder(const uint8_t *buffer, size_t size, int version, std::pmr::memory_resource *resource)
+    : buffer_(buffer), pos_(0), size_(size), version_(version), resource_(resource) {}
 
-    return buffer_[pos_++];
+/// Called where the data goes wrong, the callers above only pass the false up
+bool AMFDecoder::Fail(AMFError error) {
+    status_.error = error;
+    status_.offset = pos_;
+    return false;
 }
 
-template <>
-double AMFDecoder::Load<double>() {
-    if (Front() != AMF_NUMBER) {
-        throw std::runtime_error("Expected a number");
+bool AMFDecoder::Need(size_t bytes) {
+    return size_ - pos_ >= bytes || Fail(AMF_ERROR_TRUNCATED);
+}
+
+/// Consumes the marker of `type`
+bool AMFDecoder::Expect(AMFType type) {
+    if (!Need(1)) {
+        return false;
+    }
+    if (buffer_[pos_] != type) {
+        return Fail(AMF_ERROR_UNEXPECTED_TYPE);
     }
     pos_++;
+    return true;
+}
 
-    if (pos_ + 8 > size_) {
-        throw std::runtime_error("Not enough data");
+bool AMFDecoder::ReadNumber(double &value) {
+    if (!Expect(AMF_NUMBER) || !Need(8)) {
+        return false;
     }
 
-    uint8_t value[8];
+    uint8_t bytes[8];
     for (int i = 0; i < 8; ++i) {
-        value[7 - i] = buffer_[pos_++];
+        bytes[7 - i] = buffer_[pos_++];
     }
-
-    return *(double *)value;
+    memcpy(&value, bytes, sizeof(value));
+    return true;
 }
 
-template <>
-bool AMFDecoder::Load<bool>() {
-    if (PopFront() != AMF_BOOLEAN) {
-        throw std::runtime_error("Expected a boolean");
+bool AMFDecoder::ReadBoolean(bool &value) {
+    if (!Expect(AMF_BOOLEAN) || !Need(1)) {
+        return false;
     }
-
-    return PopFront() != 0;
+    value = buffer_[pos_++] != 0;
+    return true;
 }
 
-template <>
-unsigned int AMFDecoder::Load<unsigned int>() {
-    unsigned int value = 0;
+bool AMFDecoder::ReadU29(uint32_t &value) {
+    value = 0;
     for (int i = 0; i < 4; ++i) {
-        uint8_t b = PopFront();
+        if (!Need(1)) {
+            return false;
+        }
+        uint8_t b = buffer_[pos_++];
         if (i == 3) {
             /* use all bits from 4th byte */
             value = (value << 8) | b;
@@ -401,199 +517,237 @@ unsigned int AMFDecoder::Load<unsigned int>() {
             break;
         }
     }
-    return value;
-}
-
-template <>
-int AMFDecoder::Load<int>() {
-    if (version_ == 3) {
-        return (int)Load<unsigned int>();
-    } else {
-        return (int)Load<double>();
-    }
+    return true;
 }
 
-template <>
-std::string AMFDecoder::Load<std::string>() {
-    size_t str_len = 0;
-    uint8_t type = PopFront();
+/// A view into the buffer, nothing is copied
+bool AMFDecoder::ReadString(std::string_view &value) {
+    size_t length = 0;
     if (version_ == 3) {
-        str_len = Load<unsigned int>() / 2;
-    } else {
-        if (type != AMF_STRING) {
-            throw std::runtime_error("Expected a string");
+        uint32_t u29;
+        if (!Need(1)) {
+            return false;
         }
-        if (pos_ + 2 > size_) {
-            throw std::runtime_error("Not enough data");
+        pos_++;
+        if (!ReadU29(u29)) {
+            return false;
         }
-
-        str_len = buffer_[pos_] << 8 | buffer_[pos_ + 1];
+        length = u29 / 2;
+    } else {
+        if (!Expect(AMF_STRING) || !Need(2)) {
+            return false;
+        }
+        length = buffer_[pos_] << 8 | buffer_[pos_ + 1];
         pos_ += 2;
     }
-    if (pos_ + str_len > size_) {
-        throw std::runtime_error("Not enough data");
+    if (!Need(length)) {
+        return false;
     }
 
-    std::string s((char *)buffer_ + pos_, str_len);
-    pos_ += str_len;
-    return s;
+    value = std::string_view((const char *)buffer_ + pos_, length);
+    pos_ += length;
+    return true;
 }
 
-template <>
-AMFValue AMFDecoder::Load<AMFValue>() {
-    uint8_t type = Front();
-    if (version_ == 3) {
-        throw std::runtime_error("Unsupported AMF3 type");
-    } else {
-        switch (type) {
-            case AMF_STRING:
-                return AMFValue(Load<std::string>());
-            case AMF_NUMBER:
-                return AMFValue(Load<double>());
-            case AMF_BOOLEAN:
-                return AMFValue(Load<bool>());
-            case AMF_NULL:
-                pos_++;
-                return AMFValue(AMF_NULL);
-            case AMF_UNDEFINED:
-                pos_++;
-                return AMFValue(AMF_UNDEFINED);
-            case AMF_OBJECT:
-                return LoadObject();
-            case AMF_ECMA_ARRAY:
-                return LoadEcma();
-            case AMF_STRICT_ARRAY:
-                return LoadArray();
-            default:
-                throw std::runtime_error("Unsupported AMF type");
-        }
+bool AMFDecoder::ReadKey(std::string_view &value) {
+    if (!Need(2)) {
+        return false;
     }
-}
-
-std::string AMFDecoder::LoadKey() {
-    if (pos_ + 2 > size_) {
-        throw std::runtime_error("Not enough data");
+    size_t length = buffer_[pos_] << 8 | buffer_[pos_ + 1];
+    pos_ += 2;
+    if (!Need(length)) {
+        return false;
     }
 
-    size_t str_len = buffer_[pos_] << 8 | buffer_[pos_ + 1];
-    pos_ += 2;
+    value = std::string_view((const char *)buffer_ + pos_, length);
+    pos_ += length;
+    return true;
+}
 
-    if (pos_ + str_len > size_) {
-        throw std::runtime_error("Not enough data");
+bool AMFDecoder::ReadValue(AMFValue &value, int depth) {
+    if (!Need(1)) {
+        return false;
+    }
+    if (version_ == 3) {
+        return Fail(AMF_ERROR_UNSUPPORTED_TYPE);
     }
 
-    std::string s((char *)buffer_ + pos_, str_len);
-    pos_ += str_len;
-    return s;
+    switch (buffer_[pos_]) {
+        case AMF_STRING: {
+            std::string_view s;
+            if (!ReadString(s)) {
+                return false;
+            }
+            value = AMFValue(s, resource_);
+            return true;
+        }
+        case AMF_NUMBER: {
+            double n;
+            if (!ReadNumber(n)) {
+                return false;
+            }
+            value = AMFValue(n);
+            return true;
+        }
+        case AMF_BOOLEAN: {
+            bool b;
+            if (!ReadBoolean(b)) {
+                return false;
+            }
+            value = AMFValue(b);
+            return true;
+        }
+        case AMF_NULL:
+        case AMF_UNDEFINED:
+            value = AMFValue((AMFType)buffer_[pos_++], resource_);
+            return true;
+        case AMF_OBJECT:
+            pos_++;
+            value = AMFValue(AMF_OBJECT, resource_);
+            return ReadProperties(value, depth + 1);
+        case AMF_ECMA_ARRAY:
+            /* ECMA array is the same as object, with 4 extra bytes for the count */
+            pos_++;
+            if (!Need(4)) {
+                return false;
+            }
+            pos_ += 4;
+            value = AMFValue(AMF_ECMA_ARRAY, resource_);
+            return ReadProperties(value, depth + 1);
+        case AMF_STRICT_ARRAY:
+            pos_++;
+            value = AMFValue(AMF_STRICT_ARRAY, resource_);
+            return ReadArray(value, depth + 1);
+        default:
+            return Fail(AMF_ERROR_UNSUPPORTED_TYPE);
+    }
 }
 
-AMFValue AMFDecoder::LoadObject() {
-    AMFValue object(AMF_OBJECT);
-    if (Front() != AMF_OBJECT) {
-        throw std::runtime_error("Expected an object");
+bool AMFDecoder::ReadProperties(AMFValue &object, int depth) {
+    if (depth > MAX_DEPTH) {
+        return Fail(AMF_ERROR_TOO_DEEP);
     }
-    pos_++;
-
     while (true) {
-        std::string key = LoadKey();
+        std::string_view key;
+        if (!ReadKey(key)) {
+            return false;
+        }
         if (key.empty()) {
             break;
         }
-        AMFValue value = Load<AMFValue>();
-        object.Set(key, value);
+        AMFValue value(AMF_NULL, resource_);
+        if (!ReadValue(value, depth)) {
+            return false;
+        }
+        object.Set(key, std::move(value));
+    }
+    if (!Need(1)) {
+        return false;
     }
-    if (PopFront() != AMF_OBJECT_END) {
-        throw std::runtime_error("expected object end");
+    if (buffer_[pos_] != AMF_OBJECT_END) {
+        return Fail(AMF_ERROR_MISSING_OBJECT_END);
     }
-    return object;
+    pos_++;
+    return true;
 }
 
-AMFValue AMFDecoder::LoadEcma() {
-    /* ECMA array is the same as object, with 4 extra zero bytes */
-    AMFValue object(AMF_ECMA_ARRAY);
-    if (Front() != AMF_ECMA_ARRAY) {
-        throw std::runtime_error("Expected an ECMA array");
+bool AMFDecoder::ReadArray(AMFValue &array, int depth) {
+    if (depth > MAX_DEPTH) {
+        return Fail(AMF_ERROR_TOO_DEEP);
     }
-    pos_++;
+    if (!Need(4)) {
+        return false;
+    }
+    uint32_t count = buffer_[pos_] << 24 | buffer_[pos_ + 1] << 16 | buffer_[pos_ + 2] << 8 | buffer_[pos_ + 3];
+    pos_ += 4;
 
-    if (pos_ + 4 > size_) {
-        throw std::runtime_error("Not enough data");
+    while (count--) {
+        AMFValue value(AMF_NULL, resource_);
+        if (!ReadValue(value, depth)) {
+            return false;
+        }
+        array.Add(std::move(value));
     }
+    return true;
+}
 
-    pos_ += 4;
-    while (true) {
-        std::string key = LoadKey();
-        if (key.empty()) {
+AMFStatus AMFDecoder::Decode(Values &values) {
+    auto posOld = pos_;
+    pos_ = 0;
+    status_ = {};
+    while (pos_ < size_) {
+        AMFValue value(AMF_NULL, resource_);
+        if (!ReadValue(value, 0)) {
             break;
         }
-        AMFValue value = Load<AMFValue>();
-        object.Set(key, value);
+        values.push_back(std::move(value));
     }
-    if (PopFront() != AMF_OBJECT_END) {
-        throw std::runtime_error("expected object end");
+    pos_ = posOld; // reset pos
+    return status_;
+}
+
+void AMFDecoder::Throw() const {
+    throw std::runtime_error(status_.ToString());
+}
+
+AMFDecoder::Values AMFDecoder::GetValues() {
+    Values values(resource_);
+    if (!Decode(values).Ok()) {
+        Throw();
     }
-    return object;
+    return values;
 }
 
-AMFValue AMFDecoder::LoadArray() {
-    AMFValue object(AMF_STRICT_ARRAY);
-    if (Front() != AMF_STRICT_ARRAY) {
-        throw std::runtime_error("Expected an STRICT array");
+template <>
+double AMFDecoder::Load<double>() {
+    double value;
+    if (!ReadNumber(value)) {
+        Throw();
     }
-    pos_++;
+    return value;
+}
 
-    if (pos_ + 4 > size_) {
-        throw std::runtime_error("Not enough data");
+template <>
+bool AMFDecoder::Load<bool>() {
+    bool value;
+    if (!ReadBoolean(value)) {
+        Throw();
     }
+    return value;
+}
 
-    int arrSize = buffer_[pos_] << 8 | buffer_[pos_ + 1] | buffer_[pos_ + 2] << 8 | buffer_[pos_ + 3];
+template <>
+unsigned int AMFDecoder::Load<unsigned int>() {
+    uint32_t value;
+    if (!ReadU29(value)) {
+        Throw();
+    }
+    return value;
+}
 
-    pos_ += 4;
-    while (arrSize--) {
-        AMFValue value = Load<AMFValue>();
-        object.Add(value);
+template <>
+int AMFDecoder::Load<int>() {
+    if (version_ == 3) {
+        return (int)Load<unsigned int>();
+    } else {
+        return (int)Load<double>();
     }
+}
 
-    return object;
+template <>
+std::string AMFDecoder::Load<std::string>() {
+    std::string_view value;
+    if (!ReadString(value)) {
+        Throw();
+    }
+    return std::string(value);
 }
 
-std::vector<AMFValue> AMFDecoder::GetValues() {
-    std::vector<AMFValue> values;
-    auto posOld = pos_;
-    pos_ = 0;
-    while (pos_ < size_) {
-        uint8_t type = Front();
-        switch (type) {
-            case AMF_STRING:
-                values.emplace_back(AMFValue(Load<std::string>()));
-                continue;
-            case AMF_NUMBER:
-                values.emplace_back(AMFValue(Load<double>()));
-                continue;
-            case AMF_BOOLEAN:
-                values.emplace_back(AMFValue(Load<bool>()));
-                continue;
-            case AMF_NULL:
-                values.emplace_back(AMFValue(AMF_NULL));
-                PopFront();
-                continue;
-            case AMF_UNDEFINED:
-                values.emplace_back(AMFValue(AMF_UNDEFINED));
-                PopFront();
-                continue;
-            case AMF_OBJECT:
-                values.emplace_back(LoadObject());
-                continue;
-            case AMF_ECMA_ARRAY:
-                values.emplace_back(LoadEcma());
-                continue;
-            case AMF_STRICT_ARRAY:
-                values.emplace_back(LoadArray());
-                continue;
-            default:
-                throw std::runtime_error("Unsupported AMF type");
-        }
+template <>
+AMFValue AMFDecoder::Load<AMFValue>() {
+    AMFValue value(AMF_NULL, resource_);
+    if (!ReadValue(value, 0)) {
+        Throw();
     }
-    pos_ = posOld; // reset pos
-    return values;
+    return value;
 }
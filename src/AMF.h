@@ -5,8 +5,12 @@
 #ifndef FLV_MEDIA_AMF_H
 #define FLV_MEDIA_AMF_H
 
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum AMFType : uint8_t {
@@ -30,59 +34,103 @@ enum AMFType : uint8_t {
     AMF_SWITCH_AMF3
 };
 
-template <class T>
-struct DisableCompare {
-    bool operator()(T lhs, T rhs) const {
-        if (lhs == rhs) {
-            return false;
-        }
-        return true;
-    }
+enum AMFError : uint8_t {
+    AMF_OK = 0,
+    AMF_ERROR_TRUNCATED,          // a value runs past the end of the buffer
+    AMF_ERROR_UNEXPECTED_TYPE,    // the marker is not the one asked for
+    AMF_ERROR_UNSUPPORTED_TYPE,   // a marker this decoder does not handle, AMF3 included
+    AMF_ERROR_MISSING_OBJECT_END, // properties not closed by an object end marker
+    AMF_ERROR_TOO_DEEP            // objects and arrays nested deeper than AMFDecoder::MAX_DEPTH
 };
 
+/// Outcome of a decode. On failure `offset` is the position in the buffer the decoder stopped at.
+struct AMFStatus {
+    AMFError error = AMF_OK;
+    size_t offset = 0;
+
+    bool Ok() const { return error == AMF_OK; }
+    /// e.g. "AMF data truncated at offset 42"
+    std::string ToString() const;
+
+    static const char *GetErrorName(AMFError error);
+};
+
+/// An AMF0 value.
+///
+/// Allocator-aware in the std::pmr sense: strings and containers live in the memory resource the value was
+/// created with, and pmr containers of values hand theirs down to the elements. Copies without an allocator go to
+/// the default resource, so a value copied out of a per-tag arena outlives it. Numbers and booleans never allocate.
 class AMFValue {
 public:
-    using ObjectType = std::map<std::string, AMFValue, DisableCompare<std::string>>;
-    using ArrayType = std::vector<AMFValue>;
-
-    explicit AMFValue(AMFType type = AMF_NULL);
-    explicit AMFValue(const char *s);
-    explicit AMFValue(const std::string &s);
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+    using String = std::pmr::string;
+    /// Properties keep their wire order, which players rely on for onMetaData
+    using ObjectType = std::pmr::vector<std::pair<String, AMFValue>>;
+    using ArrayType = std::pmr::vector<AMFValue>;
+
+    explicit AMFValue(AMFType type = AMF_NULL, const allocator_type &allocator = {});
+    explicit AMFValue(const char *s, const allocator_type &allocator = {});
+    explicit AMFValue(std::string_view s, const allocator_type &allocator = {});
     explicit AMFValue(double n);
     explicit AMFValue(int i);
     explicit AMFValue(bool b);
-    AMFValue(const AMFValue &from);
+    AMFValue(const AMFValue &from, const allocator_type &allocator = {});
+    AMFValue(AMFValue &&from) noexcept;
+    AMFValue(AMFValue &&from, const allocator_type &allocator);
     AMFValue &operator=(const AMFValue &from);
+    AMFValue &operator=(AMFValue &&from);
     ~AMFValue();
 
     AMFType Type() const;
-    void *GetValue() const;
-    const std::string &AsString() const;
+    allocator_type get_allocator() const { return resource_; }
+    const void *GetValue() const;
+
+    /// Checked accessors which never throw: null, or false, when the value is of another type
+    const String *GetString() const;
+    bool GetNumber(double &n) const;
+    bool GetBoolean(bool &b) const;
+    const ObjectType *GetObjectMap() const;
+    const ArrayType *GetArray() const;
+
+    /// The same, throwing std::runtime_error on a type mismatch
+    const String &AsString() const;
     double AsNumber() const;
     bool AsBoolean() const;
     const ObjectType &AsObjectMap() const;
-    AMFValue operator[](const char *) const;
+    const AMFValue &operator[](std::string_view key) const;
     const ArrayType &AsArray() const;
 
     // AMF_OBJECT | AMF_ECMA_ARRAY
-    void Set(const std::string &s, const AMFValue &val);
+    void Set(std::string_view key, const AMFValue &val);
+    void Set(std::string_view key, AMFValue &&val);
     // AMF_STRICT_ARRAY
     void Add(const AMFValue &val);
+    void Add(AMFValue &&val);
 
-    std::string Dump();
+    std::string Dump() const;
+    void Dump(std::ostream &os) const;
 
 private:
+    void Construct(AMFType type);
+    void CopyFrom(const AMFValue &from);
     void Destroy();
 
 private:
     AMFType type_;
-    void *value_{};
+    std::pmr::memory_resource *resource_;
+    union {
+        double number_;
+        bool boolean_;
+        String string_;
+        ObjectType object_;
+        ArrayType array_;
+    };
 };
 
 class AMFEncoder {
 public:
     AMFEncoder &operator<<(const char *s);
-    AMFEncoder &operator<<(const std::string &s);
+    AMFEncoder &operator<<(std::string_view s);
     AMFEncoder &operator<<(std::nullptr_t);
     AMFEncoder &operator<<(int n);
     AMFEncoder &operator<<(double n);
@@ -93,34 +141,57 @@ public:
     void Clear();
 
 private:
-    void WriteKay(const std::string &key);
+    void WriteKay(std::string_view key);
 
 private:
     std::string buffer_;
 };
 
+/// Values are created in `resource`, typically an arena released once the tag is handled.
+///
+/// Decode() reports malformed data through its status and never throws, which is what scans over noisy input
+/// should use: unwinding an exception per bad script tag costs far more than decoding the tag. GetValues() and
+/// Load() are the same decoder throwing std::runtime_error instead.
 class AMFDecoder {
 public:
-    AMFDecoder(const uint8_t *buffer, size_t size, int version = 0);
+    using Values = std::pmr::vector<AMFValue>;
+
+    /// Objects and arrays nested deeper are rejected rather than decoded by recursion
+    static constexpr int MAX_DEPTH = 64;
+
+    AMFDecoder(const uint8_t *buffer, size_t size, int version = 0,
+               std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /// Appends the values of the whole buffer to `values`. On failure the ones decoded before the bad one stay.
+    AMFStatus Decode(Values &values);
 
-    std::vector<AMFValue> GetValues();
+    Values GetValues();
 
+    /// One value at the current position
     template <typename T>
     T Load();
 
 private:
-    uint8_t Front();
-    uint8_t PopFront();
-    std::string LoadKey();
-    AMFValue LoadObject();
-    AMFValue LoadEcma();
-    AMFValue LoadArray();
+    bool Fail(AMFError error);
+    bool Need(size_t bytes);
+    bool Expect(AMFType type);
+    bool ReadNumber(double &value);
+    bool ReadBoolean(bool &value);
+    bool ReadU29(uint32_t &value);
+    bool ReadString(std::string_view &value);
+    bool ReadKey(std::string_view &value);
+    bool ReadValue(AMFValue &value, int depth);
+    bool ReadProperties(AMFValue &object, int depth);
+    bool ReadArray(AMFValue &array, int depth);
+    void Throw() const;
 
 private:
     const uint8_t *buffer_;
     size_t pos_;
     size_t size_;
     int version_;
+    std::pmr::memory_resource *resource_;
+    AMFStatus status_;
 };
 
 #endif // FLV_MEDIA_AMF_H
@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "AV1Configuration.h"
+#include "Log.h"
+
+/*
+ * AV1CodecConfigurationRecord
+ * bits
+ * 1   marker ( always 1 )
+ * 7   version ( always 1 )
+ * 3   seq_profile
+ * 5   seq_level_idx_0
+ * 1   seq_tier_0
+ * 1   high_bitdepth
+ * 1   twelve_bit
+ * 1   monochrome
+ * 1   chroma_subsampling_x
+ * 1   chroma_subsampling_y
+ * 2   chroma_sample_position
+ * 3   reserved
+ * 1   initial_presentation_delay_present
+ * 4   initial_presentation_delay_minus_one or reserved
+ *         variable configOBUs
+ */
+
+AV1Configuration::AV1Configuration(const uint8_t *packet, size_t size) {
+    SetConfigurationPacket(packet, size);
+}
+
+bool AV1Configuration::SetConfigurationPacket(const uint8_t *pack, size_t size) {
+    if (size < 4 || pack[0] != 0x81) {
+        Log("Invalid AV1 configuration record");
+        return false;
+    }
+
+    profile_ = pack[1] >> 5;
+    level_ = pack[1] & 0x1f;
+    bool highBitDepth = pack[2] & 0x40;
+    bool twelveBit = pack[2] & 0x20;
+    bitDepth_ = highBitDepth ? (twelveBit ? 12 : 10) : 8;
+    configOBUs_.assign((const char *)pack + 4, size - 4);
+    uint64_t hash = ByteSpan(pack, size).Hash();
+    if (generation_ == 0 || hash != packetHash_) {
+        packetHash_ = hash;
+        generation_++;
+    }
+    return true;
+}
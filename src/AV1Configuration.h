@@ -0,0 +1,38 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_AV1_CONFIGURATION_H
+#define FLV_MEDIA_AV1_CONFIGURATION_H
+
+#include "Span.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// [AV1CodecConfigurationRecord](https://aomediacodec.github.io/av1-isobmff/#av1codecconfigurationbox-syntax)
+class AV1Configuration {
+public:
+    AV1Configuration() = default;
+    AV1Configuration(const uint8_t *packet, size_t size);
+
+    bool SetConfigurationPacket(const uint8_t *pack, size_t size);
+
+    /// configOBUs, usually the sequence header OBU
+    const std::string &GetConfigOBUs() const { return configOBUs_; }
+    int GetProfile() const { return profile_; }
+    int GetLevel() const { return level_; }
+    int GetBitDepth() const { return bitDepth_; }
+    /// Bumped whenever the record changes
+    uint32_t GetGeneration() const { return generation_; }
+
+private:
+    int profile_ = 0;
+    int level_ = 0;
+    int bitDepth_ = 8;
+    uint64_t packetHash_ = 0;
+    uint32_t generation_ = 0;
+    std::string configOBUs_;
+};
+
+#endif // FLV_MEDIA_AV1_CONFIGURATION_H
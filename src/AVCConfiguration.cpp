@@ -3,9 +3,9 @@
 //
 
 #include "AVCConfiguration.h"
-#include <assert.h>
+#include "Log.h"
+#include <cstring>
 #include <cstdint>
-#include <cstdio>
 #include <vector>
 
 /*
@@ -26,6 +26,17 @@
  *         repeated once per PPS
  * 16  PPS size
  *         variable PPS NALU data
+ *         if profile is 100, 110, 122 or 144:
+ * 6   reserved ( all bits on )
+ * 2   chroma_format
+ * 5   reserved ( all bits on )
+ * 3   bit_depth_luma_minus8
+ * 5   reserved ( all bits on )
+ * 3   bit_depth_chroma_minus8
+ * 8   number of SPS extension NALUs
+ *         repeated once per SPS extension:
+ * 16  SPS extension size
+ *         variable SPS extension NALU data
  */
 
 AVCConfiguration::AVCConfiguration(const uint8_t *packet, size_t size) {
@@ -38,16 +49,29 @@ AVCConfiguration::AVCConfiguration(const uint8_t *sps, size_t spsSize, const uin
 }
 
 void AVCConfiguration::SetSPS(const uint8_t *sps, size_t size) {
-    sps_ = std::string((const char *)sps, size);
+    sps_.assign(1, std::string((const char *)sps, size));
+    packet_.clear();
+    BuildAnnexB();
 }
 
 void AVCConfiguration::SetPPS(const uint8_t *pps, size_t size) {
-    pps_ = std::string((const char *)pps, size);
+    pps_.assign(1, std::string((const char *)pps, size));
+    packet_.clear();
+    BuildAnnexB();
 }
 
-void AVCConfiguration::SetConfigurationPacket(const uint8_t *pack, size_t size) {
+bool AVCConfiguration::SetConfigurationPacket(const uint8_t *pack, size_t size) {
+    // the record is kept anyway, comparing it costs no more than hashing and can not collide
+    if (!packet_.empty() && packet_.size() == size && memcmp(packet_.data(), pack, size) == 0) {
+        return false;
+    }
+
     packet_ = std::string((const char *)pack, size);
-    ParsePacket();
+    if (!ParsePacket()) {
+        Log("Invalid AVC configuration record");
+    }
+    BuildAnnexB();
+    return true;
 }
 
 std::string AVCConfiguration::GetConfigurationPacket() {
@@ -55,69 +79,100 @@ std::string AVCConfiguration::GetConfigurationPacket() {
         return packet_;
     }
 
-    if (sps_.size() < 4 || pps_.empty()) {
+    if (sps_.empty() || sps_[0].size() < 4 || pps_.empty()) {
         return {};
     }
 
     std::string packet;
+    const std::string &sps = sps_[0];
 
     char config[6] = {};
-    config[0] = 0x01;           // version
-    config[1] = sps_.data()[1]; // profileIndication: Baseline profile 66, Main profile 77, High profile 100
-    config[2] = sps_.data()[2]; // profileCompatibility
-    config[3] = sps_.data()[3]; // levelIndication
+    config[0] = 0x01;          // version
+    config[1] = sps.data()[1]; // profileIndication: Baseline profile 66, Main profile 77, High profile 100
+    config[2] = sps.data()[2]; // profileCompatibility
+    config[3] = sps.data()[3]; // levelIndication
     config[4] = 0xff;
-    uint8_t numOfSPS = 1;
-    config[5] = 0b1110000 | numOfSPS;
+    config[5] = 0b11100000 | (sps_.size() & 0x1f);
 
     packet.assign(config, 6);
+    for (auto &item : sps_) {
+        packet.push_back((item.size() >> 8) & 0xff);
+        packet.push_back(item.size() & 0xff);
+        packet.append(item);
+    }
 
-    uint16_t spsLength = (uint16_t)sps_.size();
-    packet.push_back((spsLength >> 8) & 0xff);
-    packet.push_back(spsLength & 0xff);
-    packet.append(sps_);
-
-    uint8_t numOfPPS = 1;
-    packet.push_back(numOfPPS);
-    uint16_t ppsLength = (uint16_t)pps_.size();
-    packet.push_back((ppsLength >> 8) & 0xff);
-    packet.push_back(ppsLength & 0xff);
-    packet.append(pps_);
+    packet.push_back(pps_.size() & 0xff);
+    for (auto &item : pps_) {
+        packet.push_back((item.size() >> 8) & 0xff);
+        packet.push_back(item.size() & 0xff);
+        packet.append(item);
+    }
 
     packet_ = std::move(packet);
     return packet_;
 }
 
 bool AVCConfiguration::ParsePacket() {
-    if (packet_.empty()) {
+    sps_.clear();
+    pps_.clear();
+    spsExt_.clear();
+    if (packet_.size() < 7) {
         return false;
     }
 
-    assert(packet_.size() > 8);
-    auto p = packet_.data();
-
-    assert(p[0] == 0x01); // version
+    auto p = (const uint8_t *)packet_.data();
+    auto end = p + packet_.size();
+    if (p[0] != 0x01) { // version
+        return false;
+    }
 
+    int profile = p[1];
     naluLengthSize_ = (p[4] & 0x03) + 1;
-    int numOfSPS = p[5] & 0x1f;
-    assert(numOfSPS == 1);
 
-    p += 6;
-    int spsLength = (p[0] << 8) | p[1];
-    p += 2;
-    assert(p < packet_.data() + packet_.size());
+    auto readList = [&](int count, std::vector<std::string> &list) {
+        for (int i = 0; i < count; ++i) {
+            if (p + 2 > end) {
+                return false;
+            }
+            size_t length = (p[0] << 8) | p[1];
+            p += 2;
+            if (p + length > end) {
+                return false;
+            }
+            list.emplace_back((const char *)p, length);
+            p += length;
+        }
+        return true;
+    };
 
-    sps_.assign(p, spsLength);
-    p += spsLength;
+    int numOfSPS = p[5] & 0x1f;
+    p += 6;
+    if (!readList(numOfSPS, sps_) || p >= end) {
+        return false;
+    }
 
-    int numOfPPS = p[0];
-    assert(numOfPPS == 1);
-    p += 1;
-    int ppsLength = (p[0] << 8) | p[1];
-    p += 2;
-    assert(p < packet_.data() + packet_.size());
+    int numOfPPS = *p++;
+    if (!readList(numOfPPS, pps_)) {
+        return false;
+    }
 
-    pps_.assign(p, ppsLength);
+    // high profiles may carry chroma format, bit depths and SPS extensions, often omitted by muxers
+    if ((profile == 100 || profile == 110 || profile == 122 || profile == 144) && p + 4 <= end) {
+        int numOfSPSExt = p[3];
+        p += 4;
+        readList(numOfSPSExt, spsExt_);
+    }
+    return !sps_.empty() && !pps_.empty();
+}
 
-    return true;
+void AVCConfiguration::BuildAnnexB() {
+    static const char startCode[4] = {0x00, 0x00, 0x00, 0x01};
+    annexB_.clear();
+    for (auto list : {&sps_, &spsExt_, &pps_}) {
+        for (auto &item : *list) {
+            annexB_.append(startCode, 4);
+            annexB_.append(item);
+        }
+    }
+    generation_++;
 }
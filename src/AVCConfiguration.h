@@ -5,10 +5,12 @@
 #ifndef FLV_MEDIA_AVC_CONFIGURATION_H
 #define FLV_MEDIA_AVC_CONFIGURATION_H
 
+#include "Span.h"
 #include <cstddef>
 #include <cstdint>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 class AVCConfiguration {
 public:
@@ -18,21 +20,35 @@ public:
 
     void SetSPS(const uint8_t *sps, size_t size);
     void SetPPS(const uint8_t *sps, size_t size);
-    void SetConfigurationPacket(const uint8_t *pack, size_t size);
-
-    std::string GetSPS() { return sps_; }
-    std::string GetPPS() { return pps_; }
+    /// Returns true when the record differs from the current one
+    bool SetConfigurationPacket(const uint8_t *pack, size_t size);
+
+    const std::string &GetSPS() const { return sps_.empty() ? empty_ : sps_[0]; }
+    const std::string &GetPPS() const { return pps_.empty() ? empty_ : pps_[0]; }
+    const std::vector<std::string> &GetSPSList() const { return sps_; }
+    const std::vector<std::string> &GetPPSList() const { return pps_; }
+    const std::vector<std::string> &GetSPSExtList() const { return spsExt_; }
     std::string GetConfigurationPacket();
-    int GetNALULengthSize() { return naluLengthSize_; }
+    int GetNALULengthSize() const { return naluLengthSize_; }
+
+    /// Every SPS, SPS extension and PPS behind 4 bytes start codes, ready to go in front of an IDR
+    ByteSpan GetAnnexBParameterSets() const { return {(const uint8_t *)annexB_.data(), annexB_.size()}; }
+    /// Bumped whenever the parameter sets change
+    uint32_t GetGeneration() const { return generation_; }
 
 private:
     bool ParsePacket();
+    void BuildAnnexB();
 
 private:
     std::string packet_;
-    std::string sps_;
-    std::string pps_;
+    std::vector<std::string> sps_;
+    std::vector<std::string> pps_;
+    std::vector<std::string> spsExt_;
+    std::string annexB_;
+    uint32_t generation_ = 0;
     int naluLengthSize_ = 4;
+    std::string empty_;
 };
 
-#endif // FLV_MEDIA_AVC_CONFIGURATION_H
\ No newline at end of file
+#endif // FLV_MEDIA_AVC_CONFIGURATION_H
@@ -0,0 +1,285 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "AVCParser.h"
+#include "BitReader.h"
+
+static void SkipScalingList(BitReader &reader, int size) {
+    int lastScale = 8;
+    int nextScale = 8;
+    for (int i = 0; i < size; ++i) {
+        if (nextScale != 0) {
+            nextScale = (lastScale + reader.ReadSE() + 256) % 256;
+        }
+        lastScale = nextScale == 0 ? lastScale : nextScale;
+    }
+}
+
+static void ParseVUI(BitReader &reader, AVCSPS &sps) {
+    static const uint8_t sarTable[17][2] = {{0, 0},   {1, 1},   {12, 11}, {10, 11}, {16, 11},  {40, 33},
+                                            {24, 11}, {20, 11}, {32, 11}, {80, 33}, {18, 11},  {15, 11},
+                                            {64, 33}, {160, 99}, {4, 3},   {3, 2},   {2, 1}};
+
+    if (reader.ReadBit()) { // aspect_ratio_info_present_flag
+        uint8_t idc = reader.ReadBits(8);
+        if (idc == 255) {
+            sps.sarWidth = reader.ReadBits(16);
+            sps.sarHeight = reader.ReadBits(16);
+        } else if (idc < 17) {
+            sps.sarWidth = sarTable[idc][0];
+            sps.sarHeight = sarTable[idc][1];
+        }
+    }
+    if (reader.ReadBit()) { // overscan_info_present_flag
+        reader.ReadBit();
+    }
+    if (reader.ReadBit()) { // video_signal_type_present_flag
+        reader.ReadBits(4);
+        if (reader.ReadBit()) { // colour_description_present_flag
+            reader.ReadBits(24);
+        }
+    }
+    if (reader.ReadBit()) { // chroma_loc_info_present_flag
+        reader.ReadUE();
+        reader.ReadUE();
+    }
+    if (reader.ReadBit()) { // timing_info_present_flag
+        sps.numUnitsInTick = reader.ReadBits(32);
+        sps.timeScale = reader.ReadBits(32);
+        sps.fixedFrameRate = reader.ReadBit();
+    }
+}
+
+bool AVCParser::ParseSPS(const uint8_t *nalu, size_t size, AVCSPS &sps) {
+    if (size < 4 || (nalu[0] & 0x1f) != AVC_NALU_SPS) {
+        return false;
+    }
+
+    BitReader reader(nalu + 1, size - 1, true);
+    sps = AVCSPS();
+    sps.profile = reader.ReadBits(8);
+    sps.constraints = reader.ReadBits(8);
+    sps.level = reader.ReadBits(8);
+    uint32_t id = reader.ReadUE();
+    if (id >= MAX_SPS) {
+        return false;
+    }
+    sps.id = id;
+
+    switch (sps.profile) {
+        case 100:
+        case 110:
+        case 122:
+        case 244:
+        case 44:
+        case 83:
+        case 86:
+        case 118:
+        case 128:
+        case 138:
+        case 139:
+        case 134:
+        case 135: {
+            sps.chromaFormat = reader.ReadUE();
+            if (sps.chromaFormat > 3) {
+                return false;
+            }
+            if (sps.chromaFormat == 3) {
+                sps.separateColourPlane = reader.ReadBit();
+            }
+            sps.bitDepthLuma = 8 + reader.ReadUE();
+            sps.bitDepthChroma = 8 + reader.ReadUE();
+            reader.ReadBit(); // qpprime_y_zero_transform_bypass_flag
+            if (reader.ReadBit()) { // seq_scaling_matrix_present_flag
+                for (int i = 0; i < (sps.chromaFormat != 3 ? 8 : 12); ++i) {
+                    if (reader.ReadBit()) {
+                        SkipScalingList(reader, i < 6 ? 16 : 64);
+                    }
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    sps.log2MaxFrameNum = 4 + reader.ReadUE();
+    sps.pocType = reader.ReadUE();
+    if (sps.log2MaxFrameNum > 16 || sps.pocType > 2) {
+        return false;
+    }
+    if (sps.pocType == 0) {
+        sps.log2MaxPocLsb = 4 + reader.ReadUE();
+        if (sps.log2MaxPocLsb > 16) {
+            return false;
+        }
+    } else if (sps.pocType == 1) {
+        sps.deltaPicOrderAlwaysZero = reader.ReadBit();
+        reader.ReadSE(); // offset_for_non_ref_pic
+        reader.ReadSE(); // offset_for_top_to_bottom_field
+        uint32_t cycle = reader.ReadUE();
+        if (cycle > 255) {
+            return false;
+        }
+        for (uint32_t i = 0; i < cycle; ++i) {
+            reader.ReadSE();
+        }
+    }
+
+    sps.maxRefFrames = reader.ReadUE();
+    reader.ReadBit(); // gaps_in_frame_num_value_allowed_flag
+    uint32_t widthInMbs = reader.ReadUE() + 1;
+    uint32_t heightInMapUnits = reader.ReadUE() + 1;
+    sps.frameMbsOnly = reader.ReadBit();
+    if (!sps.frameMbsOnly) {
+        reader.ReadBit(); // mb_adaptive_frame_field_flag
+    }
+    reader.ReadBit(); // direct_8x8_inference_flag
+
+    sps.width = widthInMbs * 16;
+    sps.height = (2 - sps.frameMbsOnly) * heightInMapUnits * 16;
+    if (reader.ReadBit()) { // frame_cropping_flag
+        uint32_t left = reader.ReadUE();
+        uint32_t right = reader.ReadUE();
+        uint32_t top = reader.ReadUE();
+        uint32_t bottom = reader.ReadUE();
+
+        uint32_t cropX = 1;
+        uint32_t cropY = 2 - sps.frameMbsOnly;
+        if (!sps.separateColourPlane && sps.chromaFormat != 0) {
+            cropX = sps.chromaFormat == 3 ? 1 : 2;
+            cropY *= sps.chromaFormat == 1 ? 2 : 1;
+        }
+        if ((left + right) * cropX >= sps.width || (top + bottom) * cropY >= sps.height) {
+            return false;
+        }
+        sps.width -= (left + right) * cropX;
+        sps.height -= (top + bottom) * cropY;
+    }
+
+    if (reader.ReadBit()) { // vui_parameters_present_flag
+        ParseVUI(reader, sps);
+    }
+    return !reader.Overrun();
+}
+
+bool AVCParser::ParsePPS(const uint8_t *nalu, size_t size, AVCPPS &pps) {
+    if (size < 2 || (nalu[0] & 0x1f) != AVC_NALU_PPS) {
+        return false;
+    }
+
+    BitReader reader(nalu + 1, size - 1, true);
+    pps = AVCPPS();
+    uint32_t id = reader.ReadUE();
+    uint32_t spsId = reader.ReadUE();
+    if (id >= MAX_PPS || spsId >= MAX_SPS) {
+        return false;
+    }
+    pps.id = id;
+    pps.spsId = spsId;
+    pps.entropyCodingMode = reader.ReadBit();
+    pps.bottomFieldPicOrderInFramePresent = reader.ReadBit();
+
+    pps.numSliceGroups = reader.ReadUE() + 1;
+    if (pps.numSliceGroups > 8) {
+        return false;
+    }
+    if (pps.numSliceGroups > 1) {
+        uint32_t mapType = reader.ReadUE();
+        if (mapType == 0) {
+            for (uint32_t i = 0; i < pps.numSliceGroups; ++i) {
+                reader.ReadUE(); // run_length_minus1
+            }
+        } else if (mapType == 2) {
+            for (uint32_t i = 0; i + 1 < pps.numSliceGroups; ++i) {
+                reader.ReadUE(); // top_left
+                reader.ReadUE(); // bottom_right
+            }
+        } else if (mapType >= 3 && mapType <= 5) {
+            reader.ReadBit(); // slice_group_change_direction_flag
+            reader.ReadUE();  // slice_group_change_rate_minus1
+        } else if (mapType == 6) {
+            uint32_t mapUnits = reader.ReadUE() + 1;
+            int bits = 32 - __builtin_clz(pps.numSliceGroups - 1);
+            reader.SkipBits((size_t)mapUnits * bits);
+        }
+    }
+
+    pps.numRefIdxL0Active = reader.ReadUE() + 1;
+    pps.numRefIdxL1Active = reader.ReadUE() + 1;
+    pps.weightedPred = reader.ReadBit();
+    pps.weightedBipred = reader.ReadBits(2);
+    return !reader.Overrun();
+}
+
+bool AVCParser::ParseParameterSet(const uint8_t *nalu, size_t size) {
+    if (size == 0) {
+        return false;
+    }
+
+    switch (nalu[0] & 0x1f) {
+        case AVC_NALU_SPS: {
+            AVCSPS sps;
+            if (!ParseSPS(nalu, size, sps)) {
+                return false;
+            }
+            sps_[sps.id] = sps;
+            hasSPS_[sps.id] = true;
+            return true;
+        }
+        case AVC_NALU_PPS: {
+            AVCPPS pps;
+            if (!ParsePPS(nalu, size, pps)) {
+                return false;
+            }
+            pps_[pps.id] = pps;
+            hasPPS_[pps.id] = true;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool AVCParser::ParseSliceHeader(const uint8_t *nalu, size_t size, AVCSliceHeader &header) const {
+    if (size < 2) {
+        return false;
+    }
+
+    header = AVCSliceHeader();
+    header.naluType = nalu[0] & 0x1f;
+    header.refIdc = (nalu[0] >> 5) & 0x03;
+    if (header.naluType != AVC_NALU_SLICE && header.naluType != AVC_NALU_IDR) {
+        return false;
+    }
+
+    BitReader reader(nalu + 1, size - 1, true);
+    header.firstMb = reader.ReadUE();
+    uint32_t sliceType = reader.ReadUE();
+    uint32_t ppsId = reader.ReadUE();
+    if (sliceType > 9 || ppsId >= MAX_PPS || !hasPPS_[ppsId] || !hasSPS_[pps_[ppsId].spsId]) {
+        return false;
+    }
+    header.sliceType = sliceType % 5;
+    header.ppsId = ppsId;
+
+    const AVCSPS &sps = sps_[pps_[ppsId].spsId];
+    if (sps.separateColourPlane) {
+        reader.ReadBits(2); // colour_plane_id
+    }
+    header.frameNum = reader.ReadBits(sps.log2MaxFrameNum);
+    if (!sps.frameMbsOnly) {
+        header.fieldPic = reader.ReadBit();
+        if (header.fieldPic) {
+            header.bottomField = reader.ReadBit();
+        }
+    }
+    if (header.naluType == AVC_NALU_IDR) {
+        header.idrPicId = reader.ReadUE();
+    }
+    if (sps.pocType == 0) {
+        header.pocLsb = reader.ReadBits(sps.log2MaxPocLsb);
+    }
+    return !reader.Overrun();
+}
@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_AVC_PARSER_H
+#define FLV_MEDIA_AVC_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum AVCNaluType : uint8_t {
+    AVC_NALU_SLICE = 1,
+    AVC_NALU_SLICE_DPA,
+    AVC_NALU_SLICE_DPB,
+    AVC_NALU_SLICE_DPC,
+    AVC_NALU_IDR,
+    AVC_NALU_SEI,
+    AVC_NALU_SPS,
+    AVC_NALU_PPS,
+    AVC_NALU_AUD,
+    AVC_NALU_END_SEQUENCE,
+    AVC_NALU_END_STREAM,
+    AVC_NALU_FILLER,
+    AVC_NALU_SPS_EXT,
+};
+
+enum AVCSliceType : uint8_t {
+    AVC_SLICE_P = 0,
+    AVC_SLICE_B,
+    AVC_SLICE_I,
+    AVC_SLICE_SP,
+    AVC_SLICE_SI,
+};
+
+/// The sequence parameter set fields the tools care about, H.264 7.3.2.1.1
+struct AVCSPS {
+    uint8_t profile = 0;
+    uint8_t constraints = 0;
+    uint8_t level = 0;
+    uint8_t id = 0;
+    uint8_t chromaFormat = 1;
+    uint8_t bitDepthLuma = 8;
+    uint8_t bitDepthChroma = 8;
+    uint8_t log2MaxFrameNum = 4;
+    uint8_t pocType = 0;
+    uint8_t log2MaxPocLsb = 4;
+    bool deltaPicOrderAlwaysZero = false;
+    bool separateColourPlane = false;
+    bool frameMbsOnly = true;
+    uint32_t maxRefFrames = 0;
+    uint32_t width = 0;  // after cropping
+    uint32_t height = 0; // after cropping
+    uint32_t sarWidth = 0;
+    uint32_t sarHeight = 0;
+    uint32_t numUnitsInTick = 0;
+    uint32_t timeScale = 0;
+    bool fixedFrameRate = false;
+
+    /// Frames per second from the VUI timing info, 0 when absent
+    double GetFrameRate() const { return numUnitsInTick ? timeScale / (2.0 * numUnitsInTick) : 0; }
+};
+
+/// H.264 7.3.2.2, up to the fields a slice header depends on
+struct AVCPPS {
+    uint8_t id = 0;
+    uint8_t spsId = 0;
+    bool entropyCodingMode = false; // CABAC
+    bool bottomFieldPicOrderInFramePresent = false;
+    uint32_t numSliceGroups = 1;
+    uint32_t numRefIdxL0Active = 1;
+    uint32_t numRefIdxL1Active = 1;
+    bool weightedPred = false;
+    uint8_t weightedBipred = 0;
+};
+
+/// H.264 7.3.3, the fields before ref_pic_list_modification
+struct AVCSliceHeader {
+    uint8_t naluType = 0;
+    uint8_t refIdc = 0; // nal_ref_idc, 0 for non-reference pictures
+    uint32_t firstMb = 0;
+    uint8_t sliceType = 0; // AVCSliceType, the +5 "all slices alike" form folded
+    uint8_t ppsId = 0;
+    uint32_t frameNum = 0;
+    bool fieldPic = false;
+    bool bottomField = false;
+    uint32_t idrPicId = 0;
+    uint32_t pocLsb = 0;
+};
+
+/// Parameter set tables and slice header parsing.
+///
+/// Every Parse function takes a whole NALU including its one byte header, emulation prevention bytes in place.
+class AVCParser {
+public:
+    static bool ParseSPS(const uint8_t *nalu, size_t size, AVCSPS &sps);
+    static bool ParsePPS(const uint8_t *nalu, size_t size, AVCPPS &pps);
+
+    /// Parses a parameter set NALU into the tables, other NALUs are ignored
+    bool ParseParameterSet(const uint8_t *nalu, size_t size);
+    /// Needs the PPS and SPS the slice refers to
+    bool ParseSliceHeader(const uint8_t *nalu, size_t size, AVCSliceHeader &header) const;
+
+    /// nullptr until a valid SPS with this id is seen
+    const AVCSPS *GetSPS(uint8_t id = 0) const { return id < MAX_SPS && hasSPS_[id] ? &sps_[id] : nullptr; }
+    const AVCPPS *GetPPS(uint8_t id = 0) const { return hasPPS_[id] ? &pps_[id] : nullptr; }
+
+private:
+    static const int MAX_SPS = 32;
+    static const int MAX_PPS = 256;
+
+    AVCSPS sps_[MAX_SPS];
+    AVCPPS pps_[MAX_PPS];
+    bool hasSPS_[MAX_SPS] = {};
+    bool hasPPS_[MAX_PPS] = {};
+};
+
+#endif // FLV_MEDIA_AVC_PARSER_H
@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "AllocationCounter.h"
+
+#ifdef FLV_MEDIA_COUNT_ALLOCATIONS
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocationCount{0};
+
+uint64_t GetAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+// the array and nothrow forms end up here through their default implementations
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    free(p);
+}
+
+// std::pmr::new_delete_resource() allocates through the aligned form
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t align = std::max((size_t)alignment, sizeof(void *));
+    void *p = nullptr;
+    if (posix_memalign(&p, align, size ? size : 1) == 0) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    free(p);
+}
+#endif
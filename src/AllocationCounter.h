@@ -0,0 +1,15 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_ALLOCATION_COUNTER_H
+#define FLV_MEDIA_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+#ifdef FLV_MEDIA_COUNT_ALLOCATIONS
+/// Global operator new calls so far, built with -DFLV_MEDIA_COUNT_ALLOCATIONS=ON only
+uint64_t GetAllocationCount();
+#endif
+
+#endif // FLV_MEDIA_ALLOCATION_COUNTER_H
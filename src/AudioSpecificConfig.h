@@ -5,6 +5,7 @@
 #ifndef FLV_AUDIO_SPECIFIC_CONFIG_H
 #define FLV_AUDIO_SPECIFIC_CONFIG_H
 
+#include "BitReader.h"
 #include <string>
 
 /// [Audio Specific Config](https://wiki.multimedia.cx/index.php?title=MPEG-4_Audio)
@@ -66,10 +67,7 @@ enum AudioObjectType {
 // var bits: AOT Specific Config
 class AudioSpecificConfig {
 public:
-    AudioSpecificConfig(char *data, int size) {
-        data_.assign(data, size);
-        printf("%02x-%02x\n", data[0] & 0xff, data[1] & 0xff);
-    }
+    AudioSpecificConfig(char *data, int size) { data_.assign(data, size); }
 
     int GetObjectType() {
         if (!objectType_) {
@@ -92,61 +90,31 @@ public:
         return channels_;
     }
 
+    /// False when the config is shorter than its fixed fields, the getters return 0 then
     bool Parse() {
         if (data_.size() < 2) {
-            printf("Audio specific config requires at least 2 bytes of data");
             return false;
         }
 
-        static int SamplingRate[15] = {96000, 88200, 64000, 48000, 44100, 32000, 240000, 22050,
+        static int SamplingRate[15] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050,
                                        16000, 12000, 11025, 8000,  7350,  0,     0};
 
-        int freqIndex;
-        // 1111'1000-0000'0000
-        objectType_ = (data_[0] >> 3) & 0x1f;
-        if (objectType_ != 31) {
-            // 0000'0111-1000'0000
-            freqIndex = ((data_[0] & 0x07) << 1) | ((data_[1] >> 7) & 0x01);
-            if (freqIndex != 15) {
-                printf("freq: %d\n", freqIndex);
-                samplingRate_ = SamplingRate[freqIndex];
-                // 0000'0000-0111'1000
-                channels_ = (data_[1] >> 3) & 0x0f;
-            } else {
-                if (data_.size() < 5) {
-                    printf("Audio specific config requires at least 5 bytes of data");
-                    return false;
-                }
-                // 0000'0000-0111'1111-1111'1111-1111'1111-1000'0000
-                samplingRate_ = ((data_[1] & 0x7f) << 17) | (data_[2] << 9) | (data_[3] << 1) | (data_[4] >> 7) & 0x01;
-                // 0000'0000-00000'0000-0000'0000-0000'0000-0111'1000
-                channels_ = (data_[4] >> 3) & 0x0f;
-            }
+        BitReader reader((const uint8_t *)data_.data(), data_.size());
+        objectType_ = reader.ReadBits(5);
+        if (objectType_ == 31) {
+            objectType_ = 32 + reader.ReadBits(6);
+        }
+
+        int freqIndex = reader.ReadBits(4);
+        if (freqIndex != 15) {
+            samplingRate_ = SamplingRate[freqIndex];
         } else {
-            // 0000'0111-1110'0000
-            objectType_ = 32 + (((data_[0] & 0x07) << 3) | (data_[1] >> 5) & 0x07);
-            // 0000'0000-0001'1110
-            freqIndex = (data_[1] >> 1) & 0x0f;
-            if (freqIndex != 15) {
-                if (data_.size() < 3) {
-                    printf("Audio specific config requires at least 3 bytes of data");
-                    return false;
-                }
-                samplingRate_ = SamplingRate[freqIndex];
-
-                // 0000'0000-0000'0001-1110‘0000
-                channels_ = (data_[1] & 0x01) << 3 | (data_[2] >> 5) & 0x07;
-            } else {
-                if (data_.size() < 6) {
-                    printf("Audio specific config requires at least 3 bytes of data");
-                    return false;
-                }
-
-                // 0000'0000-0000'0001-1111’1111-1111‘1111-1111’1110
-                samplingRate_ = ((data_[1] & 0x01) << 23) | (data_[2] << 15) | (data_[3] << 7) | (data_[4] >> 1) & 0x7f;
-                // 0000'0000-0000'0000-0000’0000-0000‘0000-0000’0001-1110'0000
-                channels_ = ((data_[4] & 0x01) << 3) | ((data_[5] >> 5) & 0x07);
-            }
+            samplingRate_ = reader.ReadBits(24);
+        }
+        channels_ = reader.ReadBits(4);
+
+        if (reader.Overrun()) {
+            return false;
         }
 
         if (channels_ == 7) {
@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_BIT_READER_H
+#define FLV_MEDIA_BIT_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// MSB-first bit reader over a 64 bits cache.
+///
+/// With `rbsp` set the input is a NALU payload and emulation prevention bytes (00 00 03) are dropped while
+/// refilling, so no unescaped copy is needed. Reading past the end yields zero bits and sets Overrun().
+class BitReader {
+public:
+    BitReader(const uint8_t *data, size_t size, bool rbsp = false) : p_(data), end_(data + size), rbsp_(rbsp) {}
+
+    /// Up to 32 bits
+    uint32_t ReadBits(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        if (count_ < n) {
+            Refill();
+            if (count_ < n) {
+                overrun_ = true;
+                count_ = n; // the cache is zero padded
+            }
+        }
+        uint32_t value = cache_ >> (64 - n);
+        cache_ <<= n;
+        count_ -= n;
+        return value;
+    }
+
+    bool ReadBit() { return ReadBits(1); }
+
+    void SkipBits(size_t n) {
+        while (n > 32) {
+            ReadBits(32);
+            n -= 32;
+        }
+        ReadBits((int)n);
+    }
+
+    /// Unsigned exp-Golomb, ue(v)
+    uint32_t ReadUE() {
+        if (count_ < 32) {
+            Refill();
+        }
+        if (cache_ == 0) {
+            overrun_ = true;
+            return 0;
+        }
+
+        int zeros = __builtin_clzll(cache_);
+        if (zeros > 31) {
+            overrun_ = true;
+            return 0;
+        }
+        if (2 * zeros + 1 <= count_) {
+            // the whole code is cached, the common case
+            int n = 2 * zeros + 1;
+            uint32_t value = (uint32_t)(cache_ >> (64 - n)) - 1;
+            cache_ <<= n;
+            count_ -= n;
+            return value;
+        }
+        ReadBits(zeros);
+        return (uint32_t)((uint64_t)ReadBits(zeros + 1) - 1);
+    }
+
+    /// Signed exp-Golomb, se(v)
+    int32_t ReadSE() {
+        uint32_t code = ReadUE();
+        return (code & 1) ? (int32_t)((code >> 1) + 1) : -(int32_t)(code >> 1);
+    }
+
+    void ByteAlign() { ReadBits(count_ & 7); }
+
+    bool Overrun() const { return overrun_; }
+
+private:
+    void Refill() {
+        if (end_ - p_ >= 8) {
+            uint64_t word;
+            memcpy(&word, p_, 8);
+            word = __builtin_bswap64(word);
+            // no zero byte means no emulation prevention byte either
+            if (!rbsp_ || (zeros_ < 2 && !((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL))) {
+                int bytes = (64 - count_) >> 3;
+                cache_ |= bytes == 8 ? word : word >> (64 - bytes * 8) << (64 - count_ - bytes * 8);
+                p_ += bytes;
+                count_ += bytes * 8;
+                zeros_ = 0;
+                return;
+            }
+        }
+
+        while (count_ <= 56 && p_ < end_) {
+            uint8_t byte = *p_++;
+            if (rbsp_) {
+                if (zeros_ >= 2 && byte == 0x03) {
+                    zeros_ = 0;
+                    continue;
+                }
+                zeros_ = byte == 0 ? zeros_ + 1 : 0;
+            }
+            cache_ |= (uint64_t)byte << (56 - count_);
+            count_ += 8;
+        }
+    }
+
+private:
+    const uint8_t *p_;
+    const uint8_t *end_;
+    uint64_t cache_ = 0;
+    int count_ = 0; // valid bits at the top of cache_
+    int zeros_ = 0; // consecutive zero bytes, for emulation prevention
+    bool rbsp_;
+    bool overrun_ = false;
+};
+
+#endif // FLV_MEDIA_BIT_READER_H
@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "ByteSource.h"
+#include "Log.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/// Reads until `size` bytes are in or the input ends
+size_t Fill(int fd, uint8_t *buffer, uint64_t offset, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = pread(fd, buffer + got, size - got, (off_t)(offset + got));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        got += n;
+    }
+    return got;
+}
+
+/// Where a request costs a round trip, reading more per request pays off sooner
+bool IsNetworkFileSystem(int fd) {
+    struct statfs fs {};
+    if (fstatfs(fd, &fs) != 0) {
+        return false;
+    }
+    switch ((uint32_t)fs.f_type) {
+        case 0x6969:     // NFS
+        case 0x517B:     // SMB
+        case 0xFF534D42: // CIFS
+        case 0xFE534D42: // SMB2
+        case 0x00C36400: // Ceph
+        case 0x01021997: // 9P
+        case 0x65735546: // FUSE, sshfs, s3fs and friends
+            return true;
+        default:
+            return false;
+    }
+}
+
+class MappedSource : public ByteSource {
+public:
+    MappedSource(const uint8_t *data, uint64_t size, int fd) : ByteSource(MAP, data, size), fd_(fd) {}
+    ~MappedSource() override {
+        munmap((void *)data_, size_);
+        close(fd_);
+    }
+
+private:
+    int fd_;
+};
+
+class PreadSource : public ByteSource {
+public:
+    PreadSource(int fd, uint64_t size, const ReadPlanner::Options &options)
+        : ByteSource(PREAD, nullptr, size), fd_(fd), planner_(options) {}
+    ~PreadSource() override { close(fd_); }
+
+    const uint8_t *Read(uint64_t offset, size_t size) override {
+        if (offset >= windowStart_ && offset - windowStart_ + size <= windowSize_) {
+            return window_.data() + (offset - windowStart_);
+        }
+        if (!Contains(offset, size)) {
+            return nullptr;
+        }
+
+        ReadPlanner::Request request = planner_.Plan(offset, size, size_);
+        if (window_.size() < request.size) {
+            window_.resize(request.size);
+        }
+        windowStart_ = request.offset;
+        windowSize_ = Fill(fd_, window_.data(), request.offset, request.size);
+        bytesRead_ += windowSize_;
+        reads_++;
+        return offset - windowStart_ + size <= windowSize_ ? window_.data() + (offset - windowStart_) : nullptr;
+    }
+
+    /// Pieces in the window are copied from it, others are read straight into `buffer`
+    bool ReadAt(uint64_t offset, uint8_t *buffer, size_t size) override {
+        if (offset >= windowStart_ && offset - windowStart_ + size <= windowSize_) {
+            memcpy(buffer, window_.data() + (offset - windowStart_), size);
+            return true;
+        }
+        if (!Contains(offset, size)) {
+            return false;
+        }
+        size_t got = Fill(fd_, buffer, offset, size);
+        bytesRead_ += got;
+        reads_++;
+        return got == size;
+    }
+
+private:
+    int fd_;
+    ReadPlanner planner_;
+    std::vector<uint8_t> window_;
+    uint64_t windowStart_ = 0;
+    size_t windowSize_ = 0;
+};
+
+class MemorySource : public ByteSource {
+public:
+    /// Wraps memory owned by somebody else
+    MemorySource(const uint8_t *data, size_t size) : ByteSource(MEMORY, data, size) {}
+    /// Owns the buffer, filled by `reads` read calls
+    MemorySource(std::vector<uint8_t> &&buffer, uint64_t reads)
+        : ByteSource(MEMORY, nullptr, 0), buffer_(std::move(buffer)) {
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        bytesRead_ = size_;
+        reads_ = reads;
+    }
+
+private:
+    std::vector<uint8_t> buffer_;
+};
+
+/// Reads a pipe, or a file that should not be mapped, to its end
+bool ReadAll(int fd, std::vector<uint8_t> &buffer, uint64_t &reads) {
+    size_t size = 0;
+    buffer.resize(64 * 1024);
+    while (true) {
+        if (size == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        ssize_t n = read(fd, buffer.data() + size, buffer.size() - size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        reads++;
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+    buffer.resize(size);
+    buffer.shrink_to_fit();
+    return true;
+}
+
+} // namespace
+
+std::shared_ptr<ByteSource> ByteSource::Open(const std::string &filename, Backend backend) {
+    int fd = filename == "-" ? dup(STDIN_FILENO) : open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        Log("open %s: %s", filename.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        Log("fstat %s: %s", filename.c_str(), strerror(error));
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0 && backend == MAP) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            return std::make_shared<MappedSource>((const uint8_t *)data, st.st_size, fd);
+        }
+        Log("mmap %s: %s", filename.c_str(), strerror(errno));
+    } else if (S_ISREG(st.st_mode) && backend == PREAD) {
+        ReadPlanner::Options options;
+        if (IsNetworkFileSystem(fd)) {
+            options.maxRequest = 4 * 1024 * 1024;
+            options.maxGap = 1024 * 1024;
+        }
+        // the planner does the read-ahead, the kernel's would fetch the skipped tag bodies too
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+        return std::make_shared<PreadSource>(fd, st.st_size, options);
+    }
+
+    std::vector<uint8_t> buffer;
+    uint64_t reads = 0;
+    if (!ReadAll(fd, buffer, reads)) {
+        int error = errno;
+        Log("read %s: %s", filename.c_str(), strerror(error));
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+    close(fd);
+    return std::make_shared<MemorySource>(std::move(buffer), reads);
+}
+
+std::shared_ptr<ByteSource> ByteSource::Wrap(const uint8_t *data, size_t size) {
+    return std::make_shared<MemorySource>(data, size);
+}
+
+const uint8_t *ByteSource::Read(uint64_t offset, size_t size) {
+    return Contains(offset, size) ? data_ + offset : nullptr;
+}
+
+bool ByteSource::ReadAt(uint64_t offset, uint8_t *buffer, size_t size) {
+    if (!Contains(offset, size)) {
+        return false;
+    }
+    memcpy(buffer, data_ + offset, size);
+    return true;
+}
@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_BYTE_SOURCE_H
+#define FLV_MEDIA_BYTE_SOURCE_H
+
+#include "ReadPlanner.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// Input bytes of a file, a pipe or memory, behind one interface.
+///
+///  - MAP: the file mapped read-only, for modes that go through all of it
+///  - PREAD: pread() into a window planned by a ReadPlanner, for walkers that jump from tag header to tag header.
+///    Nothing is mapped, so a header costs no page fault, and dense headers share one big request. On
+///    network file systems, where a request costs a round trip, requests and the gaps read through may be bigger.
+///  - MEMORY: the whole input in a buffer. Pipes and stdin ("-") can be neither mapped nor pread, they are read
+///    into memory whatever backend was asked for.
+class ByteSource {
+public:
+    enum Backend { MAP, PREAD, MEMORY };
+
+    /// `backend` is the one wanted, see above for when another is used; nullptr when the input can not be read
+    static std::shared_ptr<ByteSource> Open(const std::string &filename, Backend backend);
+    /// Memory the caller owns and keeps alive
+    static std::shared_ptr<ByteSource> Wrap(const uint8_t *data, size_t size);
+
+    virtual ~ByteSource() = default;
+
+    Backend GetBackend() const { return backend_; }
+    uint64_t GetSize() const { return size_; }
+
+    /// The whole input, nullptr for PREAD
+    const uint8_t *GetData() const { return data_; }
+
+    /// nullptr when [offset, offset + size) is not in the input or the read fails. The pointer is good until the
+    /// next Read() or ReadAt().
+    virtual const uint8_t *Read(uint64_t offset, size_t size);
+
+    /// Copies a piece of any size into `buffer`
+    virtual bool ReadAt(uint64_t offset, uint8_t *buffer, size_t size);
+
+    /// What was fetched from the input by read calls, 0 for mapped and wrapped memory
+    uint64_t GetBytesRead() const { return bytesRead_; }
+    uint64_t GetReads() const { return reads_; }
+
+protected:
+    ByteSource(Backend backend, const uint8_t *data, uint64_t size) : backend_(backend), data_(data), size_(size) {}
+
+    bool Contains(uint64_t offset, size_t size) const { return offset <= size_ && size <= size_ - offset; }
+
+protected:
+    Backend backend_;
+    const uint8_t *data_;
+    uint64_t size_;
+    uint64_t bytesRead_ = 0;
+    uint64_t reads_ = 0;
+};
+
+#endif // FLV_MEDIA_BYTE_SOURCE_H
@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "CodecTraits.h"
+
+bool ClassifyVideoTag(const uint8_t *data, size_t size, VideoConfigurations &configs, FrameClass &frameClass) {
+    if (size <= sizeof(AVCVideoTagHeader)) {
+        return false;
+    }
+
+    bool keyFrame = IsVideoKeyFrame(data, size);
+    if (!(data[0] & 0x80)) {
+        auto tagHeader = (const AVCVideoTagHeader *)data;
+        if (((const VideoTagHeader *)data)->codec != CODEC_AVC) {
+            frameClass = keyFrame ? FRAME_KEY : FRAME_REFERENCE;
+            return true;
+        }
+        size_t skip = tagHeader->packetType == AVC_NALU ? 2 : sizeof(AVCVideoTagHeader);
+        return ClassifyVideoPacket<AVCTraits>(configs.avc, (VideoPacketType)tagHeader->packetType, keyFrame,
+                                              data + skip, size - skip, frameClass);
+    }
+
+    if (size <= sizeof(ExVideoTagHeader)) {
+        return false;
+    }
+    auto tagHeader = (const ExVideoTagHeader *)data;
+    const uint8_t *payload = tagHeader->data;
+    size_t payloadSize = size - sizeof(ExVideoTagHeader);
+    switch (tagHeader->GetFourCC()) {
+        case FOURCC_AVC:
+            return ClassifyVideoPacket<AVCTraits>(configs.avc, tagHeader->packetType, keyFrame, payload,
+                                                  payloadSize, frameClass);
+        case FOURCC_HEVC:
+            return ClassifyVideoPacket<HEVCTraits>(configs.hevc, tagHeader->packetType, keyFrame, payload,
+                                                   payloadSize, frameClass);
+        case FOURCC_AV1:
+            return ClassifyVideoPacket<AV1Traits>(configs.av1, tagHeader->packetType, keyFrame, payload,
+                                                  payloadSize, frameClass);
+        case FOURCC_VP9:
+            return ClassifyVideoPacket<VP9Traits>(configs.vp9, tagHeader->packetType, keyFrame, payload,
+                                                  payloadSize, frameClass);
+        default:
+            return false;
+    }
+}
+
+const char *VideoTagExtension(const uint8_t *data, size_t size) {
+    if (size <= sizeof(ExVideoTagHeader)) {
+        return nullptr;
+    }
+    if (!(data[0] & 0x80)) {
+        return AVCTraits::EXTENSION;
+    }
+    switch (((const ExVideoTagHeader *)data)->GetFourCC()) {
+        case FOURCC_HEVC:
+            return HEVCTraits::EXTENSION;
+        case FOURCC_AV1:
+            return AV1Traits::EXTENSION;
+        case FOURCC_VP9:
+            return VP9Traits::EXTENSION;
+        default:
+            return AVCTraits::EXTENSION;
+    }
+}
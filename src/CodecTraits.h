@@ -0,0 +1,315 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_CODEC_TRAITS_H
+#define FLV_MEDIA_CODEC_TRAITS_H
+
+#include "AV1Configuration.h"
+#include "AVCConfiguration.h"
+#include "AVCParser.h"
+#include "BitReader.h"
+#include "HEVCConfiguration.h"
+#include "FrameDropper.h"
+#include "Log.h"
+#include "VP9Configuration.h"
+#include "VideoTag.h"
+#include <cstddef>
+#include <cstdint>
+
+/// Compile-time video codec handling.
+///
+/// The demuxer picks the traits once per tag, everything below the dispatch is specialized per codec:
+///  - Configuration: the decoder configuration record parser
+///  - EXTENSION: elementary stream file extension
+///  - HAS_COMPOSITION_TIME: PACKET_CODED_FRAMES carries a 3 bytes composition time offset
+///  - OnSequenceStart(config, data, size, output)
+///  - Classify(config, keyFrame, data, size): the FrameClass of an access unit, from NALU headers where possible
+///  - EmitFrame(config, keyFrame, pts, data, size, output)
+/// `output` is any callable taking (const uint8_t *data, size_t size).
+
+static const uint8_t START_CODE[4] = {0x00, 0x00, 0x00, 0x01};
+
+/// Calls visit(nalu, size) for each NALU of length prefixed data until it returns false. False when a length
+/// is 0 or runs past the data.
+template <typename Visit>
+bool ForEachNALU(int lengthSize, const uint8_t *data, size_t size, Visit &&visit) {
+    const uint8_t *end = data + size;
+    const uint8_t *nalu = data;
+    while (nalu + lengthSize <= end) {
+        size_t naluSize = 0;
+        for (int i = 0; i < lengthSize; ++i) {
+            naluSize = naluSize << 8 | nalu[i];
+        }
+        nalu += lengthSize;
+        if (naluSize == 0 || naluSize > (size_t)(end - nalu)) {
+            return false;
+        }
+        if (!visit(nalu, naluSize)) {
+            break;
+        }
+        nalu += naluSize;
+    }
+    return true;
+}
+
+/// Length prefixed NALUs to Annex-B, parameter sets go in front of the first IRAP NALU of a frame
+template <typename Traits>
+struct NALUStream {
+    /// The first VCL NALU decides, Traits::ClassifyNALU returns false for non-VCL NALUs
+    template <typename Configuration>
+    static FrameClass Classify(const Configuration &config, bool keyFrame, const uint8_t *data, size_t size) {
+        FrameClass frameClass;
+        bool classified = false;
+        ForEachNALU(config.GetNALULengthSize(), data, size, [&](const uint8_t *nalu, size_t naluSize) {
+            classified = Traits::ClassifyNALU(nalu, naluSize, frameClass);
+            return !classified;
+        });
+        return classified ? frameClass : keyFrame ? FRAME_KEY : FRAME_REFERENCE;
+    }
+
+    template <typename Configuration, typename Output>
+    static void EmitFrame(Configuration &config, bool, uint32_t, const uint8_t *data, size_t size,
+                          const Output &output) {
+        bool parameterSets = false;
+        bool valid = ForEachNALU(config.GetNALULengthSize(), data, size, [&](const uint8_t *nalu, size_t naluSize) {
+            if (!parameterSets && Traits::IsIRAP(nalu)) {
+                Traits::EmitParameterSets(config, output);
+                parameterSets = true;
+                output(START_CODE + 1, 3);
+            } else {
+                output(START_CODE, 4);
+            }
+            output(nalu, naluSize);
+            return true;
+        });
+        if (!valid) {
+            Log("Invalid NALU size");
+        }
+    }
+};
+
+struct AVCTraits : NALUStream<AVCTraits> {
+    using Configuration = AVCConfiguration;
+    static constexpr const char *EXTENSION = ".h264";
+    static constexpr bool HAS_COMPOSITION_TIME = true;
+
+    static bool IsIRAP(const uint8_t *nalu) { return (nalu[0] & 0x1f) == 5; }
+
+    static bool ClassifyNALU(const uint8_t *nalu, size_t size, FrameClass &frameClass) {
+        int type = nalu[0] & 0x1f;
+        if (type == AVC_NALU_IDR) {
+            frameClass = FRAME_KEY;
+            return true;
+        }
+        if (type < AVC_NALU_SLICE || type > AVC_NALU_SLICE_DPA) {
+            return false;
+        }
+        if ((nalu[0] & 0x60) == 0) {
+            frameClass = FRAME_DISPOSABLE;
+            return true;
+        }
+
+        // first_mb_in_slice and slice_type lead the slice header, no parameter set needed
+        BitReader reader(nalu + 1, size - 1, true);
+        reader.ReadUE();
+        frameClass = reader.ReadUE() % 5 == AVC_SLICE_B ? FRAME_REFERENCE_B : FRAME_REFERENCE;
+        return true;
+    }
+
+    template <typename Output>
+    static void OnSequenceStart(Configuration &config, const uint8_t *data, size_t size, const Output &) {
+        if (config.SetConfigurationPacket(data, size)) {
+            Log("parameter sets generation %u", config.GetGeneration());
+        }
+    }
+
+    template <typename Output>
+    static void EmitParameterSets(Configuration &config, const Output &output) {
+        ByteSpan parameterSets = config.GetAnnexBParameterSets();
+        if (parameterSets.empty()) {
+            Log("IDR without SPS/PPS");
+            return;
+        }
+        output(parameterSets.data, parameterSets.size);
+    }
+};
+
+struct HEVCTraits : NALUStream<HEVCTraits> {
+    using Configuration = HEVCConfiguration;
+    static constexpr const char *EXTENSION = ".h265";
+    static constexpr bool HAS_COMPOSITION_TIME = true;
+
+    static bool IsIRAP(const uint8_t *nalu) {
+        int type = (nalu[0] >> 1) & 0x3f;
+        return type >= HEVC_NALU_BLA_W_LP && type <= HEVC_NALU_RSV_IRAP_23;
+    }
+
+    static bool ClassifyNALU(const uint8_t *nalu, size_t, FrameClass &frameClass) {
+        int type = (nalu[0] >> 1) & 0x3f;
+        if (type >= HEVC_NALU_BLA_W_LP && type <= HEVC_NALU_RSV_IRAP_23) {
+            frameClass = FRAME_KEY;
+        } else if (type <= HEVC_NALU_RSV_VCL_N14 && type % 2 == 0) {
+            frameClass = FRAME_DISPOSABLE; // TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N
+        } else if (type < HEVC_NALU_BLA_W_LP) {
+            frameClass = FRAME_REFERENCE;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Output>
+    static void OnSequenceStart(Configuration &config, const uint8_t *data, size_t size, const Output &) {
+        if (config.SetConfigurationPacket(data, size)) {
+            Log("parameter sets generation %u", config.GetGeneration());
+        }
+    }
+
+    template <typename Output>
+    static void EmitParameterSets(Configuration &config, const Output &output) {
+        ByteSpan parameterSets = config.GetAnnexBParameterSets();
+        if (!parameterSets.empty()) {
+            output(parameterSets.data, parameterSets.size);
+        }
+    }
+};
+
+/// AV1 to a low overhead OBU stream: a temporal delimiter per frame, the sequence header before keyframes
+struct AV1Traits {
+    using Configuration = AV1Configuration;
+    static constexpr const char *EXTENSION = ".obu";
+    static constexpr bool HAS_COMPOSITION_TIME = false;
+
+    template <typename Output>
+    static void OnSequenceStart(Configuration &config, const uint8_t *data, size_t size, const Output &) {
+        config.SetConfigurationPacket(data, size);
+    }
+
+    static FrameClass Classify(const Configuration &, bool keyFrame, const uint8_t *, size_t) {
+        return keyFrame ? FRAME_KEY : FRAME_REFERENCE;
+    }
+
+    template <typename Output>
+    static void EmitFrame(Configuration &config, bool keyFrame, uint32_t, const uint8_t *data, size_t size,
+                          const Output &output) {
+        static const uint8_t temporalDelimiter[2] = {0x12, 0x00};
+        output(temporalDelimiter, 2);
+        const std::string &obus = config.GetConfigOBUs();
+        if (keyFrame && !obus.empty()) {
+            output((const uint8_t *)obus.data(), obus.size());
+        }
+        output(data, size);
+    }
+};
+
+/// VP9 frames to IVF, timestamps in milliseconds
+struct VP9Traits {
+    struct Configuration : VP9Configuration {
+        bool ivfHeader = false;
+    };
+    static constexpr const char *EXTENSION = ".ivf";
+    static constexpr bool HAS_COMPOSITION_TIME = false;
+
+    template <typename Output>
+    static void OnSequenceStart(Configuration &config, const uint8_t *data, size_t size, const Output &) {
+        config.SetConfigurationPacket(data, size);
+    }
+
+    static FrameClass Classify(const Configuration &, bool keyFrame, const uint8_t *, size_t) {
+        return keyFrame ? FRAME_KEY : FRAME_REFERENCE;
+    }
+
+    template <typename Output>
+    static void EmitFrame(Configuration &config, bool, uint32_t pts, const uint8_t *data, size_t size,
+                          const Output &output) {
+        if (!config.ivfHeader) {
+            // DKIF, version 0, header size 32, VP90, size unknown, timebase 1/1000, frame count unknown
+            static const uint8_t header[32] = {'D', 'K', 'I', 'F', 0, 0, 32, 0, 'V', 'P', '9', '0', 0, 0, 0, 0,
+                                               0xe8, 0x03, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+            output(header, sizeof(header));
+            config.ivfHeader = true;
+        }
+
+        uint8_t frameHeader[12] = {uint8_t(size), uint8_t(size >> 8), uint8_t(size >> 16), uint8_t(size >> 24),
+                                   uint8_t(pts), uint8_t(pts >> 8), uint8_t(pts >> 16), uint8_t(pts >> 24)};
+        output(frameHeader, sizeof(frameHeader));
+        output(data, size);
+    }
+};
+
+/// Keeps the configuration current and classifies coded frames, returns false for any other packet
+template <typename Traits>
+bool ClassifyVideoPacket(typename Traits::Configuration &config, VideoPacketType packetType, bool keyFrame,
+                         const uint8_t *data, size_t size, FrameClass &frameClass) {
+    if (packetType == PACKET_SEQUENCE_START) {
+        config.SetConfigurationPacket(data, size);
+        return false;
+    }
+    if (packetType != PACKET_CODED_FRAMES && packetType != PACKET_CODED_FRAMES_X) {
+        return false;
+    }
+    if (packetType == PACKET_CODED_FRAMES && Traits::HAS_COMPOSITION_TIME) {
+        if (size < 3) {
+            return false;
+        }
+        data += 3;
+        size -= 3;
+    }
+    frameClass = Traits::Classify(config, keyFrame, data, size);
+    return true;
+}
+
+/// One video packet of any codec, legacy AVCPacketType values match VideoPacketType
+/// What DemuxVideoPacket handed to its output
+struct DemuxedFrame {
+    bool emitted = false;
+    uint32_t pts = 0;
+    FrameClass frameClass = FRAME_REFERENCE;
+};
+
+/// With a dropper, frames it refuses are dropped before any output work
+template <typename Traits, typename Output>
+DemuxedFrame DemuxVideoPacket(typename Traits::Configuration &config, VideoPacketType packetType, bool keyFrame,
+                              uint32_t dts, const uint8_t *data, size_t size, const Output &output,
+                              FrameDropper *dropper = nullptr) {
+    DemuxedFrame frame;
+    if (packetType == PACKET_SEQUENCE_START) {
+        Traits::OnSequenceStart(config, data, size, output);
+    } else if (packetType == PACKET_CODED_FRAMES || packetType == PACKET_CODED_FRAMES_X) {
+        frame.pts = dts;
+        if (packetType == PACKET_CODED_FRAMES && Traits::HAS_COMPOSITION_TIME) {
+            if (size < 3) {
+                return frame;
+            }
+            int32_t cts = data[0] << 16 | data[1] << 8 | data[2];
+            cts = (cts << 8) >> 8; // SI24
+            frame.pts = dts + cts;
+            data += 3;
+            size -= 3;
+        }
+        frame.frameClass = Traits::Classify(config, keyFrame, data, size);
+        if (dropper && !dropper->Admit(frame.frameClass)) {
+            return frame;
+        }
+        Traits::EmitFrame(config, keyFrame, frame.pts, data, size, output);
+        frame.emitted = true;
+    }
+    return frame;
+}
+
+/// The configurations of every codec, for callers that meet video tags of any codec
+struct VideoConfigurations {
+    AVCTraits::Configuration avc;
+    HEVCTraits::Configuration hevc;
+    AV1Traits::Configuration av1;
+    VP9Traits::Configuration vp9;
+};
+
+/// FrameClass of a video tag body, returns false for sequence headers and anything else that is not a frame
+bool ClassifyVideoTag(const uint8_t *data, size_t size, VideoConfigurations &configs, FrameClass &frameClass);
+
+/// Output file extension for the codec of a video tag body, nullptr when the body is too short to tell
+const char *VideoTagExtension(const uint8_t *data, size_t size);
+
+#endif // FLV_MEDIA_CODEC_TRAITS_H
@@ -0,0 +1,333 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "DemuxBenchmark.h"
+#include "AMF.h"
+#include "File.h"
+#include "FlvDemuxer.h"
+#include "JsonWriter.h"
+#include "TagRange.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory_resource>
+#include <stdexcept>
+
+namespace {
+
+/// Appends every frame to one growing buffer
+class BufferSink {
+public:
+    explicit BufferSink(size_t capacity) : buffer_(capacity) {}
+
+    void OnScript(const uint8_t *, size_t) {}
+    void OnConfig(TagType, uint32_t, const uint8_t *, size_t) {}
+    void BeginFrame(size_t sizeHint) {
+        size_ = frameStart_;
+        if (buffer_.size() - size_ < sizeHint) {
+            buffer_.resize(size_ + sizeHint * 2);
+        }
+    }
+    void Append(const uint8_t *data, size_t size) {
+        if (buffer_.size() - size_ < size) {
+            buffer_.resize((size_ + size) * 2);
+        }
+        memcpy(buffer_.data() + size_, data, size);
+        size_ += size;
+    }
+    void OnVideo(const FrameInfo &) { Commit(); }
+    void OnAudio(const FrameInfo &) { Commit(); }
+
+    void Clear() {
+        size_ = 0;
+        frameStart_ = 0;
+        frames_ = 0;
+    }
+    size_t GetSize() const { return frameStart_; }
+    uint64_t GetFrames() const { return frames_; }
+
+private:
+    void Commit() {
+        frameStart_ = size_;
+        frames_++;
+    }
+
+private:
+    std::vector<uint8_t> buffer_;
+    size_t size_ = 0;
+    size_t frameStart_ = 0; // end of the last complete frame
+    uint64_t frames_ = 0;
+};
+
+/// BufferSink with every piece going through a std::function
+class FunctionSink {
+public:
+    explicit FunctionSink(BufferSink &sink)
+        : sink_(sink), append_([&sink](const uint8_t *data, size_t size) { sink.Append(data, size); }) {}
+
+    void OnScript(const uint8_t *data, size_t size) { sink_.OnScript(data, size); }
+    void OnConfig(TagType stream, uint32_t generation, const uint8_t *data, size_t size) {
+        sink_.OnConfig(stream, generation, data, size);
+    }
+    void BeginFrame(size_t sizeHint) { sink_.BeginFrame(sizeHint); }
+    void Append(const uint8_t *data, size_t size) { append_(data, size); }
+    void OnVideo(const FrameInfo &frame) { sink_.OnVideo(frame); }
+    void OnAudio(const FrameInfo &frame) { sink_.OnAudio(frame); }
+
+private:
+    BufferSink &sink_;
+    std::function<void(const uint8_t *, size_t)> append_;
+};
+
+/// Runs `pass` once to warm up and then `passes` times, timed and counted
+template <typename Pass>
+DemuxBenchmark::Result Measure(const char *name, size_t size, uint32_t passes, PerfCounters &perf, Pass &&pass) {
+    DemuxBenchmark::Result result;
+    result.name = name;
+    result.passes = passes;
+    result.inputBytes = size;
+    for (uint32_t i = 0; i <= passes; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        perf.Start();
+        pass();
+        PerfCounters::Values counters = perf.Stop();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0) {
+            continue;
+        }
+        if (i == 1) {
+            result.counters = counters;
+        } else {
+            result.counters += counters;
+        }
+        if (result.seconds == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+    }
+    result.counters = result.counters.Divide(passes);
+    return result;
+}
+
+template <typename Sink, typename... Args>
+DemuxBenchmark::Result MeasureDemux(const char *name, const uint8_t *data, size_t size, uint32_t passes,
+                                    PerfCounters &perf, BufferSink &buffer, Args &&...args) {
+    uint64_t tags = 0;
+    DemuxBenchmark::Result result = Measure(name, size, passes, perf, [&]() {
+        buffer.Clear();
+        tags = 0;
+        // a fresh demuxer per pass, the configurations are part of the work
+        BasicFlvDemuxer<Sink> demuxer(std::forward<Args>(args)...);
+        for (const TagView &tag : TagRange(data, size)) {
+            demuxer.Demux(tag.GetHeader());
+            tags++;
+        }
+    });
+    result.tags = tags;
+    result.outputBytes = buffer.GetSize();
+    result.frames = buffer.GetFrames();
+    return result;
+}
+
+/// Script tag bodies of the data as they arrive from a noisy ingest: most are truncated or have a byte flipped,
+/// one in eight is intact. Empty when the data has no script tag.
+class AmfCorpus {
+public:
+    static const size_t ENTRIES = 4096;
+
+    AmfCorpus(const uint8_t *data, size_t size) {
+        std::vector<ByteSpan> scripts;
+        for (const TagView &tag : TagRange(data, size)) {
+            if (tag.type == TAG_SCRIPT && tag.payload.size > 0) {
+                scripts.push_back(tag.payload);
+            }
+        }
+        if (scripts.empty()) {
+            return;
+        }
+
+        uint64_t seed = 0x9e3779b97f4a7c15ULL;
+        for (size_t i = 0; i < ENTRIES; ++i) {
+            const ByteSpan &script = scripts[i % scripts.size()];
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            size_t at = (seed >> 33) % script.size;
+            size_t start = bytes_.size();
+            if (i % 8 == 7) {
+                bytes_.insert(bytes_.end(), script.data, script.data + script.size);
+            } else if (i % 2 == 0) {
+                bytes_.insert(bytes_.end(), script.data, script.data + at);
+            } else {
+                bytes_.insert(bytes_.end(), script.data, script.data + script.size);
+                bytes_[start + at] ^= (uint8_t)(1 << (seed >> 61));
+            }
+            entries_.emplace_back(start, bytes_.size() - start);
+        }
+    }
+
+    size_t GetEntries() const { return entries_.size(); }
+    size_t GetSize() const { return bytes_.size(); }
+
+    /// Calls `decode(data, size, resource)` for every entry, the arena is released in between
+    template <typename Decode>
+    uint64_t ForEach(Decode &&decode) {
+        uint64_t failures = 0;
+        for (const auto &entry : entries_) {
+            failures += decode(bytes_.data() + entry.first, entry.second, &arena_) ? 0 : 1;
+            arena_.release();
+        }
+        return failures;
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+    std::vector<std::pair<size_t, size_t>> entries_; // offset and size in bytes_
+
+    // the way PacketSink decodes, so the cases measure the decoder and not the heap
+    std::pmr::unsynchronized_pool_resource pool_{{0, 1024 * 1024}};
+    alignas(std::max_align_t) uint8_t buffer_[16 * 1024];
+    std::pmr::monotonic_buffer_resource arena_{buffer_, sizeof(buffer_), &pool_};
+};
+
+template <typename Decode>
+DemuxBenchmark::Result MeasureAmf(const char *name, AmfCorpus &corpus, uint32_t passes, PerfCounters &perf,
+                                  Decode &&decode) {
+    DemuxBenchmark::Result result =
+        Measure(name, corpus.GetSize(), passes, perf, [&]() { corpus.ForEach(decode); });
+    result.tags = corpus.GetEntries();
+    result.frames = corpus.GetEntries();
+    return result;
+}
+
+/// The number after `"key":` in a line of JSON, false when it is missing or null
+bool FindNumber(const std::string &line, const std::string &key, double &value) {
+    size_t pos = line.find('"' + key + "\":");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    const char *start = line.c_str() + pos + key.size() + 3;
+    char *end = nullptr;
+    value = strtod(start, &end);
+    return end != start;
+}
+
+} // namespace
+
+double DemuxBenchmark::Result::PerTag(PerfCounters::Counter counter) const {
+    return counters.valid[counter] && tags > 0 ? (double)counters.counts[counter] / tags : NAN;
+}
+
+double DemuxBenchmark::Result::PerByte(PerfCounters::Counter counter) const {
+    return counters.valid[counter] && inputBytes > 0 ? (double)counters.counts[counter] / inputBytes : NAN;
+}
+
+std::string DemuxBenchmark::Result::ToJson() const {
+    JsonWriter json;
+    json.BeginObject().Key("name").Value(name).Key("passes").Value(passes).Key("seconds").Value(seconds);
+    json.Key("inputBytes").Value(inputBytes).Key("outputBytes").Value(outputBytes);
+    json.Key("tags").Value(tags).Key("frames").Value(frames);
+    for (int i = 0; i < PerfCounters::COUNTER_COUNT; ++i) {
+        json.Key(PerfCounters::GetName((PerfCounters::Counter)i));
+        if (counters.valid[i]) {
+            json.Value(counters.counts[i]);
+        } else {
+            json.Null();
+        }
+    }
+    return json.EndObject().GetString();
+}
+
+std::vector<DemuxBenchmark::Result> DemuxBenchmark::Run(const uint8_t *data, size_t size, uint32_t passes) {
+    BufferSink buffer(size + size / 8);
+    PerfCounters perf;
+    if (!perf.IsAvailable()) {
+        printf("performance counters unavailable, wall clock only\n");
+    }
+
+    std::vector<Result> results;
+    uint64_t tags = 0;
+    uint64_t checksum = 0;
+    results.push_back(Measure("walk", size, passes, perf, [&]() {
+        tags = 0;
+        for (const TagView &tag : TagRange(data, size)) {
+            checksum += tag.payload.size;
+            tags++;
+        }
+    }));
+    results.back().tags = tags;
+    results.back().outputBytes = checksum / (passes + 1);
+    results.push_back(MeasureDemux<BufferSink &>("inline", data, size, passes, perf, buffer, buffer));
+    results.push_back(MeasureDemux<AnySink>("any", data, size, passes, perf, buffer, buffer));
+    results.push_back(MeasureDemux<FunctionSink>("function", data, size, passes, perf, buffer, buffer));
+
+    AmfCorpus corpus(data, size);
+    if (corpus.GetEntries() == 0) {
+        printf("no script tag, AMF cases skipped\n");
+        return results;
+    }
+    auto decodeThrowing = [](const uint8_t *script, size_t length, std::pmr::memory_resource *resource) {
+        try {
+            AMFDecoder decoder(script, length, 0, resource);
+            return !decoder.GetValues().empty();
+        } catch (const std::exception &) {
+            return false;
+        }
+    };
+    auto decodeStatus = [](const uint8_t *script, size_t length, std::pmr::memory_resource *resource) {
+        AMFDecoder decoder(script, length, 0, resource);
+        AMFDecoder::Values values(resource);
+        return decoder.Decode(values).Ok() && !values.empty();
+    };
+    uint64_t throwing = corpus.ForEach(decodeThrowing);
+    uint64_t status = corpus.ForEach(decodeStatus);
+    printf("AMF corpus: %zu script bodies, %lu malformed, %lu by status\n", corpus.GetEntries(),
+           (unsigned long)throwing, (unsigned long)status);
+    results.push_back(MeasureAmf("amf-throw", corpus, passes, perf, decodeThrowing));
+    results.push_back(MeasureAmf("amf-status", corpus, passes, perf, decodeStatus));
+    return results;
+}
+
+bool DemuxBenchmark::LoadBaseline(const std::string &filename, std::vector<Result> &results) {
+    std::ifstream in(filename);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t start = line.find("\"name\":\"");
+        if (start == std::string::npos) {
+            continue;
+        }
+        start += 8;
+        Result result;
+        result.name = line.substr(start, line.find('"', start) - start);
+        double value;
+        result.seconds = FindNumber(line, "seconds", value) ? value : 0;
+        result.passes = FindNumber(line, "passes", value) ? (uint32_t)value : 0;
+        result.inputBytes = FindNumber(line, "inputBytes", value) ? (uint64_t)value : 0;
+        result.outputBytes = FindNumber(line, "outputBytes", value) ? (uint64_t)value : 0;
+        result.tags = FindNumber(line, "tags", value) ? (uint64_t)value : 0;
+        result.frames = FindNumber(line, "frames", value) ? (uint64_t)value : 0;
+        for (int i = 0; i < PerfCounters::COUNTER_COUNT; ++i) {
+            result.counters.valid[i] = FindNumber(line, PerfCounters::GetName((PerfCounters::Counter)i), value);
+            result.counters.counts[i] = result.counters.valid[i] ? (uint64_t)value : 0;
+        }
+        results.push_back(result);
+    }
+    return true;
+}
+
+bool DemuxBenchmark::SaveBaseline(const std::string &filename, const std::vector<Result> &results) {
+    auto writer = FileWriter::Open(filename);
+    if (!writer) {
+        return false;
+    }
+    bool ok = true;
+    for (const Result &result : results) {
+        ok = ok && writer->Write(result.ToJson() + "\n");
+    }
+    return ok;
+}
@@ -0,0 +1,56 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_DEMUX_BENCHMARK_H
+#define FLV_MEDIA_DEMUX_BENCHMARK_H
+
+#include "PerfCounters.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Demuxes FLV data in memory into a flat buffer, once per kind of sink, to compare the cost of the write path.
+///
+///  - walk: the tags are only iterated, what every other case costs at least
+///  - inline: the sink type is known to the demuxer, every Append() is inlined
+///  - any: the same sink behind AnySink, one indirect call per piece
+///  - function: a std::function per piece, the way frames were written before the demuxer took a sink
+///  - amf-throw, amf-status: the script tags of the data, mostly corrupted, decoded with GetValues() and
+///    exceptions or with Decode() and its status. In these cases a tag and a frame are one script body.
+///
+/// Where perf_event_open() is allowed, each case also reports hardware counters averaged over its passes.
+/// Results can be saved as JSON lines and compared against in a later run.
+class DemuxBenchmark {
+public:
+    struct Result {
+        std::string name;
+        uint32_t passes = 0;
+        double seconds = 0;      // the fastest pass
+        uint64_t inputBytes = 0; // per pass
+        uint64_t outputBytes = 0;
+        uint64_t tags = 0;
+        uint64_t frames = 0;
+        PerfCounters::Values counters; // per pass
+
+        double GetInputRate() const { return seconds > 0 ? inputBytes / seconds : 0; }
+        double GetNanosecondsPerFrame() const { return frames > 0 ? seconds * 1e9 / frames : 0; }
+        /// Counter per tag, NaN when the counter is invalid
+        double PerTag(PerfCounters::Counter counter) const;
+        /// Counter per input byte, NaN when the counter is invalid
+        double PerByte(PerfCounters::Counter counter) const;
+
+        /// One line of JSON, invalid counters are null
+        std::string ToJson() const;
+    };
+
+    /// `data` is the whole file, each case runs one warm-up pass and then `passes` timed ones
+    static std::vector<Result> Run(const uint8_t *data, size_t size, uint32_t passes);
+
+    /// Results saved with ToJson(), one per line; false when the file can not be read
+    static bool LoadBaseline(const std::string &filename, std::vector<Result> &results);
+    static bool SaveBaseline(const std::string &filename, const std::vector<Result> &results);
+};
+
+#endif // FLV_MEDIA_DEMUX_BENCHMARK_H
@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "DemuxPipeline.h"
+#include "FlvDemuxer.h"
+#include "FlvTagParser.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <unistd.h>
+
+static const char *STAGE_NAMES[] = {"flv-reader", "flv-parser", "flv-video", "flv-audio"};
+
+static void SetupStage(std::thread &thread, int stage, int cpu) {
+    pthread_setname_np(thread.native_handle(), STAGE_NAMES[stage]);
+    if (cpu < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) != 0) {
+        printf("can not pin %s to cpu %d\n", STAGE_NAMES[stage], cpu);
+    }
+}
+
+std::shared_ptr<DemuxPipeline> DemuxPipeline::Open(const std::string &filename, const std::string &videoName,
+                                                   const std::string &audioName, const Options &options) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return nullptr;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    auto video = FileWriter::Open(videoName, options.writeBlockSize);
+    auto audio = FileWriter::Open(audioName, options.writeBlockSize);
+    if (!video || !audio) {
+        close(fd);
+        return nullptr;
+    }
+    return std::shared_ptr<DemuxPipeline>(new DemuxPipeline(fd, std::move(video), std::move(audio), options));
+}
+
+DemuxPipeline::DemuxPipeline(int fd, std::shared_ptr<FileWriter> video, std::shared_ptr<FileWriter> audio,
+                             const Options &options)
+    : fd_(fd), video_(std::move(video)), audio_(std::move(audio)), options_(options),
+      fullChunks_(options.chunkCount), freeChunks_(options.chunkCount), videoPackets_(options.ringSize),
+      audioPackets_(options.ringSize) {
+    for (size_t i = 0; i < options_.chunkCount; ++i) {
+        buffers_.emplace_back(new uint8_t[options_.chunkSize]);
+    }
+}
+
+DemuxPipeline::~DemuxPipeline() {
+    close(fd_);
+}
+
+bool DemuxPipeline::Run() {
+    std::thread threads[] = {
+        std::thread(&DemuxPipeline::ReadStage, this),
+        std::thread(&DemuxPipeline::ParseStage, this),
+        std::thread(&DemuxPipeline::WriteStage, this, std::ref(videoPackets_), std::ref(*video_),
+                    std::ref(stats_.videoPackets), std::ref(stats_.videoStalls)),
+        std::thread(&DemuxPipeline::WriteStage, this, std::ref(audioPackets_), std::ref(*audio_),
+                    std::ref(stats_.audioPackets), std::ref(stats_.audioStalls)),
+    };
+    for (int i = 0; i < 4; ++i) {
+        SetupStage(threads[i], i, options_.cpus[i]);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    bool closed = video_->Close();
+    closed = audio_->Close() && closed;
+    return closed && !failed_;
+}
+
+void DemuxPipeline::ReadStage() {
+    size_t unused = 0;
+    while (!failed_.load(std::memory_order_relaxed)) {
+        Chunk chunk;
+        if (unused < buffers_.size()) {
+            chunk.data = buffers_[unused++].get();
+        } else if (freeChunks_.PopWait(&chunk, 1, &stats_.readerStalls) == 0) {
+            break;
+        }
+
+        // fill the whole chunk, a pipe hands out much less per read()
+        bool eof = false;
+        while (chunk.size < options_.chunkSize) {
+            ssize_t n = read(fd_, chunk.data + chunk.size, options_.chunkSize - chunk.size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                perror("read");
+                failed_ = true;
+            }
+            if (n <= 0) {
+                eof = true;
+                break;
+            }
+            chunk.size += n;
+        }
+
+        if (chunk.size > 0) {
+            stats_.bytes += chunk.size;
+            fullChunks_.PushAll(&chunk, 1);
+        }
+        if (eof) {
+            break;
+        }
+    }
+    fullChunks_.Close();
+}
+
+void DemuxPipeline::ParseStage() {
+    std::vector<MediaPacketPtr> videoBatch;
+    std::vector<MediaPacketPtr> audioBatch;
+    videoBatch.reserve(options_.batchSize);
+    audioBatch.reserve(options_.batchSize);
+    auto flush = [this](SpscRing<MediaPacketPtr> &ring, std::vector<MediaPacketPtr> &batch) {
+        stats_.parserStalls += ring.PushAll(batch.data(), batch.size());
+        batch.clear();
+    };
+
+    FlvDemuxer demuxer(pool_, [&](const MediaPacketPtr &packet) {
+        bool video = packet->stream == TAG_VIDEO;
+        auto &batch = video ? videoBatch : audioBatch;
+        batch.push_back(packet);
+        if (batch.size() == options_.batchSize) {
+            flush(video ? videoPackets_ : audioPackets_, batch);
+        }
+    });
+    FlvTagParser parser(nullptr, [&](const FlvTagHeader *tag) {
+        demuxer.Demux(tag);
+        stats_.tags++;
+    });
+
+    Chunk chunk;
+    // the parser copies what it keeps of a chunk, so a chunk goes back to the reader right after Push()
+    while (fullChunks_.PopWait(&chunk, 1) > 0) {
+        if (!failed_ && !parser.Push(chunk.data, chunk.size)) {
+            failed_ = true;
+        }
+        chunk.size = 0;
+        freeChunks_.PushAll(&chunk, 1);
+        // a batch never waits for more input
+        flush(videoPackets_, videoBatch);
+        flush(audioPackets_, audioBatch);
+    }
+    if (parser.GetPending() > 0) {
+        printf("Incomplete .flv file, %lu bytes left\n", (unsigned long)parser.GetPending());
+    }
+    videoPackets_.Close();
+    audioPackets_.Close();
+}
+
+void DemuxPipeline::WriteStage(SpscRing<MediaPacketPtr> &ring, FileWriter &writer, uint64_t &packets,
+                               uint64_t &stalls) {
+    std::vector<MediaPacketPtr> batch(options_.batchSize);
+    size_t n;
+    while ((n = ring.PopWait(batch.data(), batch.size(), &stalls)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!writer.Write(batch[i]->data(), batch[i]->size)) {
+                failed_ = true;
+            }
+            batch[i].Reset();
+        }
+        packets += n;
+    }
+}
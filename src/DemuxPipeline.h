@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_DEMUX_PIPELINE_H
+#define FLV_MEDIA_DEMUX_PIPELINE_H
+
+#include "File.h"
+#include "MediaPacket.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Demuxes one FLV file with the I/O and the parsing on separate threads.
+///
+/// A reader stage reads the input ahead into a fixed set of chunks, a parser stage turns the chunks into
+/// MediaPackets, and a video and an audio writer stage write the packets out. The stages are connected by
+/// bounded SPSC rings, so a stalled write holds up the parser only once a ring is full, and the used chunks
+/// go back to the reader through another ring. Packets are handed over in batches.
+class DemuxPipeline {
+public:
+    struct Options {
+        size_t chunkSize = 1024 * 1024;
+        size_t chunkCount = 8;   // read ahead
+        size_t ringSize = 1024;  // packets between the parser and a writer
+        size_t batchSize = 32;   // packets per hand-off
+        size_t writeBlockSize = 1024 * 1024;
+        int cpus[4] = {-1, -1, -1, -1}; // reader, parser, video writer, audio writer; -1 leaves a stage unpinned
+    };
+
+    /// Stall counts are the times a stage found its ring full (producers) or empty (consumers)
+    struct Stats {
+        uint64_t bytes = 0;
+        uint64_t tags = 0;
+        uint64_t videoPackets = 0;
+        uint64_t audioPackets = 0;
+        uint64_t readerStalls = 0;
+        uint64_t parserStalls = 0;
+        uint64_t videoStalls = 0;
+        uint64_t audioStalls = 0;
+    };
+
+    static std::shared_ptr<DemuxPipeline> Open(const std::string &filename, const std::string &videoName,
+                                               const std::string &audioName, const Options &options);
+    static std::shared_ptr<DemuxPipeline> Open(const std::string &filename, const std::string &videoName,
+                                               const std::string &audioName) {
+        return Open(filename, videoName, audioName, Options());
+    }
+
+    /// Runs all stages to the end of the input, false when the input is invalid or a write failed
+    bool Run();
+    const Stats &GetStats() const { return stats_; }
+
+    ~DemuxPipeline();
+
+private:
+    struct Chunk {
+        uint8_t *data = nullptr;
+        size_t size = 0;
+    };
+
+    DemuxPipeline(int fd, std::shared_ptr<FileWriter> video, std::shared_ptr<FileWriter> audio,
+                  const Options &options);
+
+    void ReadStage();
+    void ParseStage();
+    void WriteStage(SpscRing<MediaPacketPtr> &ring, FileWriter &writer, uint64_t &packets, uint64_t &stalls);
+
+private:
+    int fd_;
+    std::shared_ptr<FileWriter> video_;
+    std::shared_ptr<FileWriter> audio_;
+    Options options_;
+    Stats stats_;
+    std::atomic<bool> failed_{false};
+
+    // declared before the rings so that packets still in them go back to a living pool
+    PacketPool pool_;
+    std::vector<std::unique_ptr<uint8_t[]>> buffers_;
+    SpscRing<Chunk> fullChunks_;
+    SpscRing<Chunk> freeChunks_;
+    SpscRing<MediaPacketPtr> videoPackets_;
+    SpscRing<MediaPacketPtr> audioPackets_;
+};
+
+#endif // FLV_MEDIA_DEMUX_PIPELINE_H
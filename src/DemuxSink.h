@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_DEMUX_SINK_H
+#define FLV_MEDIA_DEMUX_SINK_H
+
+#include "FLV.h"
+#include "FrameDropper.h"
+#include <cstddef>
+#include <cstdint>
+
+/// A demuxed audio or video frame, without its bytes
+struct FrameInfo {
+    bool keyFrame = false;
+    FrameClass frameClass = FRAME_REFERENCE;
+    uint32_t dts = 0;        // milliseconds, the tag timestamp
+    uint32_t pts = 0;        // dts plus the composition time offset
+    uint32_t generation = 0; // codec configuration generation the frame belongs to
+};
+
+/// What BasicFlvDemuxer writes to. A sink is any class with these members, the demuxer is instantiated for it:
+///
+/// ```
+/// struct Sink {
+///     void OnScript(const uint8_t *data, size_t size);  // body of a script tag
+///     // body of a tag carrying a codec configuration, `generation` already counts it
+///     void OnConfig(TagType stream, uint32_t generation, const uint8_t *data, size_t size);
+///     void BeginFrame(size_t sizeHint);                 // a new frame starts, an unfinished one is abandoned
+///     void Append(const uint8_t *data, size_t size);    // the next piece of the current frame
+///     void OnVideo(const FrameInfo &frame);             // the current frame is complete
+///     void OnAudio(const FrameInfo &frame);
+/// };
+/// ```
+///
+/// Every piece of a frame goes through Append(), so with a sink known at compile time the whole write path is
+/// inlined into the demuxer. AnySink is the same interface behind one indirect call, for sinks chosen at run time.
+class AnySink {
+public:
+    template <typename Sink>
+    explicit AnySink(Sink &sink) : sink_(&sink), table_(&TABLE<Sink>) {}
+
+    void OnScript(const uint8_t *data, size_t size) { table_->onScript(sink_, data, size); }
+    void OnConfig(TagType stream, uint32_t generation, const uint8_t *data, size_t size) {
+        table_->onConfig(sink_, stream, generation, data, size);
+    }
+    void BeginFrame(size_t sizeHint) { table_->beginFrame(sink_, sizeHint); }
+    void Append(const uint8_t *data, size_t size) { table_->append(sink_, data, size); }
+    void OnVideo(const FrameInfo &frame) { table_->onVideo(sink_, frame); }
+    void OnAudio(const FrameInfo &frame) { table_->onAudio(sink_, frame); }
+
+private:
+    struct Table {
+        void (*onScript)(void *sink, const uint8_t *data, size_t size);
+        void (*onConfig)(void *sink, TagType stream, uint32_t generation, const uint8_t *data, size_t size);
+        void (*beginFrame)(void *sink, size_t sizeHint);
+        void (*append)(void *sink, const uint8_t *data, size_t size);
+        void (*onVideo)(void *sink, const FrameInfo &frame);
+        void (*onAudio)(void *sink, const FrameInfo &frame);
+    };
+
+    template <typename Sink>
+    static constexpr Table TABLE = {
+        [](void *sink, const uint8_t *data, size_t size) { ((Sink *)sink)->OnScript(data, size); },
+        [](void *sink, TagType stream, uint32_t generation, const uint8_t *data, size_t size) {
+            ((Sink *)sink)->OnConfig(stream, generation, data, size);
+        },
+        [](void *sink, size_t sizeHint) { ((Sink *)sink)->BeginFrame(sizeHint); },
+        [](void *sink, const uint8_t *data, size_t size) { ((Sink *)sink)->Append(data, size); },
+        [](void *sink, const FrameInfo &frame) { ((Sink *)sink)->OnVideo(frame); },
+        [](void *sink, const FrameInfo &frame) { ((Sink *)sink)->OnAudio(frame); },
+    };
+
+    void *sink_;
+    const Table *table_;
+};
+
+#endif // FLV_MEDIA_DEMUX_SINK_H
@@ -41,6 +41,24 @@ struct FlvTagHeader {
     uint8_t timestampExtended{};
     uint8_t streamId[3]{}; // Always 0
     uint8_t data[0];
+
+    uint32_t GetDataSize() const { return size[0] << 16 | size[1] << 8 | size[2]; }
+    uint32_t GetTimestamp() const {
+        return (uint32_t)timestampExtended << 24 | timestamp[0] << 16 | timestamp[1] << 8 | timestamp[2];
+    }
+
+    void SetDataSize(uint32_t n) {
+        size[0] = (n >> 16) & 0xff;
+        size[1] = (n >> 8) & 0xff;
+        size[2] = n & 0xff;
+    }
+
+    void SetTimestamp(uint32_t ts) {
+        timestamp[0] = (ts >> 16) & 0xff;
+        timestamp[1] = (ts >> 8) & 0xff;
+        timestamp[2] = ts & 0xff;
+        timestampExtended = (ts >> 24) & 0xff;
+    }
 };
 
 #endif // FLV_MEDIA_FLV_H
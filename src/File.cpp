@@ -1,98 +1,195 @@
-//
-// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
-//
-
-#include "File.h"
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <unistd.h>
-
-std::shared_ptr<FileReader> FileReader::Open(const std::string &filename) {
-    int fd = open(filename.c_str(), O_RDWR);
-    if (fd < 0) {
-        perror("open");
-        return nullptr;
-    }
-
-    struct stat sb {};
-    if (fstat(fd, &sb) == -1) {
-        perror("fstat");
-        return nullptr;
-    }
-
-    void *memAddr = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
-    if (memAddr == MAP_FAILED) {
-        perror("mmap");
-        return nullptr;
-    }
-
-    madvise(memAddr, sb.st_size, MADV_SEQUENTIAL);
-
-    return std::shared_ptr<FileReader>(new FileReader((uint8_t *)memAddr, sb.st_size, fd));
-}
-
-void FileReader::Close() {
-    if (data) {
-        munmap(data, size);
-        close(fd_);
-    }
-    data = nullptr;
-    size = 0;
-    fd_ = 0;
-}
-
-FileReader::~FileReader() {
-    Close();
-}
-
-std::shared_ptr<FileWriter> FileWriter::Open(const std::string &filename) {
-    FILE *fd = fopen(filename.c_str(), "wb");
-    if (!fd) {
-        return nullptr;
-    }
-
-    return std::shared_ptr<FileWriter>(new FileWriter(fd));
-}
-
-bool FileWriter::Write(const uint8_t *data, size_t size) {
-    if (fd_) {
-        size_t ret = fwrite(data, 1, size, fd_);
-        if (ret != size) {
-            totalSize_ += ret;
-            if (totalSize_ >= 4096) {
-                Flush();
-            }
-            return true;
-        }
-    }
-
-    return false;
-}
-
-bool FileWriter::Write(const char *data, size_t size) {
-    return Write((const uint8_t *)data, size);
-}
-
-bool FileWriter::Write(const std::string &str) {
-    return Write(str.c_str(), str.size());
-}
-
-void FileWriter::Flush() {
-    if (fd_) {
-        fflush(fd_);
-    }
-    totalSize_ = 0;
-}
-
-void FileWriter::Close() {
-    Flush();
-    if (fd_) {
-        fclose(fd_);
-        fd_ = nullptr;
-    }
-}
-
-FileWriter::~FileWriter() {
-    Close();
-}
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "File.h"
+#include "Log.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<FileReader> FileReader::Open(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        Log("open %s: %s", filename.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    struct stat sb {};
+    if (fstat(fd, &sb) == -1) {
+        int error = errno;
+        Log("fstat %s: %s", filename.c_str(), strerror(error));
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    void *memAddr = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memAddr == MAP_FAILED) {
+        int error = errno;
+        Log("mmap %s: %s", filename.c_str(), strerror(error));
+        close(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    madvise(memAddr, sb.st_size, MADV_SEQUENTIAL);
+
+    return std::shared_ptr<FileReader>(new FileReader((uint8_t *)memAddr, sb.st_size, fd));
+}
+
+void FileReader::Close() {
+    if (data) {
+        munmap(data, size);
+        close(fd_);
+    }
+    data = nullptr;
+    size = 0;
+    fd_ = 0;
+}
+
+FileReader::~FileReader() {
+    Close();
+}
+
+std::shared_ptr<FileWriter> FileWriter::Open(const std::string &filename, size_t blockSize, bool append) {
+    FILE *fd = fopen(filename.c_str(), append ? "r+b" : "wb");
+    if (!fd) {
+        Log("fopen %s: %s", filename.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    if (append && fseek(fd, 0, SEEK_END) != 0) {
+        int error = errno;
+        Log("fseek %s: %s", filename.c_str(), strerror(error));
+        fclose(fd);
+        errno = error;
+        return nullptr;
+    }
+
+    // stdio writes a full buffer at once and bypasses it for whole blocks, so most writes are block sized. A
+    // Flush() or Sync() writes out a partly filled buffer, and the next writes are no longer block aligned.
+    void *buffer = nullptr;
+    if (blockSize > 0) {
+        if (posix_memalign(&buffer, 4096, blockSize) != 0) {
+            fclose(fd);
+            return nullptr;
+        }
+        setvbuf(fd, (char *)buffer, _IOFBF, blockSize);
+    }
+
+    return std::shared_ptr<FileWriter>(new FileWriter(fd, buffer));
+}
+
+bool FileWriter::Write(const uint8_t *data, size_t size) {
+    if (fd_) {
+        size_t ret = fwrite(data, 1, size, fd_);
+        if (ret == size) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool FileWriter::Write(const char *data, size_t size) {
+    return Write((const uint8_t *)data, size);
+}
+
+bool FileWriter::Write(const std::string &str) {
+    return Write(str.c_str(), str.size());
+}
+
+bool FileWriter::WriteAt(size_t offset, const uint8_t *data, size_t size) {
+    if (!fd_) {
+        return false;
+    }
+
+    if (!Flush()) {
+        return false;
+    }
+    ssize_t ret = pwrite(fileno(fd_), data, size, (off_t)offset);
+    if (ret != (ssize_t)size) {
+        Log("pwrite: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileWriter::Flush() {
+    if (!fd_) {
+        return false;
+    }
+
+    // a failed buffered write only shows up here, or as the stream error flag
+    if (fflush(fd_) != 0 || ferror(fd_)) {
+        Log("fflush: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileWriter::Sync() {
+    if (!fd_) {
+        return false;
+    }
+
+    if (!Flush()) {
+        return false;
+    }
+    if (fdatasync(fileno(fd_)) != 0) {
+        Log("fdatasync: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileWriter::Preallocate(size_t offset, size_t size) {
+    if (!fd_) {
+        return false;
+    }
+
+    if (fallocate(fileno(fd_), FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)size) != 0) {
+        Log("fallocate: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileWriter::Truncate(size_t size) {
+    if (!fd_) {
+        return false;
+    }
+
+    if (!Flush()) {
+        return false;
+    }
+    if (ftruncate(fileno(fd_), (off_t)size) != 0) {
+        Log("ftruncate: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileWriter::Close() {
+    bool ok = true;
+    if (fd_) {
+        ok = Flush();
+        if (fclose(fd_) != 0) {
+            Log("fclose: %s", strerror(errno));
+            ok = false;
+        }
+        fd_ = nullptr;
+    }
+    free(buffer_);
+    buffer_ = nullptr;
+    return ok;
+}
+
+FileWriter::~FileWriter() {
+    Close();
+}
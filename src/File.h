@@ -1,51 +1,61 @@
-//
-// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
-//
-
-#ifndef FLV_MEDIA_FILE_H
-#define FLV_MEDIA_FILE_H
-
-#include <cstddef>
-#include <memory>
-#include <stdint.h>
-#include <string>
-
-class FileReader {
-public:
-    static std::shared_ptr<FileReader> Open(const std::string &filename);
-    void Close();
-
-    ~FileReader();
-
-private:
-    FileReader(uint8_t *data, size_t size, int fd) : data(data), size(size), fd_(fd) {}
-    FileReader() = default;
-
-public:
-    uint8_t *data = nullptr;
-    size_t size = 0;
-
-private:
-    int fd_ = 0;
-};
-
-class FileWriter {
-public:
-    static std::shared_ptr<FileWriter> Open(const std::string &filename);
-    bool Write(const uint8_t *data, size_t size);
-    bool Write(const char *data, size_t size);
-    bool Write(const std::string &str);
-    void Flush();
-    void Close();
-
-    ~FileWriter();
-
-private:
-    explicit FileWriter(FILE *fd) : fd_(fd) {}
-
-private:
-    FILE *fd_ = nullptr;
-    size_t totalSize_ = 0;
-};
-
-#endif // FLV_MEDIA_FILE_H
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FILE_H
+#define FLV_MEDIA_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+class FileReader {
+public:
+    static std::shared_ptr<FileReader> Open(const std::string &filename);
+    void Close();
+
+    ~FileReader();
+
+private:
+    FileReader(uint8_t *data, size_t size, int fd) : data(data), size(size), fd_(fd) {}
+    FileReader() = default;
+
+public:
+    uint8_t *data = nullptr;
+    size_t size = 0;
+
+private:
+    int fd_ = 0;
+};
+
+class FileWriter {
+public:
+    /// blockSize > 0 buffers writes into blocks of that size, append keeps the existing content
+    static std::shared_ptr<FileWriter> Open(const std::string &filename, size_t blockSize = 0, bool append = false);
+    bool Write(const uint8_t *data, size_t size);
+    bool Write(const char *data, size_t size);
+    bool Write(const std::string &str);
+    /// Overwrite already written bytes, buffered data is flushed first
+    bool WriteAt(size_t offset, const uint8_t *data, size_t size);
+    /// false when buffered data could not be written
+    bool Flush();
+    /// Flush and fdatasync
+    bool Sync();
+    /// Reserve disk extents for [offset, offset + size) without changing the file size
+    bool Preallocate(size_t offset, size_t size);
+    bool Truncate(size_t size);
+    /// false when anything written since the last successful Flush was lost
+    bool Close();
+
+    ~FileWriter();
+
+private:
+    FileWriter(FILE *fd, void *buffer) : fd_(fd), buffer_(buffer) {}
+
+private:
+    FILE *fd_ = nullptr;
+    void *buffer_ = nullptr;
+};
+
+#endif // FLV_MEDIA_FILE_H
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FileFollower.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<FileFollower> FileFollower::Open(const std::string &filename, const Options &options) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return nullptr;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // watched before the first read, so a write racing with it still wakes up poll()
+    int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0 ||
+        inotify_add_watch(inotifyFd, filename.c_str(),
+                          IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ATTRIB) < 0) {
+        perror("inotify");
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+        }
+        close(fd);
+        return nullptr;
+    }
+    return std::shared_ptr<FileFollower>(new FileFollower(fd, inotifyFd, options));
+}
+
+FileFollower::FileFollower(int fd, int inotifyFd, const Options &options)
+    : fd_(fd), inotifyFd_(inotifyFd), options_(options), buffer_(options.chunkSize) {}
+
+FileFollower::~FileFollower() {
+    close(inotifyFd_);
+    close(fd_);
+}
+
+FileFollower::StopReason FileFollower::Follow(const DataCallback &onData) {
+    using Clock = std::chrono::steady_clock;
+    StopReason reason = STOP_ERROR;
+    auto lastData = Clock::now();
+    bool closed = false;
+    bool removed = false;
+
+    while (true) {
+        uint64_t offset = offset_;
+        if (!Drain(onData, reason)) {
+            return reason;
+        }
+        if (offset_ != offset) {
+            lastData = Clock::now();
+        }
+        // the events are older than the data read after them, nothing is lost by stopping now
+        if (closed) {
+            return STOP_CLOSED;
+        }
+        if (removed) {
+            return STOP_REMOVED;
+        }
+
+        int timeout = -1;
+        if (options_.idleTimeout >= 0) {
+            auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - lastData).count();
+            if (idle >= options_.idleTimeout) {
+                return STOP_IDLE;
+            }
+            timeout = options_.idleTimeout - (int)idle;
+        }
+
+        pollfd pfd = {inotifyFd_, POLLIN, 0};
+        int ret = poll(&pfd, 1, timeout);
+        if (ret < 0 && errno != EINTR) {
+            perror("poll");
+            return STOP_ERROR;
+        }
+        if (ret <= 0) {
+            continue;
+        }
+
+        alignas(inotify_event) char events[4096];
+        ssize_t n;
+        uint32_t mask = 0;
+        while ((n = read(inotifyFd_, events, sizeof(events))) > 0) {
+            for (char *p = events; p < events + n;) {
+                auto event = (const inotify_event *)p;
+                mask |= event->mask;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        // without stopOnClose the close only woke us up, the next Drain() picks up what the writer left
+        closed |= options_.stopOnClose && (mask & IN_CLOSE_WRITE) != 0;
+        removed |= (mask & (IN_DELETE_SELF | IN_MOVE_SELF)) != 0;
+        // our own descriptor keeps a deleted file alive, so an unlink shows up as a link count change only
+        struct stat sb;
+        removed |= (mask & IN_ATTRIB) && fstat(fd_, &sb) == 0 && sb.st_nlink == 0;
+    }
+}
+
+bool FileFollower::Drain(const DataCallback &onData, StopReason &reason) {
+    while (true) {
+        ssize_t n = pread(fd_, buffer_.data(), buffer_.size(), (off_t)offset_);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("pread");
+            reason = STOP_ERROR;
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        offset_ += n;
+        if (!onData(buffer_.data(), n)) {
+            reason = STOP_CALLBACK;
+            return false;
+        }
+    }
+
+    struct stat sb;
+    if (fstat(fd_, &sb) < 0 || (uint64_t)sb.st_size < offset_) {
+        printf("file shrank below offset %lu\n", (unsigned long)offset_);
+        reason = STOP_ERROR;
+        return false;
+    }
+    return true;
+}
+
+const char *FileFollower::GetStopReasonName(StopReason reason) {
+    switch (reason) {
+        case STOP_IDLE:
+            return "idle";
+        case STOP_CLOSED:
+            return "closed";
+        case STOP_REMOVED:
+            return "removed";
+        case STOP_CALLBACK:
+            return "stopped";
+        default:
+            return "error";
+    }
+}
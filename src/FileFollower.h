@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FILE_FOLLOWER_H
+#define FLV_MEDIA_FILE_FOLLOWER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Tails a file that is still being written, like `tail -f`.
+///
+/// Everything already in the file is handed out first, then only the bytes appended since, read with pread()
+/// at the offset reached so far. Between writes the follower sleeps in poll() on an inotify watch of the file,
+/// so appended data is picked up as soon as the writer's write() returns. A writer closing the file is only a
+/// wake-up by default: many writers reopen the file for every append, so a close says nothing about the end.
+class FileFollower {
+public:
+    struct Options {
+        int idleTimeout = 10000; // milliseconds without new data before giving up, -1 waits forever
+        size_t chunkSize = 256 * 1024;
+        bool stopOnClose = false; // for a writer known to keep the file open until it is done
+    };
+
+    enum StopReason {
+        STOP_IDLE,     // no new data within the idle timeout
+        STOP_CLOSED,   // with stopOnClose, a writer closed the file and everything it wrote was handed out
+        STOP_REMOVED,  // the file was deleted or renamed
+        STOP_CALLBACK, // the callback asked to stop
+        STOP_ERROR,    // read error, or the file shrank
+    };
+
+    /// Returns false to stop following
+    using DataCallback = std::function<bool(const uint8_t *data, size_t size)>;
+
+    static std::shared_ptr<FileFollower> Open(const std::string &filename, const Options &options);
+    static std::shared_ptr<FileFollower> Open(const std::string &filename) { return Open(filename, Options()); }
+    ~FileFollower();
+
+    StopReason Follow(const DataCallback &onData);
+
+    uint64_t GetOffset() const { return offset_; }
+    static const char *GetStopReasonName(StopReason reason);
+
+private:
+    FileFollower(int fd, int inotifyFd, const Options &options);
+
+    /// Reads up to the current end of the file, false when following has to stop
+    bool Drain(const DataCallback &onData, StopReason &reason);
+
+private:
+    int fd_;
+    int inotifyFd_;
+    Options options_;
+    uint64_t offset_ = 0;
+    std::vector<uint8_t> buffer_;
+};
+
+#endif // FLV_MEDIA_FILE_FOLLOWER_H
@@ -0,0 +1,501 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FlvCatalog.h"
+#include "FlvProbe.h"
+#include "JsonWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <strings.h>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+enum ColumnType : uint8_t {
+    TYPE_U8,
+    TYPE_U32,
+    TYPE_U64,
+    TYPE_I64,
+    TYPE_F32,
+    TYPE_STRING32, // offset into the string pool
+    TYPE_STRING64,
+};
+
+struct ColumnInfo {
+    const char *name;
+    ColumnType type;
+    uint8_t width;
+};
+
+const ColumnInfo COLUMNS[FlvCatalog::COLUMN_COUNT] = {
+    {"path", TYPE_STRING64, 8},   {"mtime", TYPE_I64, 8},          {"size", TYPE_U64, 8},
+    {"valid", TYPE_U8, 1},        {"duration", TYPE_U32, 4},       {"videoCodec", TYPE_STRING32, 4},
+    {"width", TYPE_U32, 4},       {"height", TYPE_U32, 4},         {"frameRate", TYPE_F32, 4},
+    {"keyFrames", TYPE_U32, 4},   {"videoBitrate", TYPE_U32, 4},   {"audioCodec", TYPE_STRING32, 4},
+    {"sampleRate", TYPE_U32, 4},  {"channels", TYPE_U8, 1},        {"audioBitrate", TYPE_U32, 4},
+};
+
+const char MAGIC[4] = {'F', 'L', 'V', 'C'};
+const uint32_t VERSION = 1;
+
+/// At the start of the file, all offsets are from there. Columns start 8 bytes aligned.
+struct CatalogHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t columnCount;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t poolOffset;
+    uint64_t poolSize;
+    uint64_t columnOffsets[FlvCatalog::COLUMN_COUNT];
+};
+
+enum FilterOp { OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_CONTAINS };
+
+template <typename T>
+bool Compare(FilterOp op, T a, T b) {
+    switch (op) {
+        case OP_EQ:
+            return a == b;
+        case OP_NE:
+            return a != b;
+        case OP_LT:
+            return a < b;
+        case OP_LE:
+            return a <= b;
+        case OP_GT:
+            return a > b;
+        case OP_GE:
+            return a >= b;
+        default:
+            return false;
+    }
+}
+
+template <typename T>
+void FilterColumn(const T *column, size_t rows, FilterOp op, double value, std::vector<uint8_t> &selected) {
+    for (size_t i = 0; i < rows; ++i) {
+        selected[i] &= Compare<double>(op, (double)column[i], value);
+    }
+}
+
+uint32_t ToBitrate(double bitrate) {
+    return std::isfinite(bitrate) && bitrate > 0 ? (uint32_t)std::min(bitrate, 4e9) : 0;
+}
+
+FlvCatalog::Entry Probe(const std::string &path, int64_t mtime, uint64_t size) {
+    FlvProbe::Report report = FlvProbe::Probe(path);
+    FlvCatalog::Entry entry;
+    entry.path = path;
+    entry.mtime = mtime;
+    entry.size = size;
+    entry.valid = report.error.empty() && report.tags > 0;
+    entry.duration = report.duration;
+    entry.videoCodec = report.video.codec;
+    entry.width = report.video.width;
+    entry.height = report.video.height;
+    entry.frameRate = (float)report.video.frameRate;
+    entry.keyFrames = (uint32_t)report.keyFrames;
+    entry.videoBitrate = ToBitrate(report.video.GetBitrate());
+    entry.audioCodec = report.audio.codec;
+    entry.sampleRate = report.audio.sampleRate;
+    entry.channels = report.audio.channels;
+    entry.audioBitrate = ToBitrate(report.audio.GetBitrate());
+    return entry;
+}
+
+/// Collects the columns of a new catalog
+class CatalogBuilder {
+public:
+    CatalogBuilder() { pool_.push_back('\0'); }
+
+    void Add(const FlvCatalog::Entry &entry) {
+        Put(FlvCatalog::COLUMN_PATH, (uint64_t)Append(entry.path));
+        Put(FlvCatalog::COLUMN_MTIME, entry.mtime);
+        Put(FlvCatalog::COLUMN_SIZE, entry.size);
+        Put(FlvCatalog::COLUMN_VALID, (uint8_t)entry.valid);
+        Put(FlvCatalog::COLUMN_DURATION, entry.duration);
+        Put(FlvCatalog::COLUMN_VIDEO_CODEC, Intern(entry.videoCodec));
+        Put(FlvCatalog::COLUMN_WIDTH, entry.width);
+        Put(FlvCatalog::COLUMN_HEIGHT, entry.height);
+        Put(FlvCatalog::COLUMN_FRAME_RATE, entry.frameRate);
+        Put(FlvCatalog::COLUMN_KEY_FRAMES, entry.keyFrames);
+        Put(FlvCatalog::COLUMN_VIDEO_BITRATE, entry.videoBitrate);
+        Put(FlvCatalog::COLUMN_AUDIO_CODEC, Intern(entry.audioCodec));
+        Put(FlvCatalog::COLUMN_SAMPLE_RATE, entry.sampleRate);
+        Put(FlvCatalog::COLUMN_CHANNELS, (uint8_t)entry.channels);
+        Put(FlvCatalog::COLUMN_AUDIO_BITRATE, entry.audioBitrate);
+        rows_++;
+    }
+
+    bool Write(FileWriter &writer) {
+        CatalogHeader header{};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.columnCount = FlvCatalog::COLUMN_COUNT;
+        header.rows = rows_;
+        uint64_t offset = sizeof(CatalogHeader);
+        for (int i = 0; i < FlvCatalog::COLUMN_COUNT; ++i) {
+            header.columnOffsets[i] = offset;
+            offset = Align(offset + columns_[i].size());
+        }
+        header.poolOffset = offset;
+        header.poolSize = pool_.size();
+
+        static const uint8_t PADDING[8] = {};
+        bool ok = writer.Write((const uint8_t *)&header, sizeof(header));
+        for (auto &column : columns_) {
+            ok = ok && writer.Write(column.data(), column.size()) &&
+                 writer.Write(PADDING, Align(column.size()) - column.size());
+        }
+        return ok && writer.Write(pool_);
+    }
+
+private:
+    static uint64_t Align(uint64_t offset) { return (offset + 7) & ~(uint64_t)7; }
+
+    template <typename T>
+    void Put(FlvCatalog::Column column, T value) {
+        static_assert(std::is_trivially_copyable<T>::value, "columns hold plain values");
+        auto p = (const uint8_t *)&value;
+        columns_[column].insert(columns_[column].end(), p, p + sizeof(T));
+    }
+
+    uint64_t Append(const std::string &s) {
+        uint64_t offset = pool_.size();
+        pool_.append(s).push_back('\0');
+        return offset;
+    }
+
+    uint32_t Intern(const std::string &s) {
+        if (s.empty()) {
+            return 0;
+        }
+        auto it = interned_.find(s);
+        if (it == interned_.end()) {
+            it = interned_.emplace(s, (uint32_t)Append(s)).first;
+        }
+        return it->second;
+    }
+
+private:
+    uint64_t rows_ = 0;
+    std::vector<uint8_t> columns_[FlvCatalog::COLUMN_COUNT];
+    std::string pool_;
+    std::unordered_map<std::string, uint32_t> interned_;
+};
+
+struct FoundFile {
+    std::string path;
+    int64_t mtime;
+    uint64_t size;
+};
+
+void FindFiles(const std::string &root, std::vector<FoundFile> &files) {
+    namespace fs = std::filesystem;
+    auto add = [&files](const std::string &path) {
+        struct stat sb;
+        if (stat(path.c_str(), &sb) == 0 && S_ISREG(sb.st_mode)) {
+            files.push_back({path, (int64_t)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec, (uint64_t)sb.st_size});
+        }
+    };
+
+    std::error_code ec;
+    if (!fs::is_directory(root, ec)) {
+        add(root);
+        return;
+    }
+    for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        const fs::path &path = it->path();
+        if (it->is_regular_file(ec) && strcasecmp(path.extension().c_str(), ".flv") == 0) {
+            add(path.string());
+        }
+    }
+    if (ec) {
+        printf("%s: %s\n", root.c_str(), ec.message().c_str());
+    }
+}
+
+} // namespace
+
+std::string FlvCatalog::Entry::ToJson() const {
+    JsonWriter json;
+    json.BeginObject().Key("file").Value(path).Key("size").Value(size).Key("valid").Value(valid);
+    json.Key("duration").Value(duration);
+    if (!videoCodec.empty()) {
+        json.Key("video").BeginObject().Key("codec").Value(videoCodec);
+        json.Key("width").Value(width).Key("height").Value(height).Key("frameRate").Value((double)frameRate);
+        json.Key("keyFrames").Value(keyFrames).Key("bitrate").Value(videoBitrate).EndObject();
+    }
+    if (!audioCodec.empty()) {
+        json.Key("audio").BeginObject().Key("codec").Value(audioCodec);
+        json.Key("sampleRate").Value(sampleRate).Key("channels").Value(channels);
+        json.Key("bitrate").Value(audioBitrate).EndObject();
+    }
+    json.EndObject();
+    return json.GetString();
+}
+
+bool FlvCatalog::Build(const std::string &catalogName, const std::vector<std::string> &roots, unsigned threads,
+                       BuildStats &stats) {
+    std::vector<FoundFile> files;
+    for (auto &root : roots) {
+        FindFiles(root, files);
+    }
+    std::sort(files.begin(), files.end(), [](const FoundFile &a, const FoundFile &b) { return a.path < b.path; });
+    files.erase(std::unique(files.begin(), files.end(),
+                            [](const FoundFile &a, const FoundFile &b) { return a.path == b.path; }),
+                files.end());
+
+    // rows of the old catalog, by path
+    std::shared_ptr<FlvCatalog> old;
+    std::unordered_map<std::string_view, uint32_t> oldRows;
+    if (access(catalogName.c_str(), F_OK) == 0) {
+        old = Open(catalogName);
+        for (size_t i = 0; old && i < old->GetRows(); ++i) {
+            oldRows.emplace(old->GetString(old->GetColumn<uint64_t>(COLUMN_PATH)[i]), (uint32_t)i);
+        }
+    }
+
+    std::vector<Entry> entries(files.size());
+    std::vector<size_t> changed;
+    size_t kept = 0;
+    size_t present = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        auto it = oldRows.find(files[i].path);
+        present += it != oldRows.end();
+        if (it != oldRows.end() && old->GetColumn<int64_t>(COLUMN_MTIME)[it->second] == files[i].mtime &&
+            old->GetColumn<uint64_t>(COLUMN_SIZE)[it->second] == files[i].size) {
+            entries[i] = old->GetEntry(it->second);
+            kept++;
+        } else {
+            changed.push_back(i);
+        }
+    }
+    stats.files = files.size();
+    stats.reused = kept;
+    stats.probed = changed.size();
+    // a changed file is probed again, not removed
+    stats.removed = oldRows.size() - present;
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, changed.size()));
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) < changed.size()) {
+            const FoundFile &file = files[changed[i]];
+            entries[changed[i]] = Probe(file.path, file.mtime, file.size);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    CatalogBuilder builder;
+    for (auto &entry : entries) {
+        builder.Add(entry);
+    }
+    // readers of the old catalog keep their mapping, new readers see the whole new file or none of it
+    std::string tmpName = catalogName + ".tmp";
+    auto writer = FileWriter::Open(tmpName, 1024 * 1024);
+    if (!writer) {
+        return false;
+    }
+    // the new catalog must be on disk before it replaces the old one
+    bool ok = builder.Write(*writer) && writer->Sync();
+    ok = writer->Close() && ok;
+    if (!ok || rename(tmpName.c_str(), catalogName.c_str()) != 0) {
+        perror("write catalog");
+        unlink(tmpName.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<FlvCatalog> FlvCatalog::Open(const std::string &catalogName) {
+    auto reader = FileReader::Open(catalogName);
+    if (!reader) {
+        return nullptr;
+    }
+    std::shared_ptr<FlvCatalog> catalog(new FlvCatalog(std::move(reader)));
+    if (!catalog->Load()) {
+        printf("%s is not a catalog of this version\n", catalogName.c_str());
+        return nullptr;
+    }
+    return catalog;
+}
+
+FlvCatalog::FlvCatalog(std::shared_ptr<FileReader> reader) : reader_(std::move(reader)) {}
+
+bool FlvCatalog::Load() {
+    const uint8_t *data = reader_->data;
+    uint64_t size = reader_->size;
+    if (size < sizeof(CatalogHeader)) {
+        return false;
+    }
+    auto header = (const CatalogHeader *)data;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+        header->columnCount != COLUMN_COUNT) {
+        return false;
+    }
+    for (int i = 0; i < COLUMN_COUNT; ++i) {
+        uint64_t offset = header->columnOffsets[i];
+        if (offset % 8 != 0 || offset > size || (size - offset) / COLUMNS[i].width < header->rows) {
+            return false;
+        }
+        columns_[i] = data + offset;
+    }
+    // the pool ends with the NUL of its last string, so no string runs past the mapping
+    if (header->poolOffset > size || size - header->poolOffset < header->poolSize || header->poolSize == 0 ||
+        data[header->poolOffset + header->poolSize - 1] != '\0') {
+        return false;
+    }
+    pool_ = data + header->poolOffset;
+    poolSize_ = header->poolSize;
+    rows_ = header->rows;
+
+    auto inPool = [this](uint64_t offset) { return offset < poolSize_; };
+    for (size_t i = 0; i < rows_; ++i) {
+        if (!inPool(GetColumn<uint64_t>(COLUMN_PATH)[i]) || !inPool(GetColumn<uint32_t>(COLUMN_VIDEO_CODEC)[i]) ||
+            !inPool(GetColumn<uint32_t>(COLUMN_AUDIO_CODEC)[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FlvCatalog::Entry FlvCatalog::GetEntry(size_t row) const {
+    Entry entry;
+    entry.path = GetString(GetColumn<uint64_t>(COLUMN_PATH)[row]);
+    entry.mtime = GetColumn<int64_t>(COLUMN_MTIME)[row];
+    entry.size = GetColumn<uint64_t>(COLUMN_SIZE)[row];
+    entry.valid = GetColumn<uint8_t>(COLUMN_VALID)[row] != 0;
+    entry.duration = GetColumn<uint32_t>(COLUMN_DURATION)[row];
+    entry.videoCodec = GetString(GetColumn<uint32_t>(COLUMN_VIDEO_CODEC)[row]);
+    entry.width = GetColumn<uint32_t>(COLUMN_WIDTH)[row];
+    entry.height = GetColumn<uint32_t>(COLUMN_HEIGHT)[row];
+    entry.frameRate = GetColumn<float>(COLUMN_FRAME_RATE)[row];
+    entry.keyFrames = GetColumn<uint32_t>(COLUMN_KEY_FRAMES)[row];
+    entry.videoBitrate = GetColumn<uint32_t>(COLUMN_VIDEO_BITRATE)[row];
+    entry.audioCodec = GetString(GetColumn<uint32_t>(COLUMN_AUDIO_CODEC)[row]);
+    entry.sampleRate = GetColumn<uint32_t>(COLUMN_SAMPLE_RATE)[row];
+    entry.channels = GetColumn<uint8_t>(COLUMN_CHANNELS)[row];
+    entry.audioBitrate = GetColumn<uint32_t>(COLUMN_AUDIO_BITRATE)[row];
+    return entry;
+}
+
+bool FlvCatalog::Select(const std::vector<std::string> &filters, std::vector<uint32_t> &rows,
+                        std::string &error) const {
+    static const struct {
+        const char *text;
+        FilterOp op;
+    } OPS[] = {
+        {"<=", OP_LE}, {">=", OP_GE}, {"!=", OP_NE}, {"=", OP_EQ}, {"<", OP_LT}, {">", OP_GT}, {"~", OP_CONTAINS},
+    };
+
+    std::vector<uint8_t> selected(rows_, 1);
+    for (const std::string &filter : filters) {
+        size_t nameEnd = filter.find_first_of("=!<>~");
+        if (nameEnd == std::string::npos) {
+            error = "no operator in " + filter;
+            return false;
+        }
+        std::string name = filter.substr(0, nameEnd);
+        int column = 0;
+        while (column < COLUMN_COUNT && name != COLUMNS[column].name) {
+            column++;
+        }
+        if (column == COLUMN_COUNT) {
+            error = "unknown column " + name;
+            return false;
+        }
+        FilterOp op = OP_EQ;
+        size_t opLength = 0;
+        for (auto &candidate : OPS) {
+            if (filter.compare(nameEnd, strlen(candidate.text), candidate.text) == 0) {
+                op = candidate.op;
+                opLength = strlen(candidate.text);
+                break;
+            }
+        }
+        if (opLength == 0) {
+            error = "bad operator in " + filter;
+            return false;
+        }
+        std::string value = filter.substr(nameEnd + opLength);
+
+        ColumnType type = COLUMNS[column].type;
+        if (type == TYPE_STRING32 || type == TYPE_STRING64) {
+            // codec columns repeat a handful of offsets, each one is compared once
+            uint64_t lastOffset = UINT64_MAX;
+            bool lastMatch = false;
+            for (size_t i = 0; i < rows_; ++i) {
+                uint64_t offset = type == TYPE_STRING32 ? GetColumn<uint32_t>((Column)column)[i]
+                                                        : GetColumn<uint64_t>((Column)column)[i];
+                if (offset != lastOffset) {
+                    const char *s = GetString(offset);
+                    lastMatch = op == OP_CONTAINS ? strstr(s, value.c_str()) != nullptr
+                                                  : Compare(op, strcmp(s, value.c_str()), 0);
+                    lastOffset = offset;
+                }
+                selected[i] &= lastMatch;
+            }
+            continue;
+        }
+
+        char *end = nullptr;
+        double number = value == "true" ? 1 : value == "false" ? 0 : strtod(value.c_str(), &end);
+        if (op == OP_CONTAINS || (end && (end == value.c_str() || *end != '\0'))) {
+            error = "bad number or operator in " + filter;
+            return false;
+        }
+        switch (type) {
+            case TYPE_U8:
+                FilterColumn(GetColumn<uint8_t>((Column)column), rows_, op, number, selected);
+                break;
+            case TYPE_U32:
+                FilterColumn(GetColumn<uint32_t>((Column)column), rows_, op, number, selected);
+                break;
+            case TYPE_U64:
+                FilterColumn(GetColumn<uint64_t>((Column)column), rows_, op, number, selected);
+                break;
+            case TYPE_I64:
+                FilterColumn(GetColumn<int64_t>((Column)column), rows_, op, number, selected);
+                break;
+            default:
+                FilterColumn(GetColumn<float>((Column)column), rows_, op, number, selected);
+                break;
+        }
+    }
+
+    rows.clear();
+    for (size_t i = 0; i < rows_; ++i) {
+        if (selected[i]) {
+            rows.push_back((uint32_t)i);
+        }
+    }
+    return true;
+}
+
+const char *FlvCatalog::GetColumnName(Column column) {
+    return COLUMNS[column].name;
+}
@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FLV_CATALOG_H
+#define FLV_MEDIA_FLV_CATALOG_H
+
+#include "File.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Probe results of a whole library of FLV files in one columnar file.
+///
+/// The file is a header, one fixed-width column per field and a string pool for the paths and codec names,
+/// each codec name stored once. It is used straight from a read-only mapping: a filter runs down the columns it
+/// names only, so a query over millions of rows touches a few MB instead of reprobing any file. Rows are
+/// sorted by path.
+///
+/// Build() reuses the rows of an existing catalog for files whose mtime and size did not change and probes only
+/// the others, in parallel.
+class FlvCatalog {
+public:
+    enum Column {
+        COLUMN_PATH = 0,
+        COLUMN_MTIME,
+        COLUMN_SIZE,
+        COLUMN_VALID,
+        COLUMN_DURATION,
+        COLUMN_VIDEO_CODEC,
+        COLUMN_WIDTH,
+        COLUMN_HEIGHT,
+        COLUMN_FRAME_RATE,
+        COLUMN_KEY_FRAMES,
+        COLUMN_VIDEO_BITRATE,
+        COLUMN_AUDIO_CODEC,
+        COLUMN_SAMPLE_RATE,
+        COLUMN_CHANNELS,
+        COLUMN_AUDIO_BITRATE,
+        COLUMN_COUNT
+    };
+
+    /// One row
+    struct Entry {
+        std::string path;
+        int64_t mtime = 0; // nanoseconds since the epoch
+        uint64_t size = 0;
+        bool valid = false;    // the probe walked the whole file
+        uint32_t duration = 0; // milliseconds
+        std::string videoCodec;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        float frameRate = 0;
+        uint32_t keyFrames = 0;
+        uint32_t videoBitrate = 0; // bits per second
+        std::string audioCodec;
+        uint32_t sampleRate = 0;
+        uint32_t channels = 0;
+        uint32_t audioBitrate = 0;
+
+        /// One line of JSON
+        std::string ToJson() const;
+    };
+
+    struct BuildStats {
+        uint64_t files = 0;   // in the new catalog
+        uint64_t probed = 0;  // new or changed
+        uint64_t reused = 0;  // unchanged since the old catalog
+        uint64_t removed = 0; // in the old catalog, gone now
+    };
+
+    /// Scans `roots` (directories, recursively, or single files) for *.flv and writes the catalog, replacing
+    /// the old one atomically. 0 threads means one per CPU.
+    static bool Build(const std::string &catalogName, const std::vector<std::string> &roots, unsigned threads,
+                      BuildStats &stats);
+
+    static std::shared_ptr<FlvCatalog> Open(const std::string &catalogName);
+
+    size_t GetRows() const { return rows_; }
+    Entry GetEntry(size_t row) const;
+
+    /// Rows matching all filters. A filter is `column op value` with op one of = != < <= > >=, and ~ for a
+    /// substring of a string column, e.g. `videoCodec=H.264` `width>=1920` `path~/2023/`.
+    bool Select(const std::vector<std::string> &filters, std::vector<uint32_t> &rows, std::string &error) const;
+
+    static const char *GetColumnName(Column column);
+
+private:
+    explicit FlvCatalog(std::shared_ptr<FileReader> reader);
+
+    bool Load();
+    const char *GetString(uint64_t offset) const { return (const char *)pool_ + offset; }
+    template <typename T>
+    const T *GetColumn(Column column) const {
+        return (const T *)columns_[column];
+    }
+
+private:
+    std::shared_ptr<FileReader> reader_;
+    size_t rows_ = 0;
+    const uint8_t *columns_[COLUMN_COUNT] = {};
+    const uint8_t *pool_ = nullptr;
+    uint64_t poolSize_ = 0;
+};
+
+#endif // FLV_MEDIA_FLV_CATALOG_H
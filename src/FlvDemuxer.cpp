@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FlvDemuxer.h"
+#include "AMF.h"
+#include "AVCParser.h"
+#include "Log.h"
+#include "TagRange.h"
+#include <algorithm>
+#include <ostream>
+#include <streambuf>
+
+namespace {
+
+const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+
+/// Hands what is written to it to Log() line by line, through a fixed buffer, so a dump allocates nothing.
+/// There is no put area, every character goes through overflow() or xsputn() and is looked at.
+class LogLineBuffer : public std::streambuf {
+public:
+    ~LogLineBuffer() override {
+        if (size_ > 0) {
+            Emit();
+        }
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) {
+            Put((char)c);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        for (std::streamsize i = 0; i < n; ++i) {
+            Put(s[i]);
+        }
+        return n;
+    }
+
+private:
+    void Put(char c) {
+        if (c == '\n') {
+            Emit();
+            return;
+        }
+        if (size_ == sizeof(line_) - 1) {
+            Emit(); // a line longer than the buffer goes out in pieces
+        }
+        line_[size_++] = c;
+    }
+
+    void Emit() {
+        line_[size_] = '\0';
+        Log("%s", line_);
+        size_ = 0;
+    }
+
+private:
+    char line_[256];
+    size_t size_ = 0;
+};
+
+} // namespace
+
+void PacketSink::OnScript(const uint8_t *data, size_t size) {
+    if (!IsLogging()) {
+        return;
+    }
+    {
+        AMFDecoder decoder(data, size, 0, &arena_);
+        AMFDecoder::Values amfValues(&arena_);
+        AMFStatus status = decoder.Decode(amfValues);
+        LogLineBuffer buffer;
+        std::ostream os(&buffer);
+        for (auto &item : amfValues) {
+            item.Dump(os);
+            os << '\n';
+        }
+        if (!status.Ok()) {
+            os << "Bad script tag: " << status.ToString() << '\n';
+        }
+    }
+    arena_.release();
+}
+
+void PacketSink::OnConfig(TagType stream, uint32_t /* generation */, const uint8_t *data, size_t size) {
+    if (!IsLogging()) {
+        return;
+    }
+    if (stream == TAG_VIDEO) {
+        if (!(data[0] & 0x80)) {
+            Log("video SPS/PPS frame");
+        }
+        return;
+    }
+
+    auto tagHeader = (const AACAudioTagHeader *)data;
+    Log("audio channel: %d, rate: %d, bit: %d, packetType: %d", tagHeader->channels, tagHeader->rate,
+        tagHeader->bits, tagHeader->packetType);
+    AudioSpecificConfig config((char *)tagHeader->data, (int)(size - sizeof(AACAudioTagHeader)));
+    Log("Audio specific config: %d-%d-%d", config.GetObjectType(), config.GetSampleRate(), config.GetChannels());
+}
+
+void PacketSink::Emit(TagType stream, const FrameInfo &frame) {
+    MediaPacketPtr packet = builder_.Finish();
+    if (!packet) {
+        return;
+    }
+    packet->stream = stream;
+    packet->keyFrame = frame.keyFrame;
+    packet->frameClass = frame.frameClass;
+    packet->dts = frame.dts;
+    packet->pts = frame.pts;
+    packet->generation = frame.generation;
+    onPacket_(packet);
+}
+
+bool FlvDemuxer::DemuxFile(const uint8_t *data, size_t size, const TagCallback &onTag) {
+    if (size < sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH || data[0] != 'F' || data[1] != 'L' || data[2] != 'V') {
+        Log("Not a valid .flv file");
+        return false;
+    }
+    auto header = (const FLVHeader *)data;
+    if (header->flagAudio) {
+        Log("has audio");
+    }
+    if (header->flagVideo) {
+        Log("has video");
+    }
+    auto offset = header->offset;
+    size_t dataOffset = (uint32_t)offset[0] << 24 | offset[1] << 16 | offset[2] << 8 | offset[3];
+    if (dataOffset < sizeof(FLVHeader) || dataOffset + PREVIOUS_TAG_SIZE_LENGTH > size) {
+        Log("Not a valid .flv file");
+        return false;
+    }
+
+    // where the tags walked so far end, the data should end there too
+    const uint8_t *end = data + dataOffset + PREVIOUS_TAG_SIZE_LENGTH;
+    for (const TagView &tag : TagRange(data, size)) {
+        if (tag.type != TAG_AUDIO && tag.type != TAG_VIDEO && tag.type != TAG_SCRIPT) {
+            Log("invalid tag type %d at %lu", (int)tag.type, (unsigned long)tag.offset);
+            return false;
+        }
+        Log("Tag length: %zu", tag.payload.size);
+        // the iteration checked it is there, not what it says
+        const uint8_t *p = tag.payload.end();
+        uint32_t previousTagSize = (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+        if (previousTagSize != sizeof(FlvTagHeader) + tag.payload.size) {
+            Log("Bad PreviousTagSize at %lu", (unsigned long)(p - data));
+            return false;
+        }
+
+        Demux(tag.GetHeader());
+        if (onTag) {
+            onTag(tag.GetHeader());
+        }
+        if (tag.type == TAG_SCRIPT && !GetSink().HasCallback()) {
+            return true;
+        }
+        end = p + PREVIOUS_TAG_SIZE_LENGTH;
+    }
+
+    if (end != data + size) {
+        Log("Incomplete .flv file, %lu bytes left", (unsigned long)(data + size - end));
+    }
+    return true;
+}
+
+const char *FlvDemuxer::GetVideoExtension(const uint8_t *data, size_t size) {
+    for (const TagView &tag : TagRange(data, size)) {
+        const char *extension = tag.type == TAG_VIDEO ? VideoTagExtension(tag.payload.data, tag.payload.size) : nullptr;
+        if (extension) {
+            return extension;
+        }
+    }
+    return AVCTraits::EXTENSION;
+}
+
+void FlvDemuxer::LogVideoInfo(const uint8_t *data, size_t size) {
+    auto isAVCSequenceHeader = [](const TagView &tag) {
+        if (tag.type != TAG_VIDEO || tag.payload.size <= sizeof(ExVideoTagHeader)) {
+            return false;
+        }
+        if (tag.payload.data[0] & 0x80) {
+            auto tagHeader = (const ExVideoTagHeader *)tag.payload.data;
+            return tagHeader->GetFourCC() == FOURCC_AVC && tagHeader->packetType == PACKET_SEQUENCE_START;
+        }
+        return ((const VideoTagHeader *)tag.payload.data)->codec == CODEC_AVC &&
+               ((const AVCVideoTagHeader *)tag.payload.data)->packetType == AVC_HEADER;
+    };
+
+    TagRange tags(data, size);
+    auto tag = std::find_if(tags.begin(), tags.end(), isAVCSequenceHeader);
+    if (tag == tags.end()) {
+        return;
+    }
+
+    // both headers are 5 bytes
+    const uint8_t *record = tag->payload.data + sizeof(ExVideoTagHeader);
+    AVCConfiguration config;
+    config.SetConfigurationPacket(record, tag->payload.end() - record);
+    AVCParser parser;
+    for (auto &sps : config.GetSPSList()) {
+        parser.ParseParameterSet((const uint8_t *)sps.data(), sps.size());
+    }
+
+    AVCPPS pps;
+    bool hasPPS = !config.GetPPS().empty() &&
+                  AVCParser::ParsePPS((const uint8_t *)config.GetPPS().data(), config.GetPPS().size(), pps);
+    const AVCSPS *sps = parser.GetSPS(hasPPS ? pps.spsId : 0);
+    if (!sps) {
+        Log("video: H.264, no valid SPS");
+        return;
+    }
+
+    Log("video: H.264 profile %d level %d.%d, %ux%u, refs %u, chroma %d, bit depth %d, %s", sps->profile,
+        sps->level / 10, sps->level % 10, sps->width, sps->height, sps->maxRefFrames, sps->chromaFormat,
+        sps->bitDepthLuma, hasPPS && pps.entropyCodingMode ? "CABAC" : "CAVLC");
+    if (sps->sarWidth && sps->sarHeight) {
+        Log("video: SAR %u:%u", sps->sarWidth, sps->sarHeight);
+    }
+    if (sps->GetFrameRate() > 0) {
+        Log("video: %.3f fps%s", sps->GetFrameRate(), sps->fixedFrameRate ? "" : " (variable)");
+    }
+}
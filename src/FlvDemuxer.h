@@ -0,0 +1,222 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FLV_DEMUXER_H
+#define FLV_MEDIA_FLV_DEMUXER_H
+
+#include "ADTSHeader.h"
+#include "AudioSpecificConfig.h"
+#include "AudioTag.h"
+#include "CodecTraits.h"
+#include "DemuxSink.h"
+#include "FLV.h"
+#include "FrameDropper.h"
+#include "Log.h"
+#include "MediaPacket.h"
+#include "Span.h"
+#include "VideoTag.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+/// Turns FLV tags into frames written to a sink, see DemuxSink.h for what a sink has to offer.
+///
+/// The demuxer keeps the codec configurations across tags, so tags have to be fed in stream order. `Sink` may
+/// be a reference, then the demuxer writes to a sink owned by somebody else.
+template <typename Sink>
+class BasicFlvDemuxer {
+public:
+    /// The arguments construct the sink
+    template <typename... Args>
+    explicit BasicFlvDemuxer(Args &&...args) : sink_(std::forward<Args>(args)...) {}
+
+    /// With a dropper, video frames it refuses are dropped before any output work
+    void SetFrameDropper(FrameDropper *dropper) { dropper_ = dropper; }
+
+    std::remove_reference_t<Sink> &GetSink() { return sink_; }
+
+    /// `tag->data` holds the whole tag body
+    void Demux(const FlvTagHeader *tag) {
+        size_t length = tag->GetDataSize();
+        if (tag->type == TAG_SCRIPT) {
+            sink_.OnScript(tag->data, length);
+        } else if (tag->type == TAG_VIDEO && length > 0) {
+            DemuxVideo(tag, tag->data, length);
+        } else if (tag->type == TAG_AUDIO && length > 0) {
+            DemuxAudio(tag, tag->data, length);
+        }
+    }
+
+private:
+    void DemuxVideo(const FlvTagHeader *tag, const uint8_t *p, size_t length);
+    void DemuxAudio(const FlvTagHeader *tag, const uint8_t *p, size_t length);
+
+private:
+    Sink sink_;
+    FrameDropper *dropper_ = nullptr;
+
+    AVCTraits::Configuration avc_;
+    HEVCTraits::Configuration hevc_;
+    AV1Traits::Configuration av1_;
+    VP9Traits::Configuration vp9_;
+    ADTSHeader adtsHeader_;
+    uint64_t audioConfigHash_ = 0;
+    uint32_t audioGeneration_ = 0;
+};
+
+template <typename Sink>
+void BasicFlvDemuxer<Sink>::DemuxVideo(const FlvTagHeader *tag, const uint8_t *p, size_t length) {
+    bool keyFrame = IsVideoKeyFrame(p, length);
+    uint32_t timestamp = tag->GetTimestamp();
+    auto output = [this](const uint8_t *data, size_t size) { sink_.Append(data, size); };
+    VideoPacketType packetType = PACKET_SEQUENCE_END;
+    DemuxedFrame frame;
+    uint32_t generation = 0;
+    // room for the parameter sets and start codes in front of the NALUs
+    sink_.BeginFrame(length + 256);
+    if (p[0] & 0x80) {
+        if (length < sizeof(ExVideoTagHeader)) {
+            Log("enhanced video tag too short: %zu bytes", length);
+            return;
+        }
+        auto tagHeader = (const ExVideoTagHeader *)p;
+        const uint8_t *payload = tagHeader->data;
+        size_t payloadSize = length - sizeof(ExVideoTagHeader);
+        packetType = tagHeader->packetType;
+        switch (tagHeader->GetFourCC()) {
+            case FOURCC_AVC:
+                frame = DemuxVideoPacket<AVCTraits>(avc_, packetType, keyFrame, timestamp, payload, payloadSize,
+                                                    output, dropper_);
+                generation = avc_.GetGeneration();
+                break;
+            case FOURCC_HEVC:
+                frame = DemuxVideoPacket<HEVCTraits>(hevc_, packetType, keyFrame, timestamp, payload, payloadSize,
+                                                     output, dropper_);
+                generation = hevc_.GetGeneration();
+                break;
+            case FOURCC_AV1:
+                frame = DemuxVideoPacket<AV1Traits>(av1_, packetType, keyFrame, timestamp, payload, payloadSize,
+                                                    output, dropper_);
+                generation = av1_.GetGeneration();
+                break;
+            case FOURCC_VP9:
+                frame = DemuxVideoPacket<VP9Traits>(vp9_, packetType, keyFrame, timestamp, payload, payloadSize,
+                                                    output, dropper_);
+                generation = vp9_.GetGeneration();
+                break;
+            default:
+                Log("unsupported video FourCC %.4s", (const char *)tagHeader->fourCC);
+                return;
+        }
+    } else if (((const VideoTagHeader *)p)->codec == CODEC_AVC && length >= sizeof(AVCVideoTagHeader)) {
+        auto tagHeader = (const AVCVideoTagHeader *)p;
+        packetType = (VideoPacketType)tagHeader->packetType;
+        // the composition time of AVC_NALU is read like the one of PACKET_CODED_FRAMES
+        size_t skip = tagHeader->packetType == AVC_NALU ? 2 : sizeof(AVCVideoTagHeader);
+        frame = DemuxVideoPacket<AVCTraits>(avc_, packetType, keyFrame, timestamp, p + skip, length - skip, output,
+                                            dropper_);
+        generation = avc_.GetGeneration();
+    } else {
+        Log("unsupported video codec: %d", ((const VideoTagHeader *)p)->codec);
+        return;
+    }
+    if (packetType == PACKET_SEQUENCE_START) {
+        sink_.OnConfig(TAG_VIDEO, generation, p, length);
+    }
+    if (frame.emitted) {
+        sink_.OnVideo(FrameInfo{keyFrame, frame.frameClass, timestamp, frame.pts, generation});
+    }
+}
+
+template <typename Sink>
+void BasicFlvDemuxer<Sink>::DemuxAudio(const FlvTagHeader *tag, const uint8_t *p, size_t length) {
+    auto tagHeader = (const AACAudioTagHeader *)p;
+    int dataSize = (int)length - (int)sizeof(AACAudioTagHeader);
+    if (tagHeader->codec != CODEC_AAC || dataSize < 0) {
+        Log("unsupported audio codec: %d", tagHeader->codec);
+    } else if (tagHeader->packetType == AAC_HEADER) {
+        AudioSpecificConfig config((char *)tagHeader->data, dataSize);
+        adtsHeader_.SetChannel(config.GetChannels()).SetSamplingFrequency(config.GetSampleRate()).SetVBR();
+        uint64_t hash = ByteSpan(tagHeader->data, dataSize).Hash();
+        if (audioGeneration_ == 0 || hash != audioConfigHash_) {
+            audioConfigHash_ = hash;
+            audioGeneration_++;
+        }
+        sink_.OnConfig(TAG_AUDIO, audioGeneration_, p, length);
+    } else {
+        adtsHeader_.SetLength(dataSize + sizeof(ADTSHeader));
+        sink_.BeginFrame(sizeof(ADTSHeader) + dataSize);
+        sink_.Append((const uint8_t *)&adtsHeader_, sizeof(ADTSHeader)); // aac header
+        sink_.Append(tagHeader->data, dataSize);                         // aac es data
+        uint32_t timestamp = tag->GetTimestamp();
+        sink_.OnAudio(FrameInfo{true, FRAME_KEY, timestamp, timestamp, audioGeneration_});
+    }
+}
+
+/// Collects frames into pooled MediaPackets and hands them to a callback. While a log callback is set (Log.h),
+/// script tags are decoded and dumped to it and configurations are logged.
+class PacketSink {
+public:
+    /// Whole frames, downstream may keep the packet as long as it likes
+    using PacketCallback = std::function<void(const MediaPacketPtr &packet)>;
+
+    PacketSink(PacketPool &pool, PacketCallback onPacket) : builder_(pool), onPacket_(std::move(onPacket)) {}
+
+    bool HasCallback() const { return (bool)onPacket_; }
+
+    void OnScript(const uint8_t *data, size_t size);
+    void OnConfig(TagType stream, uint32_t generation, const uint8_t *data, size_t size);
+    void BeginFrame(size_t sizeHint) { builder_.Begin(sizeHint); }
+    void Append(const uint8_t *data, size_t size) { builder_.Append(data, size); }
+    void OnVideo(const FrameInfo &frame) { Emit(TAG_VIDEO, frame); }
+    void OnAudio(const FrameInfo &frame) { Emit(TAG_AUDIO, frame); }
+
+private:
+    void Emit(TagType stream, const FrameInfo &frame);
+
+private:
+    PacketBuilder builder_;
+    PacketCallback onPacket_;
+
+    // script data decoded from one tag, dropped at once when the tag is done. Bigger tags spill into the pool,
+    // which keeps the blocks for the next one instead of giving them back to the heap.
+    std::pmr::unsynchronized_pool_resource scriptPool_{{0, 1024 * 1024}};
+    alignas(std::max_align_t) uint8_t arenaBuffer_[16 * 1024];
+    std::pmr::monotonic_buffer_resource arena_{arenaBuffer_, sizeof(arenaBuffer_), &scriptPool_};
+};
+
+/// Turns FLV tags into MediaPackets, one per audio or video frame
+class FlvDemuxer : public BasicFlvDemuxer<PacketSink> {
+public:
+    using PacketCallback = PacketSink::PacketCallback;
+    using TagCallback = std::function<void(const FlvTagHeader *tag)>;
+
+    /// Without a callback only script tags are looked at
+    FlvDemuxer(PacketPool &pool, PacketCallback onPacket, FrameDropper *dropper = nullptr)
+        : BasicFlvDemuxer(pool, std::move(onPacket)) {
+        SetFrameDropper(dropper);
+    }
+
+    void Demux(const FlvTagHeader *tag) {
+        if (tag->type == TAG_SCRIPT || GetSink().HasCallback()) {
+            BasicFlvDemuxer::Demux(tag);
+        }
+    }
+
+    /// Demuxes a whole file in memory, `data` starts with the FLV header; `onTag` sees every tag once it is
+    /// demuxed. Without a packet callback the walk ends after the first script tag. False when the data is not
+    /// FLV or a PreviousTagSize does not match its tag, a file cut short is demuxed up to the cut and logged.
+    bool DemuxFile(const uint8_t *data, size_t size, const TagCallback &onTag = nullptr);
+
+    /// Output file extension for the codec of the first video tag of a file in memory, ".h264" without one
+    static const char *GetVideoExtension(const uint8_t *data, size_t size);
+
+    /// Logs what the parameter sets of the first AVC sequence header of a file in memory tell
+    static void LogVideoInfo(const uint8_t *data, size_t size);
+};
+
+#endif // FLV_MEDIA_FLV_DEMUXER_H
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "flv_media.h"
+#include "File.h"
+#include "FlvDemuxer.h"
+#include "FlvProbe.h"
+#include "Log.h"
+#include "TagRange.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+struct flv_media_file {
+    std::shared_ptr<FileReader> reader; // empty for memory the caller owns
+    const uint8_t *data;
+    size_t size;
+};
+
+static bool IsFlv(const uint8_t *data, size_t size) {
+    return size >= sizeof(FLVHeader) && data[0] == 'F' && data[1] == 'L' && data[2] == 'V';
+}
+
+static void CopyName(char *dst, size_t capacity, const std::string &name) {
+    size_t n = std::min(capacity - 1, name.size());
+    memcpy(dst, name.data(), n);
+    dst[n] = '\0';
+}
+
+const char *flv_media_version(void) {
+    return "1.0.0";
+}
+
+flv_media_file *flv_media_open(const char *path) {
+    try {
+        auto reader = FileReader::Open(path);
+        if (!reader || !IsFlv(reader->data, reader->size)) {
+            return nullptr;
+        }
+        return new flv_media_file{reader, reader->data, reader->size};
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+flv_media_file *flv_media_open_memory(const uint8_t *data, size_t size) {
+    if (!data || !IsFlv(data, size)) {
+        return nullptr;
+    }
+    return new (std::nothrow) flv_media_file{nullptr, data, size};
+}
+
+void flv_media_close(flv_media_file *file) {
+    delete file;
+}
+
+int flv_media_next_tag(const flv_media_file *file, uint64_t *cursor, flv_media_tag *tag) {
+    if (!file || !cursor || !tag || *cursor > file->size) {
+        return 0;
+    }
+
+    const uint8_t *end = file->data + file->size;
+    TagRange tags(file->data, file->size);
+    TagIterator it = *cursor == 0 ? tags.begin() : TagIterator(file->data, file->data + *cursor, end);
+    if (it == tags.end()) {
+        return 0;
+    }
+    tag->type = it->type;
+    tag->timestamp = it->timestamp;
+    tag->offset = it->offset;
+    tag->data = it->payload.data;
+    tag->size = it->payload.size;
+    *cursor = it->payload.end() + 4 - file->data;
+    return 1;
+}
+
+int flv_media_demux(const flv_media_file *file, flv_media_packet_callback callback, void *opaque) {
+    if (!file || !callback) {
+        return -1;
+    }
+
+    try {
+        PacketPool pool;
+        FlvDemuxer demuxer(pool, [callback, opaque](const MediaPacketPtr &packet) {
+            flv_media_packet out;
+            out.type = packet->stream;
+            out.key_frame = packet->keyFrame;
+            out.frame_class = packet->frameClass;
+            out.dts = packet->dts;
+            out.pts = packet->pts;
+            out.generation = packet->generation;
+            out.data = packet->data();
+            out.size = packet->size;
+            callback(opaque, &out);
+        });
+        for (const TagView &tag : TagRange(file->data, file->size)) {
+            demuxer.Demux(tag.GetHeader());
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int flv_media_probe(const char *path, flv_media_probe_info *info) {
+    if (!path || !info) {
+        return -1;
+    }
+
+    try {
+        FlvProbe::Report report = FlvProbe::Probe(path);
+        if (report.tags == 0) {
+            return -1;
+        }
+        memset(info, 0, sizeof(*info));
+        info->file_size = report.fileSize;
+        info->bytes_read = report.bytesRead;
+        info->tags = report.tags;
+        info->duration = report.duration;
+        CopyName(info->video_codec, sizeof(info->video_codec), report.video.codec);
+        info->width = report.video.width;
+        info->height = report.video.height;
+        info->frame_rate = report.video.frameRate;
+        info->video_bitrate = report.video.GetBitrate();
+        info->key_frames = report.keyFrames;
+        CopyName(info->audio_codec, sizeof(info->audio_codec), report.audio.codec);
+        info->sample_rate = report.audio.sampleRate;
+        info->channels = report.audio.channels;
+        info->audio_bitrate = report.audio.GetBitrate();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+char *flv_media_probe_json(const char *path) {
+    if (!path) {
+        return nullptr;
+    }
+
+    try {
+        return strdup(FlvProbe::Probe(path).ToJson().c_str());
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void flv_media_free(void *pointer) {
+    free(pointer);
+}
+
+void flv_media_set_log_callback(flv_media_log_callback callback, void *opaque) {
+    SetLogCallback(callback, opaque);
+}
@@ -0,0 +1,346 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FlvProbe.h"
+#include "AV1Configuration.h"
+#include "AVCConfiguration.h"
+#include "AVCParser.h"
+#include "AudioSpecificConfig.h"
+#include "AudioTag.h"
+#include "ByteSource.h"
+#include "FLV.h"
+#include "HEVCConfiguration.h"
+#include "JsonWriter.h"
+#include "VP9Configuration.h"
+#include "VideoTag.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+/// The tag header and the longest video tag header, enough for codec, frame type and packet type
+static const size_t TAG_PROBE_LENGTH = sizeof(FlvTagHeader) + sizeof(ExVideoTagHeader);
+
+double FlvProbe::StreamInfo::GetBitrate() const {
+    if (tags < 2 || lastTimestamp <= firstTimestamp) {
+        return 0;
+    }
+    double span = lastTimestamp - firstTimestamp;
+    span += span / (tags - 1);
+    return bytes * 8 * 1000.0 / span;
+}
+
+static std::string VideoCodecName(const uint8_t *body) {
+    if (body[0] & 0x80) {
+        switch (((const ExVideoTagHeader *)body)->GetFourCC()) {
+            case FOURCC_AVC:
+                return "H.264";
+            case FOURCC_HEVC:
+                return "HEVC";
+            case FOURCC_AV1:
+                return "AV1";
+            case FOURCC_VP9:
+                return "VP9";
+            default:
+                return std::string((const char *)((const ExVideoTagHeader *)body)->fourCC, 4);
+        }
+    }
+    switch (body[0] & 0x0f) {
+        case CODEC_SORENSON_H263:
+            return "H.263";
+        case CODEC_SCREEN_VIDEO:
+        case CODEC_SCREEN_VIDEO_V2:
+            return "Screen video";
+        case CODEC_VP6:
+        case CODEC_VP6_ALPHA:
+            return "VP6";
+        case CODEC_AVC:
+            return "H.264";
+        default:
+            return "codec " + std::to_string(body[0] & 0x0f);
+    }
+}
+
+static std::string AudioCodecName(uint8_t codec) {
+    switch (codec) {
+        case CODEC_AAC:
+            return "AAC";
+        case CODEC_MP3:
+        case CODEC_MP3_8K:
+            return "MP3";
+        case CODEC_SPEEX:
+            return "Speex";
+        case CODEC_G711_A:
+            return "G.711 A-law";
+        case CODEC_G711_U:
+            return "G.711 mu-law";
+        default:
+            return "codec " + std::to_string(codec);
+    }
+}
+
+/// Fills in what the sequence header `record` tells about the video stream
+static void ParseVideoConfig(const uint8_t *body, const uint8_t *record, size_t size, FlvProbe::StreamInfo &info) {
+    uint32_t fourCC = body[0] & 0x80 ? ((const ExVideoTagHeader *)body)->GetFourCC() : (uint32_t)FOURCC_AVC;
+    if (fourCC == FOURCC_AVC) {
+        AVCConfiguration config;
+        if (!config.SetConfigurationPacket(record, size) || config.GetSPS().empty()) {
+            return;
+        }
+        AVCSPS sps;
+        if (AVCParser::ParseSPS((const uint8_t *)config.GetSPS().data(), config.GetSPS().size(), sps)) {
+            info.profile = sps.profile;
+            info.level = sps.level;
+            info.width = sps.width;
+            info.height = sps.height;
+            info.frameRate = sps.GetFrameRate();
+        }
+    } else if (fourCC == FOURCC_HEVC) {
+        HEVCConfiguration config;
+        if (config.SetConfigurationPacket(record, size)) {
+            info.profile = config.GetProfile();
+            info.level = config.GetLevel();
+        }
+    } else if (fourCC == FOURCC_AV1) {
+        AV1Configuration config;
+        if (config.SetConfigurationPacket(record, size)) {
+            info.profile = config.GetProfile();
+            info.level = config.GetLevel();
+        }
+    } else if (fourCC == FOURCC_VP9) {
+        VP9Configuration config;
+        if (config.SetConfigurationPacket(record, size)) {
+            info.profile = config.GetProfile();
+            info.level = config.GetLevel();
+        }
+    }
+}
+
+FlvProbe::Report FlvProbe::Probe(const std::string &filename) {
+    Report report;
+    report.filename = filename;
+
+    auto source = ByteSource::Open(filename, ByteSource::PREAD);
+    if (!source) {
+        report.error = std::string("can not open: ") + strerror(errno);
+        return report;
+    }
+    report.fileSize = source->GetSize();
+
+    const uint8_t *header = source->Read(0, sizeof(FLVHeader));
+    if (!header || header[0] != 'F' || header[1] != 'L' || header[2] != 'V') {
+        report.error = "not an FLV file";
+        return report;
+    }
+
+    auto offsetField = ((const FLVHeader *)header)->offset;
+    uint64_t offset = (uint32_t)offsetField[0] << 24 | offsetField[1] << 16 | offsetField[2] << 8 | offsetField[3];
+    offset += PREVIOUS_TAG_SIZE_LENGTH;
+
+    bool hasTimestamp = false;
+    uint32_t firstTimestamp = 0;
+    uint32_t lastTimestamp = 0;
+    bool videoConfig = false;
+    bool audioConfig = false;
+    uint32_t gopFrames = 0; // frames since the last key frame, 0 before the first one
+    std::vector<uint8_t> record;
+
+    while (offset + sizeof(FlvTagHeader) <= report.fileSize) {
+        const uint8_t *p = source->Read(offset, (size_t)std::min<uint64_t>(TAG_PROBE_LENGTH, report.fileSize - offset));
+        if (!p) {
+            report.error = "read failed at " + std::to_string(offset);
+            break;
+        }
+        auto tag = (const FlvTagHeader *)p;
+        uint32_t length = tag->GetDataSize();
+        uint32_t timestamp = tag->GetTimestamp();
+        TagType type = tag->type;
+        if (type != TAG_AUDIO && type != TAG_VIDEO && type != TAG_SCRIPT) {
+            report.error = "invalid tag at " + std::to_string(offset);
+            break;
+        }
+        if (offset + sizeof(FlvTagHeader) + length > report.fileSize) {
+            report.error = "truncated tag at " + std::to_string(offset);
+            break;
+        }
+        uint8_t body[sizeof(ExVideoTagHeader)] = {};
+        memcpy(body, tag->data, std::min<size_t>(length, sizeof(body)));
+        uint64_t bodyOffset = offset + sizeof(FlvTagHeader);
+        offset = bodyOffset + length + PREVIOUS_TAG_SIZE_LENGTH;
+
+        report.tags++;
+        if (!hasTimestamp) {
+            hasTimestamp = true;
+            firstTimestamp = timestamp;
+        }
+        lastTimestamp = std::max(lastTimestamp, timestamp);
+        if (type == TAG_SCRIPT) {
+            report.scriptTags++;
+            continue;
+        }
+
+        StreamInfo &info = type == TAG_VIDEO ? report.video : report.audio;
+        StreamInfo &other = type == TAG_VIDEO ? report.audio : report.video;
+        info.tags++;
+        info.bytes += length;
+        if (!info.hasTimestamp) {
+            info.hasTimestamp = true;
+            info.firstTimestamp = timestamp;
+        }
+        info.lastTimestamp = std::max(info.lastTimestamp, timestamp);
+        if (other.hasTimestamp) {
+            uint32_t gap = timestamp > other.lastTimestamp ? timestamp - other.lastTimestamp
+                                                           : other.lastTimestamp - timestamp;
+            report.maxInterleave = std::max(report.maxInterleave, gap);
+        }
+        if (length < 2) {
+            continue;
+        }
+
+        if (type == TAG_VIDEO) {
+            bool exHeader = body[0] & 0x80;
+            uint8_t packetType = exHeader ? body[0] & 0x0f : body[1];
+            bool sequenceHeader = false;
+            bool codedFrame = true;
+            if (exHeader) {
+                sequenceHeader = packetType == PACKET_SEQUENCE_START;
+                codedFrame = packetType == PACKET_CODED_FRAMES || packetType == PACKET_CODED_FRAMES_X;
+            } else if ((body[0] & 0x0f) == CODEC_AVC) {
+                sequenceHeader = packetType == AVC_HEADER;
+                codedFrame = packetType == AVC_NALU;
+            }
+            if (info.codec.empty()) {
+                info.codec = VideoCodecName(body);
+            }
+
+            size_t skip = exHeader ? sizeof(ExVideoTagHeader) : sizeof(AVCVideoTagHeader);
+            if (sequenceHeader && !videoConfig && length > skip) {
+                videoConfig = true;
+                record.resize(length - skip);
+                if (source->ReadAt(bodyOffset + skip, record.data(), record.size())) {
+                    ParseVideoConfig(body, record.data(), record.size(), info);
+                }
+            }
+            if (codedFrame) {
+                if (IsVideoKeyFrame(body, std::min<size_t>(length, sizeof(body)))) {
+                    report.keyFrames++;
+                    if (gopFrames > 0) {
+                        report.gopLengths[gopFrames]++;
+                    }
+                    gopFrames = 1;
+                } else if (gopFrames > 0) {
+                    gopFrames++;
+                }
+            }
+        } else {
+            uint8_t codec = body[0] >> 4;
+            if (info.codec.empty()) {
+                info.codec = AudioCodecName(codec);
+            }
+            if (codec == CODEC_AAC && body[1] == AAC_HEADER && !audioConfig) {
+                audioConfig = true;
+                record.resize(length - sizeof(AACAudioTagHeader));
+                if (source->ReadAt(bodyOffset + sizeof(AACAudioTagHeader), record.data(), record.size())) {
+                    AudioSpecificConfig config((char *)record.data(), (int)record.size());
+                    info.objectType = config.GetObjectType();
+                    info.sampleRate = config.GetSampleRate();
+                    info.channels = config.GetChannels();
+                }
+            } else if (codec != CODEC_AAC && info.sampleRate == 0) {
+                static const int RATES[] = {5500, 11025, 22050, 44100};
+                info.sampleRate = RATES[(body[0] >> 2) & 0x03];
+                info.channels = (body[0] & 0x01) + 1;
+            }
+        }
+    }
+    if (gopFrames > 0) {
+        report.gopLengths[gopFrames]++; // the last one, cut by the end of the file
+    }
+
+    report.duration = lastTimestamp - firstTimestamp;
+    report.bytesRead = source->GetBytesRead();
+    report.reads = source->GetReads();
+    return report;
+}
+
+static void WriteStream(JsonWriter &json, const FlvProbe::StreamInfo &info, bool video) {
+    json.BeginObject();
+    json.Key("codec").Value(info.codec);
+    if (video) {
+        if (info.profile || info.level) {
+            json.Key("profile").Value(info.profile).Key("level").Value(info.level);
+        }
+        if (info.width && info.height) {
+            json.Key("width").Value(info.width).Key("height").Value(info.height);
+        }
+        if (info.frameRate > 0) {
+            json.Key("frameRate").Value(info.frameRate);
+        }
+    } else {
+        if (info.objectType) {
+            json.Key("objectType").Value(info.objectType);
+        }
+        if (info.sampleRate) {
+            json.Key("sampleRate").Value(info.sampleRate).Key("channels").Value(info.channels);
+        }
+    }
+    json.Key("tags").Value(info.tags);
+    json.Key("bytes").Value(info.bytes);
+    json.Key("start").Value(info.firstTimestamp);
+    json.Key("end").Value(info.lastTimestamp);
+    json.Key("bitrate").Value(info.GetBitrate());
+}
+
+std::string FlvProbe::Report::ToJson() const {
+    JsonWriter json;
+    json.BeginObject();
+    json.Key("file").Value(filename);
+    if (!error.empty()) {
+        json.Key("error").Value(error);
+    }
+    json.Key("size").Value(fileSize);
+    json.Key("read").Value(bytesRead);
+    json.Key("reads").Value(reads);
+    json.Key("readRatio").Value(fileSize ? (double)bytesRead / fileSize : 0.0);
+    json.Key("tags").Value(tags);
+    json.Key("scriptTags").Value(scriptTags);
+    json.Key("duration").Value(duration);
+
+    if (video.tags) {
+        json.Key("video");
+        WriteStream(json, video, true);
+        json.Key("keyFrames").Value(keyFrames);
+        uint64_t gops = 0;
+        uint64_t frames = 0;
+        json.Key("gop").BeginObject().Key("lengths").BeginObject();
+        for (auto &item : gopLengths) {
+            json.Key(std::to_string(item.first)).Value(item.second);
+            gops += item.second;
+            frames += (uint64_t)item.first * item.second;
+        }
+        json.EndObject();
+        if (gops) {
+            json.Key("min").Value(gopLengths.begin()->first);
+            json.Key("max").Value(gopLengths.rbegin()->first);
+            json.Key("mean").Value((double)frames / gops);
+        }
+        json.EndObject();
+        json.EndObject();
+    }
+    if (audio.tags) {
+        json.Key("audio");
+        WriteStream(json, audio, false);
+        json.EndObject();
+    }
+    if (video.tags && audio.tags) {
+        json.Key("avOffset").BeginObject();
+        json.Key("start").Value((int64_t)video.firstTimestamp - (int64_t)audio.firstTimestamp);
+        json.Key("end").Value((int64_t)video.lastTimestamp - (int64_t)audio.lastTimestamp);
+        json.Key("maxInterleave").Value(maxInterleave);
+        json.EndObject();
+    }
+    json.EndObject();
+    return json.GetString();
+}
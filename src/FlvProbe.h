@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FLV_PROBE_H
+#define FLV_MEDIA_FLV_PROBE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+/// Stream statistics of an FLV file from its tag headers.
+///
+/// Jumps from tag to tag reading the 11 bytes header and the first 5 bytes of the body through a PREAD
+/// ByteSource; only the first sequence header of each stream is read whole, for the codec configuration.
+/// Nothing is mapped. Where tags are small their headers share a few big reads, where they are big little more
+/// than the headers is read. Pipes and stdin ("-") are read into memory first.
+class FlvProbe {
+public:
+    struct StreamInfo {
+        std::string codec;
+        uint64_t tags = 0;
+        uint64_t bytes = 0; // tag bodies
+        bool hasTimestamp = false;
+        uint32_t firstTimestamp = 0;
+        uint32_t lastTimestamp = 0;
+
+        // from the sequence header, 0 when unknown
+        int profile = 0;
+        int level = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        double frameRate = 0;
+        int objectType = 0;
+        int sampleRate = 0;
+        int channels = 0;
+
+        /// Bits per second over the stream's own time span, one average tag interval included
+        double GetBitrate() const;
+    };
+
+    struct Report {
+        std::string filename;
+        std::string error; // why the walk stopped early, empty when it reached the end
+        uint64_t fileSize = 0;
+        uint64_t bytesRead = 0;
+        uint64_t reads = 0; // read calls
+        uint64_t tags = 0;
+        uint64_t scriptTags = 0;
+        uint32_t duration = 0; // milliseconds
+        StreamInfo video;
+        StreamInfo audio;
+        uint64_t keyFrames = 0;
+        std::map<uint32_t, uint64_t> gopLengths; // frames per GOP -> GOPs
+        uint32_t maxInterleave = 0;              // largest gap between a tag and the other stream, milliseconds
+
+        /// One line of JSON
+        std::string ToJson() const;
+    };
+
+    static Report Probe(const std::string &filename);
+};
+
+#endif // FLV_MEDIA_FLV_PROBE_H
@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FlvSalvager.h"
+#include "FLV.h"
+#include "JsonWriter.h"
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+static const size_t FILE_HEADER_LENGTH = sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH;
+
+bool FlvSalvager::IsTagAt(const uint8_t *data, size_t size, size_t pos) {
+    if (pos + sizeof(FlvTagHeader) + PREVIOUS_TAG_SIZE_LENGTH > size) {
+        return false;
+    }
+    const uint8_t *p = data + pos;
+    // the whole first byte, so the filter and reserved bits have to be 0 as well
+    if ((p[0] != TAG_AUDIO && p[0] != TAG_VIDEO && p[0] != TAG_SCRIPT) || p[8] || p[9] || p[10]) {
+        return false;
+    }
+
+    size_t length = ((const FlvTagHeader *)p)->GetDataSize();
+    if (size - pos - sizeof(FlvTagHeader) - PREVIOUS_TAG_SIZE_LENGTH < length) {
+        return false;
+    }
+    const uint8_t *q = p + sizeof(FlvTagHeader) + length;
+    uint32_t previousTagSize = (uint32_t)q[0] << 24 | q[1] << 16 | q[2] << 8 | q[3];
+    return previousTagSize == sizeof(FlvTagHeader) + length;
+}
+
+size_t FlvSalvager::FindTag(const uint8_t *data, size_t size, size_t from) {
+    size_t pos = from;
+#ifdef __SSE2__
+    // 16 positions at a time: a tag type byte with a zero stream id 8 to 10 bytes further on. Only the few
+    // positions passing both go through the full check.
+    const __m128i audio = _mm_set1_epi8(TAG_AUDIO);
+    const __m128i video = _mm_set1_epi8(TAG_VIDEO);
+    const __m128i script = _mm_set1_epi8(TAG_SCRIPT);
+    const __m128i zero = _mm_setzero_si128();
+    while (size >= 26 && pos <= size - 26) {
+        const uint8_t *p = data + pos;
+        __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+        __m128i type = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, audio), _mm_cmpeq_epi8(bytes, video)),
+                                    _mm_cmpeq_epi8(bytes, script));
+        uint32_t mask = _mm_movemask_epi8(type);
+        if (mask) {
+            mask &= _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 8)), zero));
+            mask &= _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 9)), zero));
+            mask &= _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 10)), zero));
+            while (mask) {
+                size_t candidate = pos + __builtin_ctz(mask);
+                if (IsTagAt(data, size, candidate)) {
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+        }
+        pos += 16;
+    }
+#endif
+    for (; pos < size; ++pos) {
+        if (IsTagAt(data, size, pos)) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+bool FlvSalvager::Salvage(const uint8_t *data, size_t size, FileWriter &writer, Report &report) {
+    report = Report();
+
+    bool hasVideo = false;
+    bool hasAudio = false;
+    size_t pos = 0;
+    if (size >= FILE_HEADER_LENGTH && data[0] == 'F' && data[1] == 'L' && data[2] == 'V') {
+        const uint8_t *offset = ((const FLVHeader *)data)->offset;
+        bool plain = !offset[0] && !offset[1] && !offset[2] && offset[3] == sizeof(FLVHeader);
+        pos = plain ? FILE_HEADER_LENGTH : 0;
+    }
+    report.headerRebuilt = pos == 0;
+    FLVHeader header(false, false);
+    uint8_t previousTagSize[PREVIOUS_TAG_SIZE_LENGTH] = {};
+    if (!writer.Write((const uint8_t *)&header, sizeof(header)) ||
+        !writer.Write(previousTagSize, sizeof(previousTagSize))) {
+        return false;
+    }
+
+    size_t run = pos; // start of the good tags not written yet
+    while (pos < size) {
+        if (IsTagAt(data, size, pos)) {
+            size_t length = ((const FlvTagHeader *)(data + pos))->GetDataSize();
+            hasVideo |= data[pos] == TAG_VIDEO;
+            hasAudio |= data[pos] == TAG_AUDIO;
+            report.tags++;
+            pos += sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH;
+            continue;
+        }
+
+        if (pos > run && !writer.Write(data + run, pos - run)) {
+            return false;
+        }
+        report.keptBytes += pos - run;
+        size_t next = FindTag(data, size, pos + 1);
+        report.skipped.push_back({pos, next});
+        report.skippedBytes += next - pos;
+        pos = next;
+        run = pos;
+    }
+    if (pos > run && !writer.Write(data + run, pos - run)) {
+        return false;
+    }
+    report.keptBytes += pos - run;
+
+    // the flags of what actually survived
+    header = FLVHeader(hasVideo, hasAudio);
+    return writer.WriteAt(0, (const uint8_t *)&header, sizeof(header));
+}
+
+std::string FlvSalvager::Report::ToJson() const {
+    JsonWriter json;
+    json.BeginObject();
+    json.Key("tags").Value(tags);
+    json.Key("kept").Value(keptBytes);
+    json.Key("skippedBytes").Value(skippedBytes);
+    json.Key("headerRebuilt").Value(headerRebuilt);
+    json.Key("skipped").BeginArray();
+    for (auto &range : skipped) {
+        json.BeginArray().Value(range.begin).Value(range.end).EndArray();
+    }
+    json.EndArray();
+    json.EndObject();
+    return json.GetString();
+}
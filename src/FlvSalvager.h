@@ -0,0 +1,46 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FLV_SALVAGER_H
+#define FLV_MEDIA_FLV_SALVAGER_H
+
+#include "File.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Copies the intact tags of a damaged FLV file into a new one.
+///
+/// Where a tag does not check out, the input is scanned forward for the next plausible tag boundary: a known
+/// tag type, a zero stream id, a size that fits the file and a PreviousTagSize that matches it. Everything in
+/// between is skipped and reported. Tags are copied verbatim, runs of good tags in one write.
+class FlvSalvager {
+public:
+    struct Range {
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct Report {
+        uint64_t tags = 0;
+        uint64_t keptBytes = 0;
+        uint64_t skippedBytes = 0;
+        bool headerRebuilt = false;
+        std::vector<Range> skipped;
+
+        /// One line of JSON
+        std::string ToJson() const;
+    };
+
+    /// False only when writing fails, damaged input is what this is for
+    static bool Salvage(const uint8_t *data, size_t size, FileWriter &writer, Report &report);
+
+    /// Whether a complete tag with a matching PreviousTagSize starts at `pos`
+    static bool IsTagAt(const uint8_t *data, size_t size, size_t pos);
+    /// The first `pos >= from` with IsTagAt(), `size` when there is none
+    static size_t FindTag(const uint8_t *data, size_t size, size_t from);
+};
+
+#endif // FLV_MEDIA_FLV_SALVAGER_H
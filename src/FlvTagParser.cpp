@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FlvTagParser.h"
+#include "Log.h"
+#include <algorithm>
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+static const size_t FILE_HEADER_LENGTH = sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH;
+
+bool FlvTagParser::Push(const uint8_t *data, size_t size) {
+    if (error_) {
+        return false;
+    }
+
+    // complete the pending tag first, copying no more than it needs
+    while (!pending_.empty() && size > 0) {
+        size_t need = FILE_HEADER_LENGTH;
+        if (hasHeader_) {
+            need = sizeof(FlvTagHeader);
+            if (pending_.size() >= sizeof(FlvTagHeader)) {
+                need += ((FlvTagHeader *)pending_.data())->GetDataSize() + PREVIOUS_TAG_SIZE_LENGTH;
+            }
+        }
+
+        size_t n = std::min(need - pending_.size(), size);
+        pending_.insert(pending_.end(), data, data + n);
+        data += n;
+        size -= n;
+
+        if (pending_.size() == need && need != sizeof(FlvTagHeader)) {
+            Parse(pending_.data(), pending_.size());
+            pending_.clear();
+        }
+        if (error_) {
+            return false;
+        }
+    }
+
+    if (pending_.empty()) {
+        size_t consumed = Parse(data, size);
+        pending_.assign(data + consumed, data + size);
+    }
+    return !error_;
+}
+
+size_t FlvTagParser::Parse(const uint8_t *data, size_t size) {
+    size_t pos = 0;
+    if (!hasHeader_) {
+        if (size < FILE_HEADER_LENGTH) {
+            return 0;
+        }
+        if (data[0] != 'F' || data[1] != 'L' || data[2] != 'V') {
+            Log("Not a valid .flv stream");
+            error_ = true;
+            return 0;
+        }
+
+        hasHeader_ = true;
+        if (headerCallback_) {
+            headerCallback_((const FLVHeader *)data);
+        }
+        pos = FILE_HEADER_LENGTH;
+        offset_ += FILE_HEADER_LENGTH;
+    }
+
+    while (pos + sizeof(FlvTagHeader) <= size) {
+        auto tag = (const FlvTagHeader *)(data + pos);
+        size_t length = tag->GetDataSize();
+        if (pos + sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH > size) {
+            break;
+        }
+
+        const uint8_t *p = tag->data + length;
+        uint32_t previousTagSize = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+        if (previousTagSize != sizeof(FlvTagHeader) + length) {
+            Log("Bad PreviousTagSize at %lu", (unsigned long)offset_);
+            error_ = true;
+            break;
+        }
+
+        if (tagCallback_) {
+            tagCallback_(tag);
+        }
+        pos += sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH;
+        offset_ += sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH;
+    }
+    return pos;
+}
@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FLV_TAG_PARSER_H
+#define FLV_MEDIA_FLV_TAG_PARSER_H
+
+#include "FLV.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// Incremental FLV parser for data that arrives in pieces, e.g. from a pipe.
+///
+/// Complete tags are handed out directly from the pushed data, only a partial tag at the end of a
+/// chunk is copied until the rest of it arrives.
+class FlvTagParser {
+public:
+    using HeaderCallback = std::function<void(const FLVHeader *header)>;
+    /// `tag->data` holds the whole tag body
+    using TagCallback = std::function<void(const FlvTagHeader *tag)>;
+
+    FlvTagParser(HeaderCallback headerCallback, TagCallback tagCallback)
+        : headerCallback_(std::move(headerCallback)), tagCallback_(std::move(tagCallback)) {}
+
+    /// Returns false once the stream is malformed
+    bool Push(const uint8_t *data, size_t size);
+
+    /// Stream offset right after the last complete tag
+    uint64_t GetOffset() const { return offset_; }
+    /// Bytes waiting for the rest of a tag
+    size_t GetPending() const { return pending_.size(); }
+
+private:
+    size_t Parse(const uint8_t *data, size_t size);
+
+private:
+    HeaderCallback headerCallback_;
+    TagCallback tagCallback_;
+    std::vector<uint8_t> pending_;
+    uint64_t offset_ = 0;
+    bool hasHeader_ = false;
+    bool error_ = false;
+};
+
+#endif // FLV_MEDIA_FLV_TAG_PARSER_H
@@ -0,0 +1,301 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FlvValidator.h"
+#include "AudioTag.h"
+#include "ByteSource.h"
+#include "FLV.h"
+#include "JsonWriter.h"
+#include "VideoTag.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+/// The tag header and the first two body bytes, enough for the sequence header flags
+static const size_t TAG_PROBE_LENGTH = sizeof(FlvTagHeader) + 2;
+
+static void AddIssue(std::vector<FlvValidator::Issue> &issues, uint64_t &count, uint64_t offset, const char *format,
+                     ...) __attribute__((format(printf, 4, 5)));
+
+static void AddIssue(std::vector<FlvValidator::Issue> &issues, uint64_t &count, uint64_t offset, const char *format,
+                     ...) {
+    if (count++ >= FlvValidator::MAX_ISSUES) {
+        return;
+    }
+    char message[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    issues.push_back({offset, message});
+}
+
+#define VALIDATION_ERROR(offset, ...) AddIssue(report.errors, report.errorCount, offset, __VA_ARGS__)
+#define VALIDATION_WARNING(offset, ...) AddIssue(report.warnings, report.warningCount, offset, __VA_ARGS__)
+
+static uint32_t ReadUint32(const uint8_t *p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+
+/// Checks the tags starting at `offset`, stops at the first tag the chain can not get past.
+///
+/// One read per tag fetches its PreviousTagSize and the header of the next tag together. The first two body
+/// bytes are fetched too, only while a stream has not settled whether it starts with a sequence header.
+static void WalkTags(ByteSource &source, uint64_t offset, bool flagVideo, bool flagAudio,
+                     FlvValidator::Report &report) {
+    bool hasTimestamp[2] = {};
+    uint32_t lastTimestamp[2] = {};
+    bool earlyVideo = false;
+    bool earlyAudio = false;
+    // the sequence header is found, or the codec of the stream has none
+    bool settled[2] = {};
+
+    auto probeLength = [&](uint64_t at) {
+        bool body = (flagVideo && !settled[0]) || (flagAudio && !settled[1]);
+        return (size_t)std::min<uint64_t>(body ? TAG_PROBE_LENGTH : sizeof(FlvTagHeader), report.fileSize - at);
+    };
+    size_t got = offset < report.fileSize ? probeLength(offset) : 0;
+    const uint8_t *p = got ? source.Read(offset, got) : nullptr;
+
+    while (offset < report.fileSize) {
+        report.checkedSize = offset;
+        if (report.fileSize - offset < sizeof(FlvTagHeader)) {
+            VALIDATION_ERROR(offset, "truncated tag header, %lu bytes left", (unsigned long)(report.fileSize - offset));
+            return;
+        }
+        if (!p) {
+            VALIDATION_ERROR(offset, "read failed");
+            return;
+        }
+
+        auto tag = (const FlvTagHeader *)p;
+        uint32_t length = tag->GetDataSize();
+        if (tag->type != TAG_AUDIO && tag->type != TAG_VIDEO && tag->type != TAG_SCRIPT) {
+            VALIDATION_ERROR(offset, "invalid tag type %d", (int)tag->type);
+            return;
+        }
+        uint64_t end = offset + sizeof(FlvTagHeader) + length;
+        if (end + PREVIOUS_TAG_SIZE_LENGTH > report.fileSize) {
+            VALIDATION_ERROR(offset, "truncated tag, %u bytes of data but %lu left", length,
+                             (unsigned long)(report.fileSize - offset - sizeof(FlvTagHeader)));
+            return;
+        }
+        if (tag->streamId[0] || tag->streamId[1] || tag->streamId[2]) {
+            VALIDATION_WARNING(offset, "stream id is not 0");
+        }
+        if (tag->filter) {
+            VALIDATION_WARNING(offset, "encrypted tag");
+        }
+
+        // header fields are used after the next read moves the window on
+        uint32_t timestamp = tag->GetTimestamp();
+        TagType type = tag->type;
+        int stream = type == TAG_VIDEO ? 0 : 1;
+        uint8_t body[2] = {};
+        if (length >= 2 && type != TAG_SCRIPT && !settled[stream]) {
+            if (got < TAG_PROBE_LENGTH) {
+                p = source.Read(offset + sizeof(FlvTagHeader), 2);
+                if (!p) {
+                    VALIDATION_ERROR(offset, "read failed");
+                    return;
+                }
+                memcpy(body, p, 2);
+            } else {
+                memcpy(body, tag->data, 2);
+            }
+        }
+
+        uint64_t next = end + PREVIOUS_TAG_SIZE_LENGTH;
+        got = next < report.fileSize ? probeLength(next) : 0;
+        const uint8_t *previous = source.Read(end, PREVIOUS_TAG_SIZE_LENGTH + got);
+        if (!previous) {
+            VALIDATION_ERROR(end, "read failed");
+            return;
+        }
+        uint32_t previousTagSize = ReadUint32(previous);
+        if (previousTagSize != sizeof(FlvTagHeader) + length) {
+            VALIDATION_ERROR(end, "PreviousTagSize %u, expected %u", previousTagSize,
+                             (uint32_t)(sizeof(FlvTagHeader) + length));
+            return;
+        }
+        p = previous + PREVIOUS_TAG_SIZE_LENGTH;
+
+        if (report.tags == 0) {
+            report.firstTimestamp = timestamp;
+        }
+        report.lastTimestamp = std::max(report.lastTimestamp, timestamp);
+        report.tags++;
+
+        if (type == TAG_SCRIPT) {
+            report.scriptTags++;
+        } else {
+            if (hasTimestamp[stream] && timestamp < lastTimestamp[stream]) {
+                VALIDATION_ERROR(offset, "%s timestamp goes back from %u to %u", stream == 0 ? "video" : "audio",
+                                 lastTimestamp[stream], timestamp);
+            }
+            hasTimestamp[stream] = true;
+            lastTimestamp[stream] = timestamp;
+        }
+
+        if (type == TAG_VIDEO) {
+            report.videoTags++;
+            if (length < 2) {
+                VALIDATION_WARNING(offset, "empty video tag");
+            } else if (!settled[0] && (body[0] & 0x80)) {
+                uint8_t packetType = body[0] & 0x0f;
+                if (packetType == PACKET_SEQUENCE_START) {
+                    report.videoSequenceHeader = true;
+                } else if ((packetType == PACKET_CODED_FRAMES || packetType == PACKET_CODED_FRAMES_X) &&
+                           !report.videoSequenceHeader && !earlyVideo) {
+                    earlyVideo = true;
+                    VALIDATION_ERROR(offset, "video frame before the sequence header");
+                }
+            } else if (!settled[0] && (body[0] & 0x0f) == CODEC_AVC) {
+                if (body[1] == AVC_HEADER) {
+                    report.videoSequenceHeader = true;
+                } else if (body[1] == AVC_NALU && !report.videoSequenceHeader && !earlyVideo) {
+                    earlyVideo = true;
+                    VALIDATION_ERROR(offset, "video frame before the sequence header");
+                }
+            } else {
+                settled[0] = true; // a legacy codec, it has no sequence header
+            }
+            settled[0] = settled[0] || report.videoSequenceHeader;
+        } else if (type == TAG_AUDIO) {
+            report.audioTags++;
+            if (length < 2) {
+                VALIDATION_WARNING(offset, "empty audio tag");
+            } else if (!settled[1] && (body[0] >> 4) == CODEC_AAC) {
+                if (body[1] == AAC_HEADER) {
+                    report.audioSequenceHeader = true;
+                } else if (!report.audioSequenceHeader && !earlyAudio) {
+                    earlyAudio = true;
+                    VALIDATION_ERROR(offset, "audio frame before the sequence header");
+                }
+            } else {
+                settled[1] = true;
+            }
+            settled[1] = settled[1] || report.audioSequenceHeader;
+        }
+
+        offset = next;
+    }
+    report.checkedSize = offset;
+
+    if (flagVideo != (report.videoTags > 0)) {
+        VALIDATION_WARNING(0, flagVideo ? "video flag set but no video tags" : "video tags but no video flag");
+    }
+    if (flagAudio != (report.audioTags > 0)) {
+        VALIDATION_WARNING(0, flagAudio ? "audio flag set but no audio tags" : "audio tags but no audio flag");
+    }
+}
+
+FlvValidator::Report FlvValidator::Validate(const std::string &filename) {
+    Report report;
+    report.filename = filename;
+
+    auto source = ByteSource::Open(filename, ByteSource::PREAD);
+    if (!source) {
+        VALIDATION_ERROR(0, "can not open: %s", strerror(errno));
+        return report;
+    }
+    report.fileSize = source->GetSize();
+
+    const uint8_t *p = source->Read(0, sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH);
+    if (!p) {
+        VALIDATION_ERROR(0, "too short for an FLV header, %lu bytes", (unsigned long)report.fileSize);
+    } else if (p[0] != 'F' || p[1] != 'L' || p[2] != 'V') {
+        VALIDATION_ERROR(0, "bad signature");
+    } else {
+        auto header = (const FLVHeader *)p;
+        bool flagVideo = header->flagVideo;
+        bool flagAudio = header->flagAudio;
+        uint32_t dataOffset = ReadUint32(header->offset);
+        if (header->version != 1) {
+            VALIDATION_WARNING(3, "version %d", header->version);
+        }
+        if (dataOffset < sizeof(FLVHeader)) {
+            VALIDATION_ERROR(5, "header size %u", dataOffset);
+        } else {
+            const uint8_t *previous = source->Read(dataOffset, PREVIOUS_TAG_SIZE_LENGTH);
+            if (!previous) {
+                VALIDATION_ERROR(dataOffset, "missing PreviousTagSize #0");
+            } else {
+                if (ReadUint32(previous) != 0) {
+                    VALIDATION_WARNING(dataOffset, "PreviousTagSize #0 is %u", ReadUint32(previous));
+                }
+                WalkTags(*source, dataOffset + PREVIOUS_TAG_SIZE_LENGTH, flagVideo, flagAudio, report);
+            }
+        }
+    }
+
+    report.bytesRead = source->GetBytesRead();
+    report.reads = source->GetReads();
+    report.valid = report.errorCount == 0;
+    return report;
+}
+
+void FlvValidator::Validate(const std::vector<std::string> &filenames, unsigned threads,
+                            const std::function<void(const Report &report)> &onReport) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = (unsigned)std::min<size_t>(threads, filenames.size());
+
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) < filenames.size()) {
+            Report report = Validate(filenames[i]);
+            std::lock_guard<std::mutex> lock(mutex);
+            onReport(report);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+static void WriteIssues(JsonWriter &json, const char *key, const std::vector<FlvValidator::Issue> &issues) {
+    json.Key(key).BeginArray();
+    for (auto &issue : issues) {
+        json.BeginObject().Key("offset").Value(issue.offset).Key("message").Value(issue.message).EndObject();
+    }
+    json.EndArray();
+}
+
+std::string FlvValidator::Report::ToJson() const {
+    JsonWriter json;
+    json.BeginObject();
+    json.Key("file").Value(filename);
+    json.Key("valid").Value(valid);
+    json.Key("size").Value(fileSize);
+    json.Key("checked").Value(checkedSize);
+    json.Key("read").Value(bytesRead);
+    json.Key("reads").Value(reads);
+    json.Key("tags").Value(tags);
+    json.Key("video").Value(videoTags);
+    json.Key("audio").Value(audioTags);
+    json.Key("script").Value(scriptTags);
+    json.Key("duration").Value(tags ? lastTimestamp - firstTimestamp : 0);
+    json.Key("videoSequenceHeader").Value(videoSequenceHeader);
+    json.Key("audioSequenceHeader").Value(audioSequenceHeader);
+    json.Key("errorCount").Value(errorCount);
+    WriteIssues(json, "errors", errors);
+    json.Key("warningCount").Value(warningCount);
+    WriteIssues(json, "warnings", warnings);
+    json.EndObject();
+    return json.GetString();
+}
@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FLV_VALIDATOR_H
+#define FLV_MEDIA_FLV_VALIDATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// Structural check of FLV files that reads nothing but the tag headers.
+///
+/// Checked are the file header, every tag header, the PreviousTagSize chain, per-stream timestamp order and
+/// that AVC/enhanced video and AAC audio start with a sequence header. Headers are fetched through a PREAD
+/// ByteSource, so big tags are jumped over instead of read and small ones share a few big reads. Malformed
+/// input never ends the process: a broken chain stops the walk for that file and is reported like any other
+/// error.
+class FlvValidator {
+public:
+    /// Only the first MAX_ISSUES errors and warnings are kept, all of them are counted
+    static const size_t MAX_ISSUES = 16;
+
+    struct Issue {
+        uint64_t offset;
+        std::string message;
+    };
+
+    struct Report {
+        std::string filename;
+        bool valid = false;
+        uint64_t fileSize = 0;
+        uint64_t checkedSize = 0; // up to the end of the last tag that was walked
+        uint64_t bytesRead = 0;
+        uint64_t reads = 0; // read calls
+        uint64_t tags = 0;
+        uint64_t videoTags = 0;
+        uint64_t audioTags = 0;
+        uint64_t scriptTags = 0;
+        uint32_t firstTimestamp = 0;
+        uint32_t lastTimestamp = 0;
+        bool videoSequenceHeader = false;
+        bool audioSequenceHeader = false;
+        uint64_t errorCount = 0;
+        uint64_t warningCount = 0;
+        std::vector<Issue> errors;
+        std::vector<Issue> warnings;
+
+        /// One line of JSON
+        std::string ToJson() const;
+    };
+
+    static Report Validate(const std::string &filename);
+
+    /// Validates the files on up to `threads` threads, 0 for one per cpu. Reports arrive in completion order,
+    /// never two at a time.
+    static void Validate(const std::vector<std::string> &filenames, unsigned threads,
+                         const std::function<void(const Report &report)> &onReport);
+};
+
+#endif // FLV_MEDIA_FLV_VALIDATOR_H
@@ -0,0 +1,222 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "FlvWriter.h"
+#include "VideoTag.h"
+#include <cstdio>
+#include <unistd.h>
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+// FLV header + PreviousTagSize #0 + script tag header
+static const size_t METADATA_OFFSET = sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH + sizeof(FlvTagHeader);
+
+static bool WriteTagHeader(FileWriter &file, TagType type, uint32_t timestamp, size_t size) {
+    FlvTagHeader tag{};
+    tag.type = type;
+    tag.SetDataSize(size);
+    tag.SetTimestamp(timestamp);
+    return file.Write((const uint8_t *)&tag, sizeof(tag));
+}
+
+static bool WritePreviousTagSize(FileWriter &file, size_t dataSize) {
+    uint32_t tagSize = sizeof(FlvTagHeader) + dataSize;
+    uint8_t buffer[4] = {uint8_t(tagSize >> 24), uint8_t(tagSize >> 16), uint8_t(tagSize >> 8), uint8_t(tagSize)};
+    return file.Write(buffer, sizeof(buffer));
+}
+
+std::shared_ptr<FlvWriter> FlvWriter::Open(const std::string &filename, bool hasVideo, bool hasAudio,
+                                           const AMFValue &metadata, size_t reserve) {
+    auto file = FileWriter::Open(filename);
+    if (!file) {
+        return nullptr;
+    }
+
+    return Open(file, filename, hasVideo, hasAudio, metadata, reserve);
+}
+
+std::shared_ptr<FlvWriter> FlvWriter::Open(std::shared_ptr<FileWriter> file, const std::string &filename,
+                                           bool hasVideo, bool hasAudio, const AMFValue &metadata, size_t reserve) {
+    if (reserve > 0xffffff || (metadata.Type() != AMF_ECMA_ARRAY && metadata.Type() != AMF_OBJECT)) {
+        printf("Invalid metadata reserve %zu\n", reserve);
+        return nullptr;
+    }
+
+    auto writer = std::shared_ptr<FlvWriter>(new FlvWriter(nullptr, filename, metadata, reserve));
+    std::string script = writer->Pad(writer->BuildMetadata(false));
+    if (script.empty()) {
+        printf("onMetaData does not fit in %zu bytes\n", reserve);
+        return nullptr;
+    }
+
+    FLVHeader header(hasVideo, hasAudio);
+    uint8_t previousTagSize0[4] = {};
+    if (!file->Write((const uint8_t *)&header, sizeof(header)) || !file->Write(previousTagSize0, 4) ||
+        !WriteTagHeader(*file, TAG_SCRIPT, 0, reserve) || !file->Write(script) ||
+        !WritePreviousTagSize(*file, reserve)) {
+        return nullptr;
+    }
+
+    writer->file_ = file;
+    writer->state_.offset = METADATA_OFFSET + reserve + PREVIOUS_TAG_SIZE_LENGTH;
+    return writer;
+}
+
+std::shared_ptr<FlvWriter> FlvWriter::Resume(std::shared_ptr<FileWriter> file, const std::string &filename,
+                                             const AMFValue &metadata, size_t reserve, const State &state) {
+    if (!file || state.offset < METADATA_OFFSET + reserve + PREVIOUS_TAG_SIZE_LENGTH ||
+        (metadata.Type() != AMF_ECMA_ARRAY && metadata.Type() != AMF_OBJECT)) {
+        return nullptr;
+    }
+
+    auto writer = std::shared_ptr<FlvWriter>(new FlvWriter(file, filename, metadata, reserve));
+    writer->state_ = state;
+    return writer;
+}
+
+bool FlvWriter::WriteTag(TagType type, uint32_t timestamp, const uint8_t *data, size_t size) {
+    if (!file_ || size > 0xffffff) {
+        return false;
+    }
+
+    if (type == TAG_VIDEO && IsVideoKeyFrame(data, size)) {
+        state_.keyframes.push_back({timestamp / 1000.0, state_.offset});
+    }
+
+    if (!WriteTagHeader(*file_, type, timestamp, size) || !file_->Write(data, size) ||
+        !WritePreviousTagSize(*file_, size)) {
+        return false;
+    }
+
+    state_.offset += sizeof(FlvTagHeader) + size + PREVIOUS_TAG_SIZE_LENGTH;
+    if (type != TAG_SCRIPT) {
+        state_.mediaBytes += size;
+    }
+    if (timestamp > state_.lastTimestamp) {
+        state_.lastTimestamp = timestamp;
+    }
+    return true;
+}
+
+bool FlvWriter::Close(bool sync) {
+    if (!file_) {
+        return false;
+    }
+
+    std::string script = Pad(BuildMetadata(true));
+    bool overflow = script.empty();
+    if (overflow) {
+        // keep duration/datarate in place, the keyframe table is added by a rewrite
+        printf("%zu keyframes overflow the %zu bytes reserve, rewrite file\n", state_.keyframes.size(), reserve_);
+        script = Pad(BuildMetadata(false));
+    }
+
+    bool ok = !script.empty() && file_->WriteAt(METADATA_OFFSET, (const uint8_t *)script.data(), script.size());
+    ok = ok && (!sync || file_->Sync());
+    ok = file_->Close() && ok;
+    file_.reset();
+
+    if (ok && overflow) {
+        ok = Rewrite();
+    }
+    return ok;
+}
+
+FlvWriter::~FlvWriter() {
+    if (file_) {
+        Close();
+    }
+}
+
+AMFValue FlvWriter::BuildMetadata(bool withKeyframes) const {
+    AMFValue object(AMF_ECMA_ARRAY);
+    for (auto &item : metadata_.AsObjectMap()) {
+        if (item.first != "keyframes" && item.first != "padding") {
+            object.Set(item.first, item.second);
+        }
+    }
+
+    double duration = state_.lastTimestamp / 1000.0;
+    object.Set("duration", AMFValue(duration));
+    object.Set("filesize", AMFValue((double)state_.offset));
+    object.Set("datarate", AMFValue(duration > 0 ? state_.mediaBytes * 8 / 1000.0 / duration : 0.0));
+
+    if (withKeyframes) {
+        AMFValue times(AMF_STRICT_ARRAY);
+        AMFValue positions(AMF_STRICT_ARRAY);
+        for (auto &keyframe : state_.keyframes) {
+            times.Add(AMFValue(keyframe.time));
+            positions.Add(AMFValue((double)keyframe.position));
+        }
+
+        AMFValue index(AMF_OBJECT);
+        index.Set("times", times);
+        index.Set("filepositions", positions);
+        object.Set("keyframes", index);
+    }
+    return object;
+}
+
+std::string FlvWriter::Pad(AMFValue object) const {
+    AMFEncoder encoder;
+    encoder << "onMetaData" << object;
+    size_t size = encoder.Data().size();
+    if (size == reserve_) {
+        return encoder.Data();
+    }
+
+    // "padding" key costs 9 bytes, the value fills the rest:
+    // null 1, boolean 2, empty string 3, empty object 4, strict array of nulls 5 + n
+    size_t gap = reserve_ - size;
+    if (size > reserve_ || gap < 10) {
+        return {};
+    }
+
+    AMFValue filler(AMF_NULL);
+    if (gap == 11) {
+        filler = AMFValue(false);
+    } else if (gap == 12) {
+        filler = AMFValue("");
+    } else if (gap == 13) {
+        filler = AMFValue(AMF_OBJECT);
+    } else if (gap >= 14) {
+        filler = AMFValue(AMF_STRICT_ARRAY);
+        for (size_t i = 0; i < gap - 14; ++i) {
+            filler.Add(AMFValue(AMF_NULL));
+        }
+    }
+    object.Set("padding", filler);
+
+    encoder.Clear();
+    encoder << "onMetaData" << object;
+    if (encoder.Data().size() != reserve_) {
+        return {};
+    }
+    return encoder.Data();
+}
+
+bool FlvWriter::Rewrite() {
+    std::string tmpName = filename_ + ".tmp";
+    auto reader = FileReader::Open(filename_);
+    auto writer = FileWriter::Open(tmpName);
+    if (!reader || !writer) {
+        unlink(tmpName.c_str());
+        return false;
+    }
+
+    // the rewritten file must be on disk before it replaces the original
+    MetadataInjector injector(reader->data, reader->size);
+    bool ok = injector.Scan() && injector.Inject(*writer) && writer->Sync();
+    ok = writer->Close() && ok;
+    if (!ok) {
+        unlink(tmpName.c_str());
+        return false;
+    }
+
+    if (rename(tmpName.c_str(), filename_.c_str()) != 0) {
+        perror("rename");
+        unlink(tmpName.c_str());
+        return false;
+    }
+    return true;
+}
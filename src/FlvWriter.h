@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FLV_WRITER_H
+#define FLV_MEDIA_FLV_WRITER_H
+
+#include "AMF.h"
+#include "FLV.h"
+#include "File.h"
+#include "MetadataInjector.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Writes FLV files whose onMetaData is finalized in place.
+///
+/// The first script tag carries a fixed-size AMF region padded with a "padding" property. At Close() duration,
+/// filesize, datarate and the keyframe table are encoded into that region and written back with one pwrite.
+/// Only when the table outgrows the reserve the file is rewritten once by MetadataInjector.
+class FlvWriter {
+public:
+    static const size_t DEFAULT_METADATA_RESERVE = 16 * 1024;
+
+    /// Everything needed to finalize the file, also what Recorder checkpoints
+    struct State {
+        uint64_t offset = 0; // end of the last written tag
+        uint64_t mediaBytes = 0;
+        uint32_t lastTimestamp = 0;
+        std::vector<MetadataInjector::Keyframe> keyframes;
+    };
+
+    static std::shared_ptr<FlvWriter> Open(const std::string &filename, bool hasVideo, bool hasAudio,
+                                           const AMFValue &metadata = AMFValue(AMF_ECMA_ARRAY),
+                                           size_t reserve = DEFAULT_METADATA_RESERVE);
+    static std::shared_ptr<FlvWriter> Open(std::shared_ptr<FileWriter> file, const std::string &filename,
+                                           bool hasVideo, bool hasAudio, const AMFValue &metadata, size_t reserve);
+    /// Continue a file written by FlvWriter, `file` must be positioned at state.offset
+    static std::shared_ptr<FlvWriter> Resume(std::shared_ptr<FileWriter> file, const std::string &filename,
+                                             const AMFValue &metadata, size_t reserve, const State &state);
+
+    bool WriteTag(TagType type, uint32_t timestamp, const uint8_t *data, size_t size);
+    /// Patch onMetaData and close the file, sync makes it durable before returning
+    bool Close(bool sync = false);
+
+    const State &GetState() const { return state_; }
+    const std::shared_ptr<FileWriter> &GetFile() const { return file_; }
+
+    ~FlvWriter();
+
+private:
+    FlvWriter(std::shared_ptr<FileWriter> file, std::string filename, const AMFValue &metadata, size_t reserve)
+        : file_(std::move(file)), filename_(std::move(filename)), metadata_(metadata), reserve_(reserve) {}
+
+    AMFValue BuildMetadata(bool withKeyframes) const;
+    /// Encode onMetaData to exactly reserve_ bytes, empty if it does not fit
+    std::string Pad(AMFValue object) const;
+    bool Rewrite();
+
+private:
+    std::shared_ptr<FileWriter> file_;
+    std::string filename_;
+    AMFValue metadata_;
+    size_t reserve_;
+
+    State state_;
+};
+
+#endif // FLV_MEDIA_FLV_WRITER_H
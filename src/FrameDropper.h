@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_FRAME_DROPPER_H
+#define FLV_MEDIA_FRAME_DROPPER_H
+
+#include <cstdint>
+
+/// What the rest of the stream loses when a frame is dropped, least important first
+enum FrameClass : uint8_t {
+    FRAME_DISPOSABLE = 0, // nal_ref_idc 0 or a sub-layer non-reference picture, nothing refers to it
+    FRAME_REFERENCE_B,    // B frame other frames predict from
+    FRAME_REFERENCE,      // P or non-IDR I frame
+    FRAME_KEY,            // IDR / IRAP, decoding can restart here
+    FRAME_CLASS_COUNT
+};
+
+enum DropPressure : uint8_t {
+    PRESSURE_NONE = 0,
+    PRESSURE_LOW,  // shed disposable frames, the stream stays complete
+    PRESSURE_HIGH, // keep key frames only
+};
+
+/// Sheds frames under backpressure so the output stays decodable.
+///
+/// Once a reference frame is dropped everything up to the next key frame is dropped too, no matter how the
+/// pressure changes meanwhile.
+class FrameDropper {
+public:
+    void SetPressure(DropPressure pressure) { pressure_ = pressure; }
+    DropPressure GetPressure() const { return pressure_; }
+
+    /// Returns false when the frame should be dropped
+    bool Admit(FrameClass frameClass) {
+        counts_[frameClass]++;
+        if (frameClass == FRAME_KEY) {
+            waitKey_ = false;
+        } else if (waitKey_ || (pressure_ == PRESSURE_LOW && frameClass == FRAME_DISPOSABLE)) {
+            dropped_++;
+            return false;
+        } else if (pressure_ == PRESSURE_HIGH) {
+            waitKey_ = frameClass != FRAME_DISPOSABLE;
+            dropped_++;
+            return false;
+        }
+        return true;
+    }
+
+    /// An admitted frame got lost after all, the frames predicted from it are dropped up to the next key frame
+    void Reject(FrameClass frameClass) {
+        waitKey_ = waitKey_ || frameClass != FRAME_DISPOSABLE;
+        dropped_++;
+    }
+
+    uint64_t GetCount(FrameClass frameClass) const { return counts_[frameClass]; }
+    uint64_t GetDropped() const { return dropped_; }
+
+private:
+    DropPressure pressure_ = PRESSURE_NONE;
+    bool waitKey_ = false;
+    uint64_t counts_[FRAME_CLASS_COUNT] = {};
+    uint64_t dropped_ = 0;
+};
+
+#endif // FLV_MEDIA_FRAME_DROPPER_H
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "HEVCConfiguration.h"
+#include "Log.h"
+#include <cstring>
+
+/*
+ * HEVCDecoderConfigurationRecord format specification, ISO/IEC 14496-15 8.3.3.1
+ * bits
+ * 8   configurationVersion ( always 0x01 )
+ * 2   general_profile_space
+ * 1   general_tier_flag
+ * 5   general_profile_idc
+ * 32  general_profile_compatibility_flags
+ * 48  general_constraint_indicator_flags
+ * 8   general_level_idc
+ * 16  reserved ( 4 bits on ) + min_spatial_segmentation_idc
+ * 8   reserved ( 6 bits on ) + parallelismType
+ * 8   reserved ( 6 bits on ) + chromaFormat
+ * 8   reserved ( 5 bits on ) + bitDepthLumaMinus8
+ * 8   reserved ( 5 bits on ) + bitDepthChromaMinus8
+ * 16  avgFrameRate
+ * 2   constantFrameRate
+ * 3   numTemporalLayers
+ * 1   temporalIdNested
+ * 2   lengthSizeMinusOne
+ * 8   numOfArrays
+ *         repeated once per array:
+ * 1   array_completeness
+ * 1   reserved
+ * 6   NAL_unit_type
+ * 16  numNalus
+ *         repeated once per NALU:
+ * 16  nalUnitLength
+ *         variable NALU data
+ */
+
+static const size_t HEVC_RECORD_HEADER_LENGTH = 23;
+
+HEVCConfiguration::HEVCConfiguration(const uint8_t *packet, size_t size) {
+    SetConfigurationPacket(packet, size);
+}
+
+bool HEVCConfiguration::SetConfigurationPacket(const uint8_t *pack, size_t size) {
+    // the record is kept anyway, comparing it costs no more than hashing and can not collide
+    if (!packet_.empty() && packet_.size() == size && memcmp(packet_.data(), pack, size) == 0) {
+        return false;
+    }
+
+    packet_ = std::string((const char *)pack, size);
+    if (!ParsePacket()) {
+        Log("Invalid HEVC configuration record");
+    }
+
+    static const char startCode[4] = {0x00, 0x00, 0x00, 0x01};
+    annexB_.clear();
+    for (auto &item : parameterSets_) {
+        annexB_.append(startCode, 4);
+        annexB_.append(item);
+    }
+    generation_++;
+    return true;
+}
+
+bool HEVCConfiguration::ParsePacket() {
+    parameterSets_.clear();
+    if (packet_.size() < HEVC_RECORD_HEADER_LENGTH) {
+        Log("HEVC configuration record too short: %zu", packet_.size());
+        return false;
+    }
+
+    auto p = (const uint8_t *)packet_.data();
+    auto end = p + packet_.size();
+    if (p[0] != 0x01) {
+        Log("Unsupported HEVC configuration version %d", p[0]);
+        return false;
+    }
+
+    profile_ = p[1] & 0x1f;
+    level_ = p[12];
+    naluLengthSize_ = (p[21] & 0x03) + 1;
+    int numOfArrays = p[22];
+    p += HEVC_RECORD_HEADER_LENGTH;
+
+    for (int i = 0; i < numOfArrays; ++i) {
+        if (p + 3 > end) {
+            return false;
+        }
+        int numNalus = p[1] << 8 | p[2];
+        p += 3;
+        for (int j = 0; j < numNalus; ++j) {
+            if (p + 2 > end) {
+                return false;
+            }
+            size_t length = p[0] << 8 | p[1];
+            p += 2;
+            if (p + length > end) {
+                return false;
+            }
+            parameterSets_.emplace_back((const char *)p, length);
+            p += length;
+        }
+    }
+    return true;
+}
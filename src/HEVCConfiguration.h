@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_HEVC_CONFIGURATION_H
+#define FLV_MEDIA_HEVC_CONFIGURATION_H
+
+#include "Span.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum HEVCNaluType : uint8_t {
+    HEVC_NALU_TRAIL_N = 0,
+    HEVC_NALU_RSV_VCL_N14 = 14,
+    HEVC_NALU_BLA_W_LP = 16,
+    HEVC_NALU_CRA = 21,
+    HEVC_NALU_RSV_IRAP_23 = 23,
+    HEVC_NALU_VPS = 32,
+    HEVC_NALU_SPS,
+    HEVC_NALU_PPS,
+    HEVC_NALU_PREFIX_SEI = 39,
+};
+
+class HEVCConfiguration {
+public:
+    HEVCConfiguration() = default;
+    HEVCConfiguration(const uint8_t *packet, size_t size);
+
+    /// Returns true when the record differs from the current one
+    bool SetConfigurationPacket(const uint8_t *pack, size_t size);
+
+    /// VPS, SPS, PPS and SEI units in record order
+    const std::vector<std::string> &GetParameterSets() const { return parameterSets_; }
+    int GetProfile() const { return profile_; }
+    int GetLevel() const { return level_; }
+    int GetNALULengthSize() const { return naluLengthSize_; }
+
+    /// Every parameter set behind 4 bytes start codes, ready to go in front of an IRAP picture
+    ByteSpan GetAnnexBParameterSets() const { return {(const uint8_t *)annexB_.data(), annexB_.size()}; }
+    /// Bumped whenever the parameter sets change
+    uint32_t GetGeneration() const { return generation_; }
+
+private:
+    bool ParsePacket();
+
+private:
+    std::string packet_;
+    std::vector<std::string> parameterSets_;
+    std::string annexB_;
+    uint32_t generation_ = 0;
+    int profile_ = 0;
+    int level_ = 0;
+    int naluLengthSize_ = 4;
+};
+
+#endif // FLV_MEDIA_HEVC_CONFIGURATION_H
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_JSON_WRITER_H
+#define FLV_MEDIA_JSON_WRITER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/// Builds compact JSON text for reports, commas are placed automatically.
+///
+/// ```
+/// JsonWriter json;
+/// json.BeginObject().Key("file").Value(name).Key("tags").Value(count).EndObject();
+/// ```
+class JsonWriter {
+public:
+    JsonWriter &BeginObject() { return Open('{'); }
+    JsonWriter &EndObject() { return Close('}'); }
+    JsonWriter &BeginArray() { return Open('['); }
+    JsonWriter &EndArray() { return Close(']'); }
+
+    JsonWriter &Key(std::string_view key) {
+        Separator();
+        AppendString(key);
+        out_ += ':';
+        afterKey_ = true;
+        return *this;
+    }
+
+    JsonWriter &Value(std::string_view value) {
+        Separator();
+        AppendString(value);
+        return *this;
+    }
+    JsonWriter &Value(const char *value) { return Value(std::string_view(value)); }
+    JsonWriter &Value(const std::string &value) { return Value(std::string_view(value)); }
+
+    JsonWriter &Value(bool value) {
+        Separator();
+        out_ += value ? "true" : "false";
+        return *this;
+    }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                                                  int>::type = 0>
+    JsonWriter &Value(T value) {
+        Separator();
+        if (std::is_signed<T>::value) {
+            out_ += std::to_string((long long)value);
+        } else {
+            out_ += std::to_string((unsigned long long)value);
+        }
+        return *this;
+    }
+
+    /// Non-finite numbers become null, JSON has no NaN
+    JsonWriter &Value(double value) {
+        Separator();
+        if (!std::isfinite(value)) {
+            out_ += "null";
+            return *this;
+        }
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.10g", value);
+        out_ += buffer;
+        return *this;
+    }
+
+    JsonWriter &Null() {
+        Separator();
+        out_ += "null";
+        return *this;
+    }
+
+    const std::string &GetString() const { return out_; }
+    void Clear() {
+        out_.clear();
+        first_.clear();
+        afterKey_ = false;
+    }
+
+private:
+    JsonWriter &Open(char c) {
+        Separator();
+        out_ += c;
+        first_.push_back(true);
+        return *this;
+    }
+
+    JsonWriter &Close(char c) {
+        out_ += c;
+        first_.pop_back();
+        return *this;
+    }
+
+    void Separator() {
+        if (afterKey_) {
+            afterKey_ = false;
+            return;
+        }
+        if (!first_.empty()) {
+            if (!first_.back()) {
+                out_ += ',';
+            }
+            first_.back() = false;
+        }
+    }
+
+    void AppendString(std::string_view s) {
+        static const char HEX[] = "0123456789abcdef";
+        out_ += '"';
+        for (unsigned char c : s) {
+            switch (c) {
+                case '"':
+                    out_ += "\\\"";
+                    break;
+                case '\\':
+                    out_ += "\\\\";
+                    break;
+                case '\n':
+                    out_ += "\\n";
+                    break;
+                case '\r':
+                    out_ += "\\r";
+                    break;
+                case '\t':
+                    out_ += "\\t";
+                    break;
+                default:
+                    if (c < 0x20) {
+                        out_ += "\\u00";
+                        out_ += HEX[c >> 4];
+                        out_ += HEX[c & 0x0f];
+                    } else {
+                        out_ += (char)c;
+                    }
+                    break;
+            }
+        }
+        out_ += '"';
+    }
+
+private:
+    std::string out_;
+    std::vector<bool> first_;
+    bool afterKey_ = false;
+};
+
+#endif // FLV_MEDIA_JSON_WRITER_H
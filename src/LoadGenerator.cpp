@@ -0,0 +1,439 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "LoadGenerator.h"
+#include "FLV.h"
+#include "TagRange.h"
+#include "TimerWheel.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t TICK = 1000000; // nanoseconds
+/// A turn of the wheel, about a second, covers the gap between two tags of any usual stream
+const size_t WHEEL_SLOTS = 1024;
+/// Pause between two plays of a looped file, about a frame, milliseconds
+const uint32_t LOOP_GAP = 40;
+/// Tags gathered into one writev() at most
+const int MAX_TAGS_PER_WRITE = 64;
+/// Lateness histogram, 10 us buckets up to 100 ms and one for everything later
+const int LATE_BUCKET = 10;
+const int LATE_BUCKETS = 10000;
+const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+
+uint64_t Now() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void SleepUntil(uint64_t due) {
+    timespec ts{};
+    ts.tv_sec = (time_t)(due / 1000000000);
+    ts.tv_nsec = (long)(due % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+/// The tags of one file, shared by all its streams
+struct Plan {
+    struct Tag {
+        uint64_t offset; // of the tag header in the mapping
+        uint32_t size;   // header, body and PreviousTagSize
+        uint32_t time;   // milliseconds from the first tag
+    };
+
+    const uint8_t *data = nullptr;
+    size_t headerSize = 0; // FLV header and PreviousTagSize0
+    std::vector<Tag> tags;
+    uint32_t loopLength = 0;
+};
+
+bool BuildPlan(const ByteSource &file, Plan &plan) {
+    plan.data = file.GetData();
+    if (file.GetBackend() == ByteSource::MAP) {
+        // every loop reads the file again, the pages should stay rather than go behind a sequential read
+        madvise((void *)plan.data, file.GetSize(), MADV_NORMAL);
+        madvise((void *)plan.data, file.GetSize(), MADV_WILLNEED);
+    }
+    uint32_t first = 0;
+    uint32_t duration = 0;
+    for (const TagView &tag : TagRange(plan.data, file.GetSize())) {
+        if (plan.tags.empty()) {
+            first = tag.timestamp;
+            plan.headerSize = tag.offset;
+        }
+        uint32_t time = tag.timestamp > first ? tag.timestamp - first : 0;
+        duration = std::max(duration, time);
+        uint32_t size = (uint32_t)(sizeof(FlvTagHeader) + tag.payload.size + PREVIOUS_TAG_SIZE_LENGTH);
+        plan.tags.push_back({tag.offset, size, time});
+    }
+    plan.loopLength = duration + LOOP_GAP;
+    return !plan.tags.empty();
+}
+
+struct Stream {
+    const Plan *plan;
+    int fd;
+    uint64_t start;           // nanoseconds, when the current play began
+    uint32_t timestampOffset; // added to every timestamp, as if the publisher had been live for a while
+    uint32_t loopMs = 0;      // media time of the plays before the current one
+    size_t next = 0;          // tag to send
+    size_t written = 0;       // bytes of the FLV header, or else of the next tag, already sent
+    bool headerSent = false;
+    bool failed = false;
+
+    uint64_t Due(size_t tag) const { return start + (uint64_t)plan->tags[tag].time * 1000000; }
+
+    void Advance() {
+        written = 0;
+        if (++next == plan->tags.size()) {
+            next = 0;
+            loopMs += plan->loopLength;
+            start += (uint64_t)plan->loopLength * 1000000;
+        }
+    }
+};
+
+struct Worker {
+    std::vector<uint32_t> streams;
+    std::vector<uint64_t> late = std::vector<uint64_t>(LATE_BUCKETS + 1);
+    double totalLate = 0; // microseconds
+    double maxLate = 0;
+    uint64_t tags = 0;
+    uint64_t bytes = 0;
+    uint64_t stalls = 0;
+    uint64_t failed = 0;
+};
+
+/// Writes what of the stream is due, false when the stream broke
+bool Send(Stream &stream, Worker &worker, uint64_t &nextDue) {
+    const Plan &plan = *stream.plan;
+    while (true) {
+        uint64_t now = Now();
+        iovec iov[2 * MAX_TAGS_PER_WRITE + 1];
+        uint8_t headers[MAX_TAGS_PER_WRITE][sizeof(FlvTagHeader)];
+        int count = 0;
+        size_t skip = stream.written;
+        auto add = [&](const uint8_t *data, size_t size) {
+            size_t n = std::min(skip, size);
+            skip -= n;
+            if (n < size) {
+                iov[count].iov_base = (void *)(data + n);
+                iov[count].iov_len = size - n;
+                count++;
+            }
+        };
+
+        if (!stream.headerSent) {
+            add(plan.data, plan.headerSize);
+        }
+        // the tags due by now, up to the end of this play; timestamps are rewritten in a copy of the header
+        int tags = 0;
+        for (size_t i = stream.next; i < plan.tags.size() && tags < MAX_TAGS_PER_WRITE; ++i, ++tags) {
+            if (stream.Due(i) > now) {
+                break;
+            }
+            const Plan::Tag &tag = plan.tags[i];
+            memcpy(headers[tags], plan.data + tag.offset, sizeof(FlvTagHeader));
+            ((FlvTagHeader *)headers[tags])->SetTimestamp(stream.timestampOffset + stream.loopMs + tag.time);
+            add(headers[tags], sizeof(FlvTagHeader));
+            add(plan.data + tag.offset + sizeof(FlvTagHeader), tag.size - sizeof(FlvTagHeader));
+        }
+        if (count == 0) {
+            nextDue = stream.Due(stream.next);
+            return true;
+        }
+
+        ssize_t n = writev(stream.fd, iov, count);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            worker.stalls++;
+            nextDue = now + TICK;
+            return true;
+        }
+        if (n < 0) {
+            return false;
+        }
+        worker.bytes += n;
+
+        // what went out, the first piece of it possibly started by an earlier write
+        size_t sent = (size_t)n + stream.written;
+        if (!stream.headerSent) {
+            if (sent < plan.headerSize) {
+                stream.written = sent;
+                worker.stalls++;
+                nextDue = now + TICK;
+                return true;
+            }
+            sent -= plan.headerSize;
+            stream.headerSent = true;
+            stream.written = 0;
+        }
+        for (int i = 0; i < tags; ++i) {
+            const Plan::Tag &tag = plan.tags[stream.next];
+            if (sent < tag.size) {
+                stream.written = sent;
+                break;
+            }
+            sent -= tag.size;
+            uint64_t late = (now - stream.Due(stream.next)) / 1000;
+            worker.late[std::min<uint64_t>(late / LATE_BUCKET, LATE_BUCKETS)]++;
+            worker.totalLate += late;
+            worker.maxLate = std::max(worker.maxLate, (double)late);
+            worker.tags++;
+            stream.Advance();
+        }
+        if (stream.written > 0) {
+            // the socket took less than offered, it is full
+            worker.stalls++;
+            nextDue = now + TICK;
+            return true;
+        }
+    }
+}
+
+void RunWorker(std::vector<Stream> &streams, Worker &worker, uint64_t begin, uint64_t end) {
+    TimerWheel wheel(begin, TICK, WHEEL_SLOTS);
+    for (uint32_t id : worker.streams) {
+        wheel.Schedule(id, streams[id].start);
+    }
+    while (wheel.GetSize() > 0) {
+        uint64_t now = Now();
+        if (now >= end) {
+            break;
+        }
+        wheel.Advance(now, [&](uint32_t id) {
+            Stream &stream = streams[id];
+            uint64_t nextDue = 0;
+            if (Send(stream, worker, nextDue)) {
+                wheel.Schedule(id, nextDue);
+                return;
+            }
+            // the other end is gone, it takes no more
+            stream.failed = true;
+            worker.failed++;
+        });
+        SleepUntil(std::min(wheel.GetNextTick(), end));
+    }
+}
+
+/// Empties the read ends of the pipes into /dev/null without copying, until `stop`
+void Drain(const std::vector<int> &fds, const std::atomic<bool> &stop) {
+    int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t i = 0; i < fds.size(); ++i) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fds[i];
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fds[i], &event);
+    }
+    std::vector<epoll_event> events(256);
+    while (!stop.load(std::memory_order_relaxed)) {
+        int n = epoll_wait(epollFd, events.data(), (int)events.size(), 100);
+        for (int i = 0; i < n; ++i) {
+            while (splice(events[i].data.fd, nullptr, null, nullptr, 1 << 20, SPLICE_F_MOVE | SPLICE_F_NONBLOCK) > 0) {
+            }
+        }
+    }
+    close(epollFd);
+    close(null);
+}
+
+/// A connected, non-blocking descriptor for `target`, -1 on failure
+int Connect(const std::string &target) {
+    int fd = -1;
+    size_t colon = target.rfind(':');
+    if (target.find('/') == std::string::npos && colon != std::string::npos) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *result = nullptr;
+        std::string host = target.substr(0, colon);
+        if (getaddrinfo(host.c_str(), target.c_str() + colon + 1, &hints, &result) != 0) {
+            return -1;
+        }
+        for (addrinfo *ai = result; ai && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(result);
+    } else {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (target.size() >= sizeof(address.sun_path)) {
+            return -1;
+        }
+        memcpy(address.sun_path, target.c_str(), target.size());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (sockaddr *)&address, sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return fd;
+}
+
+/// Thousands of streams need more descriptors than the usual soft limit
+void RaiseDescriptorLimit() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+double Percentile(const std::vector<uint64_t> &histogram, uint64_t total, double fraction) {
+    uint64_t rank = (uint64_t)(total * fraction);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        seen += histogram[i];
+        if (seen > rank) {
+            return (double)(i * LATE_BUCKET);
+        }
+    }
+    return (double)(LATE_BUCKETS * LATE_BUCKET);
+}
+
+} // namespace
+
+bool LoadGenerator::Run(const std::vector<std::shared_ptr<ByteSource>> &files, const Options &options,
+                        Stats &stats) {
+    std::vector<Plan> plans(files.size());
+    size_t usable = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (files[i]->GetData() && BuildPlan(*files[i], plans[i])) {
+            usable++;
+        } else {
+            printf("Load: no tags in file %zu, skipped\n", i);
+        }
+    }
+    if (usable == 0 || options.streams <= 0) {
+        return false;
+    }
+
+    RaiseDescriptorLimit();
+    // a publisher the server hangs up on is counted as failed, not a reason to die
+    signal(SIGPIPE, SIG_IGN);
+
+    bool pipes = options.target.empty() || options.target == "-";
+    std::vector<Stream> streams;
+    std::vector<int> readFds;
+    for (const Plan &plan : plans) {
+        for (int i = 0; i < options.streams && !plan.tags.empty(); ++i) {
+            int fd = -1;
+            if (pipes) {
+                int ends[2];
+                if (pipe2(ends, O_NONBLOCK | O_CLOEXEC) == 0) {
+                    readFds.push_back(ends[0]);
+                    fd = ends[1];
+                }
+            } else {
+                fd = Connect(options.target);
+            }
+            if (fd < 0) {
+                if (stats.failed == 0) {
+                    perror(pipes ? "pipe" : "connect");
+                }
+                stats.failed++;
+                continue;
+            }
+            Stream stream{};
+            stream.plan = &plan;
+            stream.fd = fd;
+            stream.timestampOffset = (uint32_t)(streams.size() * 2654435761u) % (1u << 23);
+            streams.push_back(stream);
+        }
+    }
+    stats.streams = streams.size() + stats.failed;
+    if (streams.empty()) {
+        return false;
+    }
+
+    std::atomic<bool> stop(false);
+    std::thread drain;
+    if (pipes) {
+        drain = std::thread(Drain, std::cref(readFds), std::cref(stop));
+        pthread_setname_np(drain.native_handle(), "flv-load-drain");
+    }
+
+    const uint64_t begin = Now() + TICK;
+    const uint64_t end = begin + (uint64_t)(options.seconds * 1e9);
+    int threadCount = std::max(1, std::min(options.threads, (int)streams.size()));
+    std::vector<Worker> workers(threadCount);
+    for (size_t i = 0; i < streams.size(); ++i) {
+        streams[i].start = begin + (uint64_t)options.spread * 1000000 * i / streams.size();
+        workers[i % threadCount].streams.push_back((uint32_t)i);
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(RunWorker, std::ref(streams), std::ref(workers[i]), begin, end);
+        pthread_setname_np(threads.back().native_handle(), ("flv-load-" + std::to_string(i)).c_str());
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    stats.seconds = (double)(std::max(Now(), end) - begin) / 1e9;
+
+    std::vector<uint64_t> late(LATE_BUCKETS + 1);
+    double totalLate = 0;
+    for (const Worker &worker : workers) {
+        stats.tags += worker.tags;
+        stats.bytes += worker.bytes;
+        stats.stalls += worker.stalls;
+        stats.failed += worker.failed;
+        stats.maxLate = std::max(stats.maxLate, worker.maxLate);
+        totalLate += worker.totalLate;
+        for (size_t i = 0; i < late.size(); ++i) {
+            late[i] += worker.late[i];
+        }
+    }
+    // the tags a stream still owed at the end show how far behind the generator or the target fell
+    stats.due = stats.tags;
+    for (Stream &stream : streams) {
+        while (stream.Due(stream.next) < end) {
+            stats.due++;
+            stream.Advance();
+        }
+        close(stream.fd);
+    }
+    if (stats.tags > 0) {
+        stats.meanLate = totalLate / stats.tags;
+        stats.p50Late = Percentile(late, stats.tags, 0.5);
+        stats.p99Late = Percentile(late, stats.tags, 0.99);
+    }
+
+    stop = true;
+    if (drain.joinable()) {
+        drain.join();
+    }
+    for (int fd : readFds) {
+        close(fd);
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_LOAD_GENERATOR_H
+#define FLV_MEDIA_LOAD_GENERATOR_H
+
+#include "ByteSource.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Replays FLV files as many simultaneous live publishers, in real time, to size an ingest server.
+///
+/// Every file is mapped once and walked once into a list of tags. Each of its `streams` publishers then sends
+/// the FLV header and the tags in their own connection, looping the file: a tag goes out when its timestamp
+/// is due, rewritten by the stream's own offset, with one writev() of an 11 bytes header built on the stack and
+/// the tag body straight from the mapping. The pages of a file are shared by all its streams and never copied
+/// in user space.
+///
+/// The streams are dealt to a few threads, each running a TimerWheel of 1 ms ticks: a thread sleeps until the
+/// next tick, then sends whatever is due. A socket that is full is retried at the next tick, from where the
+/// write stopped, and counted as a stall. Lateness against the due time is recorded per tag.
+///
+/// Targets:
+///  - "host:port": one TCP connection per stream
+///  - a path: one connection per stream to a unix stream socket
+///  - "-" or empty: one pipe per stream, drained to /dev/null with splice() by one more thread, to measure the
+///    generator alone
+class LoadGenerator {
+public:
+    struct Options {
+        std::string target;
+        int streams = 1; // per file
+        int threads = 2;
+        double seconds = 10;
+        int spread = 2000; // milliseconds over which the stream starts are spread
+    };
+
+    struct Stats {
+        uint64_t streams = 0;
+        uint64_t failed = 0; // streams whose connection broke, they stop
+        uint64_t tags = 0;
+        uint64_t due = 0; // tags due by the end, sent or not
+        uint64_t bytes = 0;
+        uint64_t stalls = 0; // writes that found the socket full
+        double seconds = 0;
+        double meanLate = 0; // microseconds from the due time of a tag to its write
+        double p50Late = 0;
+        double p99Late = 0;
+        double maxLate = 0;
+    };
+
+    /// False when nothing could be set up: no usable file or no stream connected
+    static bool Run(const std::vector<std::shared_ptr<ByteSource>> &files, const Options &options, Stats &stats);
+};
+
+#endif // FLV_MEDIA_LOAD_GENERATOR_H
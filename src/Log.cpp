@@ -0,0 +1,34 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "Log.h"
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+
+static LogCallback logCallback = nullptr;
+static void *logOpaque = nullptr;
+
+void SetLogCallback(LogCallback callback, void *opaque) {
+    logCallback = callback;
+    logOpaque = opaque;
+}
+
+bool IsLogging() {
+    return logCallback != nullptr;
+}
+
+void Log(const char *format, ...) {
+    if (!logCallback) {
+        return;
+    }
+    int error = errno;
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    logCallback(logOpaque, message);
+    errno = error;
+}
@@ -0,0 +1,22 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_LOG_H
+#define FLV_MEDIA_LOG_H
+
+/// Messages of the demux path: script data, codec configurations, unsupported codecs and bad records.
+///
+/// The library says nothing on its own, every message goes to the callback the application set, one line at a
+/// time without the newline. There is one callback for the process; set it before any work starts.
+using LogCallback = void (*)(void *opaque, const char *message);
+
+/// nullptr silences the library again
+void SetLogCallback(LogCallback callback, void *opaque);
+
+bool IsLogging();
+
+/// printf-like, nothing is formatted while no callback is set. errno is left as it was, for the caller to report.
+void Log(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif // FLV_MEDIA_LOG_H
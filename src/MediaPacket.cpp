@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "MediaPacket.h"
+#include "Log.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+static const size_t BLOCK_ALIGNMENT = 64;
+
+PacketPool::~PacketPool() {
+    for (void *slab : slabs_) {
+        free(slab);
+    }
+}
+
+MediaPacketPtr PacketPool::Allocate(size_t capacity) {
+    size_t blockSize = sizeof(MediaPacket) + capacity;
+    int sizeClass = 0;
+    while (sizeClass < SIZE_CLASS_COUNT && SIZE_CLASSES[sizeClass] < blockSize) {
+        sizeClass++;
+    }
+
+    void *block = nullptr;
+    if (sizeClass == SIZE_CLASS_COUNT) {
+        if (posix_memalign(&block, BLOCK_ALIGNMENT, blockSize) != 0) {
+            return {};
+        }
+        oversize_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        SizeClass &cls = classes_[sizeClass];
+        std::lock_guard<std::mutex> lock(cls.mutex);
+        if (!cls.free && !Grow(sizeClass)) {
+            return {};
+        }
+        block = cls.free;
+        cls.free = cls.free->next;
+        blockSize = SIZE_CLASSES[sizeClass];
+    }
+    packets_.fetch_add(1, std::memory_order_relaxed);
+
+    auto packet = new (block) MediaPacket;
+    packet->capacity = blockSize - sizeof(MediaPacket);
+    packet->pool_ = this;
+    packet->sizeClass_ = sizeClass == SIZE_CLASS_COUNT ? OVERSIZE : sizeClass;
+    return MediaPacketPtr(packet);
+}
+
+PacketPool::Stats PacketPool::GetStats() {
+    Stats stats;
+    stats.packets = packets_.load(std::memory_order_relaxed);
+    stats.oversize = oversize_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(slabMutex_);
+    stats.slabs = slabs_.size();
+    return stats;
+}
+
+void PacketPool::Release(MediaPacket *packet) {
+    uint8_t sizeClass = packet->sizeClass_;
+    packet->~MediaPacket();
+    if (sizeClass == OVERSIZE) {
+        free(packet);
+        return;
+    }
+
+    auto block = (FreeBlock *)packet;
+    SizeClass &cls = classes_[sizeClass];
+    std::lock_guard<std::mutex> lock(cls.mutex);
+    block->next = cls.free;
+    cls.free = block;
+}
+
+/// Called with the class locked, carves a new slab into free blocks
+bool PacketPool::Grow(int sizeClass) {
+    size_t blockSize = SIZE_CLASSES[sizeClass];
+    size_t size = blockSize > slabSize_ ? blockSize : slabSize_ / blockSize * blockSize;
+    void *slab = nullptr;
+    if (posix_memalign(&slab, BLOCK_ALIGNMENT, size) != 0) {
+        Log("Out of memory for a %zu bytes slab", size);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(slabMutex_);
+        slabs_.push_back(slab);
+    }
+
+    SizeClass &cls = classes_[sizeClass];
+    for (size_t offset = size; offset >= blockSize; offset -= blockSize) {
+        auto block = (FreeBlock *)((uint8_t *)slab + offset - blockSize);
+        block->next = cls.free;
+        cls.free = block;
+    }
+    return true;
+}
+
+bool PacketBuilder::Append(const uint8_t *data, size_t size) {
+    if (!packet_ || packet_->size + size > packet_->capacity) {
+        size_t used = packet_ ? packet_->size : 0;
+        size_t capacity = used + size > sizeHint_ ? (used + size) * 2 : sizeHint_;
+        MediaPacketPtr packet = pool_.Allocate(capacity);
+        if (!packet) {
+            return false;
+        }
+        if (packet_) {
+            memcpy(packet->data(), packet_->data(), used);
+            packet->size = used;
+        }
+        packet_ = std::move(packet);
+    }
+
+    memcpy(packet_->data() + packet_->size, data, size);
+    packet_->size += size;
+    return true;
+}
@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_MEDIA_PACKET_H
+#define FLV_MEDIA_MEDIA_PACKET_H
+
+#include "FLV.h"
+#include "FrameDropper.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class PacketPool;
+
+/// One demuxed access unit: an Annex-B / OBU / IVF frame or an ADTS framed AAC frame.
+///
+/// The packet sits at the head of a pool block with its payload right behind it, so a packet is a single
+/// allocation. It is shared by reference counting through MediaPacketPtr and goes back to its pool with the
+/// last reference.
+struct MediaPacket {
+    TagType stream = TAG_VIDEO;
+    bool keyFrame = false;
+    FrameClass frameClass = FRAME_REFERENCE;
+    uint32_t dts = 0;        // milliseconds, the tag timestamp
+    uint32_t pts = 0;        // dts plus the composition time offset
+    uint32_t generation = 0; // codec configuration generation the frame belongs to
+    uint32_t size = 0;       // payload bytes
+    uint32_t capacity = 0;
+
+    uint8_t *data() { return (uint8_t *)(this + 1); }
+    const uint8_t *data() const { return (const uint8_t *)(this + 1); }
+
+private:
+    friend class MediaPacketPtr;
+    friend class PacketPool;
+
+    std::atomic<uint32_t> refs_{1};
+    PacketPool *pool_ = nullptr;
+    uint8_t sizeClass_ = 0;
+};
+
+/// Intrusive reference to a MediaPacket
+class MediaPacketPtr {
+public:
+    MediaPacketPtr() = default;
+    MediaPacketPtr(const MediaPacketPtr &other) : packet_(other.packet_) {
+        if (packet_) {
+            packet_->refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    MediaPacketPtr(MediaPacketPtr &&other) noexcept : packet_(std::exchange(other.packet_, nullptr)) {}
+    MediaPacketPtr &operator=(MediaPacketPtr other) noexcept {
+        std::swap(packet_, other.packet_);
+        return *this;
+    }
+    ~MediaPacketPtr() { Reset(); }
+
+    void Reset();
+
+    MediaPacket *operator->() const { return packet_; }
+    MediaPacket &operator*() const { return *packet_; }
+    MediaPacket *get() const { return packet_; }
+    explicit operator bool() const { return packet_ != nullptr; }
+
+private:
+    friend class PacketPool;
+    explicit MediaPacketPtr(MediaPacket *packet) : packet_(packet) {}
+
+    MediaPacket *packet_ = nullptr;
+};
+
+/// Size-classed slab allocator for MediaPacket blocks.
+///
+/// Blocks of each class are carved out of large slabs and recycled through a free list, nothing is handed back
+/// to the heap before the pool goes away. Payloads beyond the largest class are allocated one by one. Packets
+/// may be released from any thread; the pool has to outlive them.
+class PacketPool {
+public:
+    /// Block sizes, packet header included
+    static constexpr size_t SIZE_CLASSES[] = {512, 2048, 8192, 32768, 131072, 524288, 2097152};
+    static constexpr int SIZE_CLASS_COUNT = sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]);
+    static constexpr uint8_t OVERSIZE = 0xff;
+
+    struct Stats {
+        uint64_t packets = 0;  // handed out
+        uint64_t slabs = 0;    // heap allocations for slabs
+        uint64_t oversize = 0; // heap allocations for packets beyond the largest class
+    };
+
+    explicit PacketPool(size_t slabSize = 1024 * 1024) : slabSize_(slabSize) {}
+    PacketPool(const PacketPool &) = delete;
+    PacketPool &operator=(const PacketPool &) = delete;
+    ~PacketPool();
+
+    /// A packet with room for at least `capacity` payload bytes, nullptr when out of memory
+    MediaPacketPtr Allocate(size_t capacity);
+
+    Stats GetStats();
+
+private:
+    friend class MediaPacketPtr;
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct SizeClass {
+        std::mutex mutex;
+        FreeBlock *free = nullptr;
+    };
+
+    void Release(MediaPacket *packet);
+    bool Grow(int sizeClass);
+
+private:
+    size_t slabSize_;
+    SizeClass classes_[SIZE_CLASS_COUNT];
+    std::mutex slabMutex_;
+    std::vector<void *> slabs_;
+    std::atomic<uint64_t> packets_{0};
+    std::atomic<uint64_t> oversize_{0};
+};
+
+inline void MediaPacketPtr::Reset() {
+    if (packet_ && packet_->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        packet_->pool_->Release(packet_);
+    }
+    packet_ = nullptr;
+}
+
+/// Collects the pieces of one frame into a pooled packet, growing it when a frame turns out larger than hinted
+class PacketBuilder {
+public:
+    explicit PacketBuilder(PacketPool &pool) : pool_(pool) {}
+
+    void Begin(size_t sizeHint) {
+        packet_.Reset();
+        sizeHint_ = sizeHint;
+    }
+    bool Append(const uint8_t *data, size_t size);
+    /// nullptr when nothing was appended since Begin()
+    MediaPacketPtr Finish() { return std::move(packet_); }
+
+private:
+    PacketPool &pool_;
+    MediaPacketPtr packet_;
+    size_t sizeHint_ = 0;
+};
+
+#endif // FLV_MEDIA_MEDIA_PACKET_H
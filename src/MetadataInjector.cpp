@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "MetadataInjector.h"
+#include "FLV.h"
+#include "VideoTag.h"
+#include <cstdio>
+#include <stdexcept>
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+
+MetadataInjector::MetadataInjector(const uint8_t *data, size_t size)
+    : data_(data), size_(size), metadata_(AMF_ECMA_ARRAY) {}
+
+bool MetadataInjector::Scan() {
+    if (size_ < sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH || data_[0] != 'F' || data_[1] != 'L' ||
+        data_[2] != 'V') {
+        printf("Not a valid .flv file\n");
+        return false;
+    }
+
+    keyframes_.clear();
+    size_t pos = sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH;
+    while (pos + sizeof(FlvTagHeader) <= size_) {
+        auto tag = (const FlvTagHeader *)(data_ + pos);
+        uint32_t length = tag->GetDataSize();
+        if (pos + sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH > size_) {
+            printf("Incomplete tag at %zu, dropped\n", pos);
+            break;
+        }
+
+        uint32_t timestamp = tag->GetTimestamp();
+        if (tag->type == TAG_SCRIPT && scriptOffset_ == 0) {
+            AMFDecoder decoder(tag->data, length);
+            AMFDecoder::Values values;
+            AMFStatus status = decoder.Decode(values);
+            const AMFValue::String *name = values.empty() ? nullptr : values[0].GetString();
+            if (!status.Ok()) {
+                printf("Ignore bad script tag at %zu: %s\n", pos, status.ToString().c_str());
+            } else if (values.size() >= 2 && name && *name == "onMetaData" &&
+                       (values[1].Type() == AMF_ECMA_ARRAY || values[1].Type() == AMF_OBJECT)) {
+                metadata_ = values[1];
+                scriptOffset_ = pos;
+                scriptLength_ = sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH;
+            }
+        } else if (tag->type == TAG_VIDEO && IsVideoKeyFrame(tag->data, length)) {
+            keyframes_.push_back({timestamp / 1000.0, pos});
+        }
+
+        if (timestamp > lastTimestamp_) {
+            lastTimestamp_ = timestamp;
+        }
+        pos += sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH;
+    }
+
+    tagsEnd_ = pos;
+    printf("%zu keyframes, onMetaData %s\n", keyframes_.size(), scriptOffset_ ? "found" : "not found");
+    return true;
+}
+
+std::string MetadataInjector::EncodeMetadata(const AMFValue &metadata, const std::vector<Keyframe> &keyframes,
+                                             uint64_t fileSize) {
+    AMFValue object(AMF_ECMA_ARRAY);
+    for (auto &item : metadata.AsObjectMap()) {
+        if (item.first != "keyframes" && item.first != "padding") {
+            object.Set(item.first, item.second);
+        }
+    }
+
+    AMFValue times(AMF_STRICT_ARRAY);
+    AMFValue positions(AMF_STRICT_ARRAY);
+    for (auto &keyframe : keyframes) {
+        times.Add(AMFValue(keyframe.time));
+        positions.Add(AMFValue((double)keyframe.position));
+    }
+
+    AMFValue index(AMF_OBJECT);
+    index.Set("times", times);
+    index.Set("filepositions", positions);
+
+    object.Set("filesize", AMFValue((double)fileSize));
+    object.Set("keyframes", index);
+
+    AMFEncoder encoder;
+    encoder << "onMetaData" << object;
+    return encoder.Data();
+}
+
+bool MetadataInjector::Inject(FileWriter &writer) {
+    if (tagsEnd_ == 0) {
+        printf("Scan() has not run\n");
+        return false;
+    }
+
+    // The encoded size only depends on the keyframe count, so size the new tag first and then shift the table.
+    std::string script = EncodeMetadata(metadata_, keyframes_, 0);
+    if (script.size() > 0xffffff) {
+        printf("onMetaData too large: %zu\n", script.size());
+        return false;
+    }
+
+    size_t newLength = sizeof(FlvTagHeader) + script.size() + PREVIOUS_TAG_SIZE_LENGTH;
+    uint64_t fileSize = tagsEnd_ - scriptLength_ + newLength;
+
+    std::vector<Keyframe> shifted = keyframes_;
+    for (auto &keyframe : shifted) {
+        keyframe.position += newLength;
+        if (scriptOffset_ && keyframe.position > scriptOffset_ + newLength) {
+            keyframe.position -= scriptLength_;
+        }
+    }
+
+    script = EncodeMetadata(metadata_, shifted, fileSize);
+    if (sizeof(FlvTagHeader) + script.size() + PREVIOUS_TAG_SIZE_LENGTH != newLength) {
+        printf("onMetaData size changed while encoding\n");
+        return false;
+    }
+
+    FlvTagHeader tag{};
+    tag.type = TAG_SCRIPT;
+    tag.SetDataSize(script.size());
+    uint32_t tagSize = sizeof(FlvTagHeader) + script.size();
+    uint8_t previousTagSize[4] = {uint8_t(tagSize >> 24), uint8_t(tagSize >> 16), uint8_t(tagSize >> 8),
+                                  uint8_t(tagSize)};
+
+    const size_t headerLength = sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH;
+    bool ok = writer.Write(data_, headerLength) && writer.Write((const uint8_t *)&tag, sizeof(tag)) &&
+              writer.Write(script) && writer.Write(previousTagSize, sizeof(previousTagSize));
+    if (scriptOffset_) {
+        ok = ok && writer.Write(data_ + headerLength, scriptOffset_ - headerLength);
+        ok = ok && writer.Write(data_ + scriptOffset_ + scriptLength_, tagsEnd_ - scriptOffset_ - scriptLength_);
+    } else {
+        ok = ok && writer.Write(data_ + headerLength, tagsEnd_ - headerLength);
+    }
+
+    if (!ok) {
+        printf("Write failed\n");
+        return false;
+    }
+
+    printf("Injected %zu keyframes, filesize %lu\n", keyframes_.size(), (unsigned long)fileSize);
+    return true;
+}
@@ -0,0 +1,55 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_METADATA_INJECTOR_H
+#define FLV_MEDIA_METADATA_INJECTOR_H
+
+#include "AMF.h"
+#include "File.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Rewrites onMetaData with `keyframes.times`/`keyframes.filepositions` so players can seek.
+///
+/// Pass 1 walks the tag headers and records only the keyframes, pass 2 streams the input to the
+/// writer with the new script tag in front. Memory is proportional to the keyframe count.
+class MetadataInjector {
+public:
+    struct Keyframe {
+        double time;       // seconds
+        uint64_t position; // offset of the tag header in the input file
+    };
+
+    MetadataInjector(const uint8_t *data, size_t size);
+
+    /// Walk the tags, must be called before Inject()
+    bool Scan();
+    bool Inject(FileWriter &writer);
+
+    const AMFValue &GetMetadata() const { return metadata_; }
+    const std::vector<Keyframe> &GetKeyframes() const { return keyframes_; }
+    uint32_t GetLastTimestamp() const { return lastTimestamp_; }
+
+    /// Builds `onMetaData` from `metadata` with the keyframe table and filesize filled in, a reserve
+    /// left by FlvWriter is dropped.
+    /// The encoded size does not depend on the values, only on the keyframe count.
+    static std::string EncodeMetadata(const AMFValue &metadata, const std::vector<Keyframe> &keyframes,
+                                      uint64_t fileSize);
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+    size_t tagsEnd_ = 0; // end of the last complete tag, trailing garbage is dropped
+
+    AMFValue metadata_;
+    size_t scriptOffset_ = 0; // offset of the old onMetaData tag, 0 if none
+    size_t scriptLength_ = 0; // tag header + data + PreviousTagSize
+
+    std::vector<Keyframe> keyframes_;
+    uint32_t lastTimestamp_ = 0;
+};
+
+#endif // FLV_MEDIA_METADATA_INJECTOR_H
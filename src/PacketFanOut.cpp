@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "PacketFanOut.h"
+#include <pthread.h>
+
+PacketFanOut::~PacketFanOut() {
+    if (started_) {
+        Finish();
+    }
+}
+
+void PacketFanOut::AddConsumer(const ConsumerOptions &options, Consumer consume) {
+    lanes_.emplace_back(new Lane(options, std::move(consume)));
+    lanes_.back()->stats.name = options.name;
+}
+
+void PacketFanOut::Start() {
+    for (auto &lane : lanes_) {
+        lane->thread = std::thread(&PacketFanOut::Consume, this, std::ref(*lane));
+        pthread_setname_np(lane->thread.native_handle(), lane->options.name.substr(0, 15).c_str());
+    }
+    started_ = true;
+}
+
+void PacketFanOut::Dispatch(const MediaPacketPtr &packet) {
+    for (auto &lane : lanes_) {
+        if (!Wants(*lane, *packet) || lane->failed.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        if (lane->options.backpressure == BACKPRESSURE_SHED) {
+            if (!Shed(*lane, packet)) {
+                lane->stats.dropped++;
+            }
+            continue;
+        }
+        MediaPacketPtr copy = packet;
+        lane->stats.producerStalls += lane->ring.PushAll(&copy, 1);
+    }
+}
+
+bool PacketFanOut::Finish() {
+    if (!started_) {
+        return true;
+    }
+    bool ok = true;
+    for (auto &lane : lanes_) {
+        lane->ring.Close();
+    }
+    for (auto &lane : lanes_) {
+        lane->thread.join();
+        lane->stats.failed = lane->failed;
+        ok &= !lane->stats.failed;
+    }
+    started_ = false;
+    return ok;
+}
+
+std::vector<PacketFanOut::ConsumerStats> PacketFanOut::GetStats() const {
+    std::vector<ConsumerStats> stats;
+    for (auto &lane : lanes_) {
+        stats.push_back(lane->stats);
+    }
+    return stats;
+}
+
+bool PacketFanOut::Wants(const Lane &lane, const MediaPacket &packet) const {
+    if (lane.options.keyFramesOnly && !packet.keyFrame) {
+        return false;
+    }
+    return packet.stream == TAG_VIDEO ? lane.options.video : lane.options.audio;
+}
+
+/// Queues the packet unless the lane is too far behind, false when it was dropped
+bool PacketFanOut::Shed(Lane &lane, const MediaPacketPtr &packet) {
+    // disposable frames go at half full, everything but key frames at 7/8
+    size_t capacity = lane.ring.GetCapacity();
+    size_t size = lane.ring.GetSize();
+    lane.dropper.SetPressure(size >= capacity - capacity / 8 ? PRESSURE_HIGH
+                             : size >= capacity / 2          ? PRESSURE_LOW
+                                                             : PRESSURE_NONE);
+    bool video = packet->stream == TAG_VIDEO;
+    if (video && !lane.dropper.Admit(packet->frameClass)) {
+        return false;
+    }
+
+    MediaPacketPtr copy = packet;
+    if (lane.ring.Push(&copy, 1) == 0) {
+        if (video) {
+            lane.dropper.Reject(packet->frameClass);
+        }
+        return false;
+    }
+    return true;
+}
+
+void PacketFanOut::Consume(Lane &lane) {
+    MediaPacketPtr batch[32];
+    size_t n;
+    while ((n = lane.ring.PopWait(batch, 32, &lane.stats.consumerStalls)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!lane.failed.load(std::memory_order_relaxed) && !lane.consume(batch[i])) {
+                lane.failed = true;
+            }
+            batch[i].Reset();
+        }
+        lane.stats.packets += n;
+    }
+}
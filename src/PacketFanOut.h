@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_PACKET_FAN_OUT_H
+#define FLV_MEDIA_PACKET_FAN_OUT_H
+
+#include "FrameDropper.h"
+#include "MediaPacket.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Hands the packets of one demux pass to any number of consumers, each on its own thread behind its own ring.
+///
+/// A packet is built once and shared by reference, so another consumer costs a ring slot and a reference, not
+/// another parse or copy. Each consumer picks what happens when it falls behind: BACKPRESSURE_BLOCK holds up
+/// the producer, and with it every other consumer, until there is room; BACKPRESSURE_SHED drops frames for
+/// that consumer only, through its own FrameDropper, so what it gets stays decodable.
+///
+/// ```
+/// PacketFanOut fanOut;
+/// fanOut.AddConsumer(options, [&](const MediaPacketPtr &packet) { return writer->Write(...); });
+/// fanOut.Start();
+/// ParseFlvFile(data, size, [&](const MediaPacketPtr &packet) { fanOut.Dispatch(packet); }, pool);
+/// fanOut.Finish();
+/// ```
+class PacketFanOut {
+public:
+    enum Backpressure : uint8_t {
+        BACKPRESSURE_BLOCK,
+        BACKPRESSURE_SHED,
+    };
+
+    struct ConsumerOptions {
+        std::string name; // also the thread name, at most 15 characters are kept
+        bool video = true;
+        bool audio = true;
+        bool keyFramesOnly = false;
+        size_t ringSize = 1024;
+        Backpressure backpressure = BACKPRESSURE_BLOCK;
+    };
+
+    /// Runs on the consumer's thread, false stops the consumer; the packets still queued for it are released
+    using Consumer = std::function<bool(const MediaPacketPtr &packet)>;
+
+    struct ConsumerStats {
+        std::string name;
+        uint64_t packets = 0;        // consumed
+        uint64_t dropped = 0;        // shed, never queued
+        uint64_t producerStalls = 0; // waits of the producer for room in this consumer's ring
+        uint64_t consumerStalls = 0; // waits of this consumer for packets
+        bool failed = false;
+    };
+
+    PacketFanOut() = default;
+    PacketFanOut(const PacketFanOut &) = delete;
+    PacketFanOut &operator=(const PacketFanOut &) = delete;
+    ~PacketFanOut();
+
+    /// Before Start() only
+    void AddConsumer(const ConsumerOptions &options, Consumer consume);
+
+    void Start();
+    /// Producer side, from one thread
+    void Dispatch(const MediaPacketPtr &packet);
+    /// Lets the consumers drain their rings and waits for them, false when one of them failed
+    bool Finish();
+
+    /// After Finish()
+    std::vector<ConsumerStats> GetStats() const;
+
+private:
+    struct Lane {
+        ConsumerOptions options;
+        Consumer consume;
+        SpscRing<MediaPacketPtr> ring;
+        FrameDropper dropper;
+        std::thread thread;
+        ConsumerStats stats;
+        std::atomic<bool> failed{false};
+
+        Lane(const ConsumerOptions &options, Consumer consume)
+            : options(options), consume(std::move(consume)), ring(options.ringSize) {}
+    };
+
+    bool Wants(const Lane &lane, const MediaPacket &packet) const;
+    bool Shed(Lane &lane, const MediaPacketPtr &packet);
+    void Consume(Lane &lane);
+
+private:
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    bool started_ = false;
+};
+
+#endif // FLV_MEDIA_PACKET_FAN_OUT_H
@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "PerfCounters.h"
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} EVENTS[PerfCounters::COUNTER_COUNT] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branchMisses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"cacheMisses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"pageFaults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+PerfCounters::Values &PerfCounters::Values::operator+=(const Values &other) {
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        valid[i] = valid[i] && other.valid[i];
+        counts[i] += other.counts[i];
+    }
+    return *this;
+}
+
+PerfCounters::Values PerfCounters::Values::Divide(uint64_t divisor) const {
+    Values values = *this;
+    for (int i = 0; divisor > 0 && i < COUNTER_COUNT; ++i) {
+        values.counts[i] /= divisor;
+    }
+    return values;
+}
+
+PerfCounters::PerfCounters() {
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = EVENTS[i].type;
+        attr.config = EVENTS[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1; // allowed up to perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds_[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool PerfCounters::IsAvailable() const {
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PerfCounters::Start() {
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+PerfCounters::Values PerfCounters::Stop() {
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    Values values;
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        uint64_t data[3]; // value, time enabled, time running
+        if (fds_[i] < 0 || read(fds_[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            continue;
+        }
+        values.valid[i] = true;
+        values.counts[i] = data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+    }
+    return values;
+}
+
+const char *PerfCounters::GetName(Counter counter) {
+    return EVENTS[counter].name;
+}
@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_PERF_COUNTERS_H
+#define FLV_MEDIA_PERF_COUNTERS_H
+
+#include <cstdint>
+
+/// Hardware and software event counters of the calling thread, user space only, through perf_event_open().
+///
+/// Each counter is opened on its own, so one the CPU, the kernel or perf_event_paranoid does not allow just
+/// stays invalid while the others count. Counts of a counter that was multiplexed are scaled up to the whole
+/// measured time.
+class PerfCounters {
+public:
+    enum Counter {
+        CYCLES = 0,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        CACHE_MISSES, // last level cache
+        PAGE_FAULTS,
+        COUNTER_COUNT
+    };
+
+    struct Values {
+        bool valid[COUNTER_COUNT] = {};
+        uint64_t counts[COUNTER_COUNT] = {};
+
+        Values &operator+=(const Values &other);
+        /// Counts per `divisor`, e.g. per pass; invalid counters stay invalid
+        Values Divide(uint64_t divisor) const;
+    };
+
+    PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+    ~PerfCounters();
+
+    /// False when not a single counter could be opened
+    bool IsAvailable() const;
+
+    /// Resets and starts all counters
+    void Start();
+    /// Stops the counters and reads them
+    Values Stop();
+
+    static const char *GetName(Counter counter);
+
+private:
+    int fds_[COUNTER_COUNT];
+};
+
+#endif // FLV_MEDIA_PERF_COUNTERS_H
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_READ_PLANNER_H
+#define FLV_MEDIA_READ_PLANNER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/// Decides what to read for a piece of a file that is not buffered yet.
+///
+/// Header walkers ask for a few bytes at a time, one tag after the other. Every miss becomes one request aligned
+/// to `alignment`. When the gap between the last request and the piece, going either way, is no bigger than that
+/// request and within `maxGap`, the walk is dense: the request doubles, up to `maxRequest`, in the direction of
+/// the walk, and a run of small tags costs a few big reads. A gap bigger than the request means the tags are
+/// bigger than what was read ahead, the request starts over at one alignment unit, so a walk over big tags
+/// reads one unit per header. `maxGap` bounds the unwanted bytes read through to save a request, it is the one
+/// to raise where a request costs a round trip.
+class ReadPlanner {
+public:
+    struct Options {
+        size_t alignment = 4096;
+        size_t maxRequest = 256 * 1024;
+        uint64_t maxGap = 64 * 1024;
+    };
+
+    struct Request {
+        uint64_t offset = 0;
+        size_t size = 0;
+    };
+
+    explicit ReadPlanner(const Options &options) : options_(options), requestSize_(options.alignment) {}
+
+    /// The request to issue for [offset, offset + size), it covers the piece unless the file ends first
+    Request Plan(uint64_t offset, size_t size, uint64_t fileSize) {
+        uint64_t end = offset + size;
+        uint64_t lastEnd = last_.offset + last_.size;
+        // a piece sticking out of the last request continues the walk like one right behind it
+        bool forward = last_.size > 0 && offset >= last_.offset && end > lastEnd;
+        bool backward = last_.size > 0 && !forward && offset < last_.offset;
+        uint64_t gap = 0;
+        if (forward) {
+            gap = offset > lastEnd ? offset - lastEnd : 0;
+        } else if (backward) {
+            gap = end < last_.offset ? last_.offset - end : 0;
+        }
+        bool dense = (forward || backward) && gap <= last_.size && gap <= options_.maxGap;
+        requestSize_ = dense ? std::min(options_.maxRequest, requestSize_ * 2) : options_.alignment;
+
+        uint64_t start = AlignDown(offset);
+        uint64_t stop = std::max(AlignUp(end), start + requestSize_);
+        if (backward) {
+            stop = AlignUp(end);
+            start = std::min(start, stop > requestSize_ ? stop - requestSize_ : 0);
+        }
+        stop = std::min(stop, fileSize);
+
+        last_.offset = start;
+        last_.size = stop > start ? (size_t)(stop - start) : 0;
+        requests_++;
+        return last_;
+    }
+
+    const Options &GetOptions() const { return options_; }
+    uint64_t GetRequests() const { return requests_; }
+
+private:
+    uint64_t AlignDown(uint64_t offset) const { return offset - offset % options_.alignment; }
+    uint64_t AlignUp(uint64_t offset) const { return AlignDown(offset + options_.alignment - 1); }
+
+private:
+    Options options_;
+    size_t requestSize_;
+    Request last_;
+    uint64_t requests_ = 0;
+};
+
+#endif // FLV_MEDIA_READ_PLANNER_H
@@ -0,0 +1,298 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "Recorder.h"
+#include "VideoTag.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+static const char INDEX_MAGIC[8] = {'F', 'L', 'V', 'I', 'D', 'X', '0', '1'};
+
+/// Makes a rename into the directory of `filename` durable
+static bool SyncDirectory(const std::string &filename) {
+    size_t slash = filename.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        perror("open");
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    if (!ok) {
+        perror("fsync");
+    }
+    close(fd);
+    return ok;
+}
+
+std::shared_ptr<Recorder> Recorder::Open(const std::string &filename, bool hasVideo, bool hasAudio,
+                                         const AMFValue &metadata, const Options &options) {
+    auto file = FileWriter::Open(filename, options.blockSize);
+    if (!file) {
+        return nullptr;
+    }
+
+    auto writer = FlvWriter::Open(file, filename, hasVideo, hasAudio, metadata, options.metadataReserve);
+    if (!writer) {
+        return nullptr;
+    }
+
+    auto recorder = std::shared_ptr<Recorder>(new Recorder(writer, filename, options));
+    if (options.preallocateSize > 0) {
+        if (file->Preallocate(0, options.preallocateSize)) {
+            recorder->allocated_ = options.preallocateSize;
+        } else {
+            recorder->options_.preallocateSize = 0;
+        }
+    }
+
+    if (!recorder->Checkpoint()) {
+        return nullptr;
+    }
+    return recorder;
+}
+
+bool Recorder::WriteTag(TagType type, uint32_t timestamp, const uint8_t *data, size_t size) {
+    if (!writer_ || !writer_->WriteTag(type, timestamp, data, size)) {
+        return false;
+    }
+
+    const FlvWriter::State &state = writer_->GetState();
+    if (options_.preallocateSize > 0 && state.offset + options_.blockSize > allocated_) {
+        if (!writer_->GetFile()->Preallocate(allocated_, options_.preallocateSize)) {
+            return false;
+        }
+        allocated_ += options_.preallocateSize;
+    }
+
+    if (type == TAG_SCRIPT) {
+        return true;
+    }
+    // audio and video interleave a little out of order, only a jump back by more than an interval restarts the
+    // count, e.g. a publisher that reconnected with its timestamps from 0
+    if ((uint64_t)timestamp + options_.checkpointInterval < highestTimestamp_) {
+        highestTimestamp_ = timestamp;
+        lastCheckpoint_ = timestamp;
+        return Checkpoint();
+    }
+    if (timestamp > highestTimestamp_) {
+        highestTimestamp_ = timestamp;
+    }
+    if ((uint64_t)highestTimestamp_ >= (uint64_t)lastCheckpoint_ + options_.checkpointInterval) {
+        lastCheckpoint_ = highestTimestamp_;
+        return Checkpoint();
+    }
+    return true;
+}
+
+bool Recorder::Close() {
+    if (!writer_) {
+        return false;
+    }
+
+    // give back the preallocated extents past the end of the data
+    bool ok = writer_->GetFile()->Truncate(writer_->GetState().offset);
+    ok = writer_->Close(true) && ok;
+    writer_.reset();
+
+    // without the final data durably in place the index is still what a recovery needs
+    if (ok) {
+        unlink(IndexName(filename_).c_str());
+    }
+    return ok;
+}
+
+Recorder::~Recorder() {
+    if (writer_) {
+        Close();
+    }
+}
+
+bool Recorder::Checkpoint() {
+    // the data must be on disk before an index pointing at it
+    if (!writer_->GetFile()->Sync()) {
+        return false;
+    }
+    return SaveIndex(filename_, writer_->GetState());
+}
+
+bool Recorder::SaveIndex(const std::string &filename, const FlvWriter::State &state) {
+    std::string buffer(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    uint32_t count = state.keyframes.size();
+    buffer.append((const char *)&state.offset, sizeof(state.offset));
+    buffer.append((const char *)&state.mediaBytes, sizeof(state.mediaBytes));
+    buffer.append((const char *)&state.lastTimestamp, sizeof(state.lastTimestamp));
+    buffer.append((const char *)&count, sizeof(count));
+    for (auto &keyframe : state.keyframes) {
+        buffer.append((const char *)&keyframe.time, sizeof(keyframe.time));
+        buffer.append((const char *)&keyframe.position, sizeof(keyframe.position));
+    }
+
+    std::string indexName = IndexName(filename);
+    std::string tmpName = indexName + ".tmp";
+    auto file = FileWriter::Open(tmpName);
+    // the new index must be on disk before it replaces the old one, or a power loss can leave neither
+    if (!file || !file->Write(buffer) || !file->Sync() || !file->Close()) {
+        unlink(tmpName.c_str());
+        return false;
+    }
+
+    if (rename(tmpName.c_str(), indexName.c_str()) != 0) {
+        perror("rename");
+        return false;
+    }
+    return SyncDirectory(indexName);
+}
+
+bool Recorder::LoadIndex(const std::string &filename, FlvWriter::State &state) {
+    if (access(IndexName(filename).c_str(), F_OK) != 0) {
+        return false;
+    }
+
+    auto reader = FileReader::Open(IndexName(filename));
+    if (!reader) {
+        return false;
+    }
+
+    const size_t fixedSize = sizeof(INDEX_MAGIC) + 8 + 8 + 4 + 4;
+    const uint8_t *p = reader->data;
+    if (reader->size < fixedSize || memcmp(p, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        printf("Invalid index %s\n", IndexName(filename).c_str());
+        return false;
+    }
+
+    uint32_t count = 0;
+    p += sizeof(INDEX_MAGIC);
+    memcpy(&state.offset, p, 8);
+    memcpy(&state.mediaBytes, p + 8, 8);
+    memcpy(&state.lastTimestamp, p + 16, 4);
+    memcpy(&count, p + 20, 4);
+    p += 24;
+    if (reader->size != fixedSize + (size_t)count * 16) {
+        printf("Invalid index %s\n", IndexName(filename).c_str());
+        return false;
+    }
+
+    state.keyframes.resize(count);
+    for (auto &keyframe : state.keyframes) {
+        memcpy(&keyframe.time, p, 8);
+        memcpy(&keyframe.position, p + 8, 8);
+        p += 16;
+    }
+    return true;
+}
+
+bool Recorder::Recover(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        perror("open");
+        return false;
+    }
+
+    struct stat sb {};
+    if (fstat(fd, &sb) == -1) {
+        perror("fstat");
+        close(fd);
+        return false;
+    }
+    uint64_t fileSize = sb.st_size;
+
+    // onMetaData written by FlvWriter comes first, its size is the reserve
+    uint8_t head[sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH + sizeof(FlvTagHeader)];
+    if (pread(fd, head, sizeof(head), 0) != (ssize_t)sizeof(head) || memcmp(head, "FLV", 3) != 0) {
+        printf("Not a valid .flv file\n");
+        close(fd);
+        return false;
+    }
+
+    auto scriptTag = (const FlvTagHeader *)(head + sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH);
+    size_t reserve = scriptTag->GetDataSize();
+    AMFValue metadata(AMF_NULL);
+    if (scriptTag->type == TAG_SCRIPT && sizeof(head) + reserve <= fileSize) {
+        std::string script(reserve, '\0');
+        if (pread(fd, &script[0], reserve, sizeof(head)) == (ssize_t)reserve) {
+            AMFDecoder decoder((const uint8_t *)script.data(), script.size());
+            AMFDecoder::Values values;
+            AMFStatus status = decoder.Decode(values);
+            if (!status.Ok()) {
+                printf("Bad onMetaData: %s\n", status.ToString().c_str());
+            } else if (values.size() >= 2 && (values[1].Type() == AMF_ECMA_ARRAY || values[1].Type() == AMF_OBJECT)) {
+                metadata = values[1];
+            }
+        }
+    }
+
+    FlvWriter::State state;
+    uint64_t firstTag = sizeof(head) + reserve + PREVIOUS_TAG_SIZE_LENGTH;
+    if (!LoadIndex(filename, state) || state.offset < firstTag || state.offset > fileSize) {
+        state = FlvWriter::State();
+        state.offset = metadata.Type() == AMF_NULL ? sizeof(FLVHeader) + PREVIOUS_TAG_SIZE_LENGTH : firstTag;
+    }
+    printf("resume scan at %lu of %lu\n", (unsigned long)state.offset, (unsigned long)fileSize);
+
+    // walk forward from the checkpoint while the PreviousTagSize chain holds
+    while (state.offset + sizeof(FlvTagHeader) <= fileSize) {
+        uint8_t buffer[sizeof(FlvTagHeader) + 2] = {};
+        if (pread(fd, buffer, sizeof(buffer), state.offset) < (ssize_t)sizeof(FlvTagHeader)) {
+            break;
+        }
+
+        auto tag = (const FlvTagHeader *)buffer;
+        uint64_t length = tag->GetDataSize();
+        uint8_t type = buffer[0] & 0x1f;
+        if ((type != TAG_AUDIO && type != TAG_VIDEO && type != TAG_SCRIPT) || tag->streamId[0] ||
+            tag->streamId[1] || tag->streamId[2] ||
+            state.offset + sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH > fileSize) {
+            break;
+        }
+
+        uint8_t p[4];
+        if (pread(fd, p, 4, state.offset + sizeof(FlvTagHeader) + length) != 4 ||
+            (uint32_t)(p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]) != sizeof(FlvTagHeader) + length) {
+            break;
+        }
+
+        uint32_t timestamp = tag->GetTimestamp();
+        if (type == TAG_VIDEO && IsVideoKeyFrame(tag->data, length)) {
+            state.keyframes.push_back({timestamp / 1000.0, state.offset});
+        }
+        if (type != TAG_SCRIPT) {
+            state.mediaBytes += length;
+        }
+        if (timestamp > state.lastTimestamp) {
+            state.lastTimestamp = timestamp;
+        }
+        state.offset += sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH;
+    }
+
+    bool ok = ftruncate(fd, (off_t)state.offset) == 0;
+    if (!ok) {
+        perror("ftruncate");
+    } else if (fdatasync(fd) != 0) {
+        perror("fdatasync");
+        ok = false;
+    }
+    close(fd);
+    if (!ok) {
+        return false;
+    }
+    printf("truncated to %lu, dropped %lu bytes\n", (unsigned long)state.offset,
+           (unsigned long)(fileSize - state.offset));
+
+    if (metadata.Type() != AMF_NULL) {
+        auto file = FileWriter::Open(filename, 0, true);
+        auto writer = FlvWriter::Resume(file, filename, metadata, reserve, state);
+        if (!writer || !writer->Close(true)) {
+            return false;
+        }
+    }
+
+    unlink(IndexName(filename).c_str());
+    return true;
+}
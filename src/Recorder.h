@@ -0,0 +1,60 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_RECORDER_H
+#define FLV_MEDIA_RECORDER_H
+
+#include "FlvWriter.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// Crash-safe live recorder on top of FlvWriter.
+///
+/// Disk extents are preallocated ahead of the write position and writes go out in large blocks.
+/// Every `checkpointInterval` of media time the data is synced and the writer state is saved next to the
+/// recording (`<file>.idx`), so a crash loses at most one interval. Recover() truncates a crashed recording
+/// after its last valid tag and finalizes onMetaData in place.
+class Recorder {
+public:
+    struct Options {
+        size_t blockSize = 1024 * 1024;
+        size_t preallocateSize = 64 * 1024 * 1024;
+        uint32_t checkpointInterval = 2000; // milliseconds of media time
+        size_t metadataReserve = FlvWriter::DEFAULT_METADATA_RESERVE;
+    };
+
+    static std::shared_ptr<Recorder> Open(const std::string &filename, bool hasVideo, bool hasAudio,
+                                          const AMFValue &metadata, const Options &options);
+    static std::shared_ptr<Recorder> Open(const std::string &filename, bool hasVideo, bool hasAudio,
+                                          const AMFValue &metadata) {
+        return Open(filename, hasVideo, hasAudio, metadata, Options());
+    }
+    static bool Recover(const std::string &filename);
+
+    bool WriteTag(TagType type, uint32_t timestamp, const uint8_t *data, size_t size);
+    bool Close();
+
+    ~Recorder();
+
+private:
+    Recorder(std::shared_ptr<FlvWriter> writer, std::string filename, const Options &options)
+        : writer_(std::move(writer)), filename_(std::move(filename)), options_(options) {}
+
+    bool Checkpoint();
+    static std::string IndexName(const std::string &filename) { return filename + ".idx"; }
+    static bool SaveIndex(const std::string &filename, const FlvWriter::State &state);
+    static bool LoadIndex(const std::string &filename, FlvWriter::State &state);
+
+private:
+    std::shared_ptr<FlvWriter> writer_;
+    std::string filename_;
+    Options options_;
+    uint64_t allocated_ = 0;
+    uint32_t lastCheckpoint_ = 0;   // media time of the last checkpoint
+    uint32_t highestTimestamp_ = 0; // of the audio and video tags since the last discontinuity
+};
+
+#endif // FLV_MEDIA_RECORDER_H
@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "ReverseTagReader.h"
+#include "FlvSalvager.h"
+#include "VideoTag.h"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+
+std::shared_ptr<ReverseTagReader> ReverseTagReader::Open(const std::string &filename) {
+    auto source = ByteSource::Open(filename, ByteSource::PREAD);
+    if (!source) {
+        return nullptr;
+    }
+
+    const uint8_t *header = source->Read(0, sizeof(FLVHeader));
+    if (!header || header[0] != 'F' || header[1] != 'L' || header[2] != 'V') {
+        printf("Not a valid .flv file: %s\n", filename.c_str());
+        return nullptr;
+    }
+    return std::shared_ptr<ReverseTagReader>(new ReverseTagReader(source, (const FLVHeader *)header));
+}
+
+ReverseTagReader::ReverseTagReader(std::shared_ptr<ByteSource> source, const FLVHeader *header)
+    : source_(std::move(source)), fileSize_(source_->GetSize()), position_(fileSize_),
+      hasVideo_(header->flagVideo), hasAudio_(header->flagAudio) {
+    auto offset = header->offset;
+    dataOffset_ = (uint32_t)offset[0] << 24 | offset[1] << 16 | offset[2] << 8 | offset[3];
+    dataOffset_ += PREVIOUS_TAG_SIZE_LENGTH;
+}
+
+bool ReverseTagReader::Previous(Tag &tag) {
+    if (brokenAt_ || position_ <= dataOffset_) {
+        return false;
+    }
+
+    const uint8_t *p = source_->Read(position_ - PREVIOUS_TAG_SIZE_LENGTH, PREVIOUS_TAG_SIZE_LENGTH);
+    uint32_t previousTagSize = p ? (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3] : 0;
+    uint64_t end = position_ - PREVIOUS_TAG_SIZE_LENGTH;
+    if (previousTagSize < sizeof(FlvTagHeader) || previousTagSize > end - dataOffset_) {
+        return Break(end, tag);
+    }
+
+    uint64_t offset = end - previousTagSize;
+    size_t probe = (size_t)std::min<uint64_t>(sizeof(FlvTagHeader) + 2, previousTagSize);
+    p = source_->Read(offset, probe);
+    if (!p) {
+        return Break(end, tag);
+    }
+    auto header = (const FlvTagHeader *)p;
+    if ((p[0] != TAG_AUDIO && p[0] != TAG_VIDEO && p[0] != TAG_SCRIPT) ||
+        header->GetDataSize() + sizeof(FlvTagHeader) != previousTagSize) {
+        return Break(end, tag);
+    }
+
+    tag.type = header->type;
+    tag.timestamp = header->GetTimestamp();
+    tag.offset = offset;
+    tag.size = header->GetDataSize();
+    tag.keyFrame = tag.type == TAG_VIDEO && IsVideoKeyFrame(header->data, probe - sizeof(FlvTagHeader));
+    position_ = offset;
+    return true;
+}
+
+bool ReverseTagReader::Break(uint64_t end, Tag &tag) {
+    // only the end of the file is searched, a break further in is where the walk stops
+    if (position_ == fileSize_ && !truncatedAt_ && Resync()) {
+        return Previous(tag);
+    }
+    brokenAt_ = end;
+    return false;
+}
+
+bool ReverseTagReader::Resync() {
+    uint64_t start = std::max(dataOffset_, fileSize_ - std::min<uint64_t>(fileSize_, RESYNC_WINDOW));
+    std::vector<uint8_t> window(fileSize_ - start);
+    if (window.empty() || !source_->ReadAt(start, window.data(), window.size())) {
+        return false;
+    }
+
+    // the first tag found from the back is the last complete one, IsTagAt() wants its PreviousTagSize as well
+    for (size_t pos = window.size(); pos-- > 0;) {
+        if (FlvSalvager::IsTagAt(window.data(), window.size(), pos)) {
+            size_t length = ((const FlvTagHeader *)(window.data() + pos))->GetDataSize();
+            truncatedAt_ = start + pos + sizeof(FlvTagHeader) + length + PREVIOUS_TAG_SIZE_LENGTH;
+            position_ = truncatedAt_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ReverseTagReader::GetFirstTimestamp(uint32_t &timestamp) {
+    if (dataOffset_ + sizeof(FlvTagHeader) > fileSize_) {
+        return false;
+    }
+    const uint8_t *p = source_->Read(dataOffset_, sizeof(FlvTagHeader));
+    if (!p) {
+        return false;
+    }
+    timestamp = ((const FlvTagHeader *)p)->GetTimestamp();
+    return true;
+}
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_REVERSE_TAG_READER_H
+#define FLV_MEDIA_REVERSE_TAG_READER_H
+
+#include "ByteSource.h"
+#include "FLV.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// Walks the tags of an FLV file backwards from the end, following the PreviousTagSize fields.
+///
+/// Each step reads the PreviousTagSize in front of the current position and the header of the tag it points
+/// at, and checks that the two agree. Reads go through a PREAD ByteSource, which reads ahead only where the tags
+/// are small, so the tail of a file costs a few KB no matter how long the file is.
+///
+/// A file cut off in the middle of its last tag, as a crashed recorder leaves it, ends on no valid
+/// PreviousTagSize. The last RESYNC_WINDOW bytes are then searched backwards for the last complete tag, and the
+/// walk starts from there.
+class ReverseTagReader {
+public:
+    static constexpr size_t RESYNC_WINDOW = 64 * 1024;
+
+    struct Tag {
+        TagType type;
+        uint32_t timestamp;
+        uint64_t offset; // of the tag header
+        uint32_t size;   // of the tag body
+        bool keyFrame;   // video tags only
+    };
+
+    static std::shared_ptr<ReverseTagReader> Open(const std::string &filename);
+
+    /// Steps to the previous tag, false at the first tag or when the chain is broken
+    bool Previous(Tag &tag);
+
+    /// Timestamp of the first tag in the file, false when there is none
+    bool GetFirstTimestamp(uint32_t &timestamp);
+
+    /// Flags of the file header, what the file claims to contain
+    bool HasVideo() const { return hasVideo_; }
+    bool HasAudio() const { return hasAudio_; }
+
+    /// Where the chain stopped making sense, 0 while it is intact
+    uint64_t GetBrokenAt() const { return brokenAt_; }
+    /// Where the incomplete tail behind the last complete tag starts, 0 when the file ends on a complete tag
+    uint64_t GetTruncatedAt() const { return truncatedAt_; }
+    uint64_t GetFileSize() const { return fileSize_; }
+    uint64_t GetBytesRead() const { return source_->GetBytesRead(); }
+    uint64_t GetReads() const { return source_->GetReads(); }
+
+private:
+    ReverseTagReader(std::shared_ptr<ByteSource> source, const FLVHeader *header);
+    /// Resyncs a file that ends on a cut off tag, or marks the chain broken at `end`
+    bool Break(uint64_t end, Tag &tag);
+    /// Moves position_ behind the last complete tag in the last RESYNC_WINDOW bytes, false when there is none
+    bool Resync();
+
+private:
+    std::shared_ptr<ByteSource> source_;
+    uint64_t fileSize_;
+    uint64_t dataOffset_; // first tag
+    uint64_t position_;   // right behind the PreviousTagSize of the next tag to return
+    uint64_t brokenAt_ = 0;
+    uint64_t truncatedAt_ = 0;
+    bool hasVideo_;
+    bool hasAudio_;
+};
+
+#endif // FLV_MEDIA_REVERSE_TAG_READER_H
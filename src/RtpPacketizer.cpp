@@ -0,0 +1,291 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "RtpPacketizer.h"
+#include "AVCConfiguration.h"
+#include "AudioSpecificConfig.h"
+#include "AudioTag.h"
+#include "CodecTraits.h"
+#include "TagRange.h"
+#include "VideoTag.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static const uint8_t NALU_TYPE_STAP_A = 24;
+static const uint8_t NALU_TYPE_FU_A = 28;
+/// AU size field of the AU header, 13 bits in AAC-hbr
+static const size_t MAX_AU_SIZE = (1 << 13) - 1;
+
+static std::string Base64(const std::string &data) {
+    static const char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t bits = (uint8_t)data[i] << 16;
+        bits |= i + 1 < data.size() ? (uint8_t)data[i + 1] << 8 : 0;
+        bits |= i + 2 < data.size() ? (uint8_t)data[i + 2] : 0;
+        out += TABLE[bits >> 18 & 0x3f];
+        out += TABLE[bits >> 12 & 0x3f];
+        out += i + 1 < data.size() ? TABLE[bits >> 6 & 0x3f] : '=';
+        out += i + 2 < data.size() ? TABLE[bits & 0x3f] : '=';
+    }
+    return out;
+}
+
+static std::string Hex(const uint8_t *data, size_t size) {
+    std::string out;
+    char buffer[3];
+    for (size_t i = 0; i < size; ++i) {
+        snprintf(buffer, sizeof(buffer), "%02x", data[i]);
+        out += buffer;
+    }
+    return out;
+}
+
+RtpPacketizer::RtpPacketizer(const uint8_t *data, size_t size, const Options &options) : options_(options) {
+    AVCConfiguration avc;
+    std::vector<ByteSpan> nalus;
+    bool warned = false;
+    bool hasTimestamp = false;
+    uint32_t firstTimestamp = 0;
+
+    for (const TagView &tag : TagRange(data, size)) {
+        const uint8_t *p = tag.payload.data;
+        size_t length = tag.payload.size;
+        if (length < 2 || (tag.type != TAG_VIDEO && tag.type != TAG_AUDIO)) {
+            continue;
+        }
+        if (!hasTimestamp) {
+            hasTimestamp = true;
+            firstTimestamp = tag.timestamp;
+        }
+        duration_ = std::max(duration_, tag.timestamp - firstTimestamp);
+
+        if (tag.type == TAG_AUDIO) {
+            auto tagHeader = (const AACAudioTagHeader *)p;
+            if (tagHeader->codec != CODEC_AAC) {
+                continue;
+            }
+            if (tagHeader->packetType == AAC_HEADER) {
+                AudioSpecificConfig config((char *)tagHeader->data, (int)(length - sizeof(AACAudioTagHeader)));
+                audioClockRate_ = config.GetSampleRate();
+                audioChannels_ = config.GetChannels();
+                if (audioConfig_.empty()) {
+                    audioConfig_.assign((const char *)tagHeader->data, length - sizeof(AACAudioTagHeader));
+                }
+            } else if (audioClockRate_ > 0) {
+                uint32_t timestamp = (uint32_t)((uint64_t)tag.timestamp * audioClockRate_ / 1000);
+                PacketizeAAC(tag.timestamp, timestamp, tagHeader->data, length - sizeof(AACAudioTagHeader));
+            }
+            continue;
+        }
+
+        // the same header handling as the demuxer: legacy AVCPacketType values match VideoPacketType
+        VideoPacketType packetType;
+        size_t skip;
+        if (p[0] & 0x80) {
+            auto tagHeader = (const ExVideoTagHeader *)p;
+            if (tagHeader->GetFourCC() != FOURCC_AVC) {
+                if (!warned) {
+                    printf("RTP: video other than H.264 is skipped\n");
+                    warned = true;
+                }
+                continue;
+            }
+            packetType = tagHeader->packetType;
+            skip = sizeof(ExVideoTagHeader);
+        } else if (((const VideoTagHeader *)p)->codec == CODEC_AVC && length >= sizeof(AVCVideoTagHeader)) {
+            packetType = (VideoPacketType)((const AVCVideoTagHeader *)p)->packetType;
+            skip = packetType == PACKET_CODED_FRAMES ? 2 : sizeof(AVCVideoTagHeader);
+        } else {
+            if (!warned) {
+                printf("RTP: video other than H.264 is skipped\n");
+                warned = true;
+            }
+            continue;
+        }
+        if (length <= skip) {
+            continue;
+        }
+        p += skip;
+        length -= skip;
+
+        if (packetType == PACKET_SEQUENCE_START) {
+            if (!avc.SetConfigurationPacket(p, length) && !parameterSets_.empty()) {
+                continue;
+            }
+            parameterSets_.clear();
+            for (auto list : {&avc.GetSPSList(), &avc.GetPPSList()}) {
+                for (auto &set : *list) {
+                    parameterSets_.push_back(Keep((const uint8_t *)set.data(), set.size()));
+                }
+            }
+            if (sps_.empty()) {
+                sps_ = avc.GetSPS();
+                pps_ = avc.GetPPS();
+            }
+            continue;
+        }
+        if (packetType != PACKET_CODED_FRAMES && packetType != PACKET_CODED_FRAMES_X) {
+            continue;
+        }
+
+        uint32_t pts = tag.timestamp;
+        if (packetType == PACKET_CODED_FRAMES) {
+            if (length < 3) {
+                continue;
+            }
+            int32_t cts = p[0] << 16 | p[1] << 8 | p[2];
+            cts = (cts << 8) >> 8; // SI24
+            pts += cts;
+            p += 3;
+            length -= 3;
+        }
+
+        nalus.clear();
+        bool idr = false;
+        bool inlineParameterSets = false;
+        ForEachNALU(avc.GetNALULengthSize(), p, length, [&](const uint8_t *nalu, size_t naluSize) {
+            idr |= AVCTraits::IsIRAP(nalu);
+            inlineParameterSets |= (nalu[0] & 0x1f) == 7;
+            nalus.emplace_back(nalu, naluSize);
+            return true;
+        });
+        if (idr && !inlineParameterSets) {
+            nalus.insert(nalus.begin(), parameterSets_.begin(), parameterSets_.end());
+        }
+        if (!nalus.empty()) {
+            PacketizeAccessUnit(tag.timestamp, pts * (VIDEO_CLOCK_RATE / 1000), nalus);
+        }
+    }
+}
+
+void RtpPacketizer::PacketizeAccessUnit(uint32_t sendTime, uint32_t timestamp, const std::vector<ByteSpan> &nalus) {
+    const size_t maxPayload = options_.maxPacketSize - RTP_HEADER_SIZE;
+    size_t i = 0;
+    while (i < nalus.size()) {
+        const ByteSpan &nalu = nalus[i];
+        if (nalu.size > maxPayload) {
+            // FU-A: the NALU header turns into the FU indicator and header, the rest is cut in pieces
+            uint8_t indicator = (nalu.data[0] & 0xe0) | NALU_TYPE_FU_A;
+            const uint8_t *p = nalu.data + 1;
+            size_t remaining = nalu.size - 1;
+            bool start = true;
+            while (remaining > 0) {
+                size_t chunk = std::min(remaining, maxPayload - 2);
+                bool end = chunk == remaining;
+                uint8_t header[2] = {indicator, uint8_t((nalu.data[0] & 0x1f) | (start ? 0x80 : 0) | (end ? 0x40 : 0))};
+                uint32_t firstPiece = (uint32_t)pieces_.size();
+                pieces_.push_back(Keep(header, sizeof(header)));
+                pieces_.emplace_back(p, chunk);
+                AddPacket(sendTime, timestamp, true, end && i + 1 == nalus.size(), firstPiece);
+                p += chunk;
+                remaining -= chunk;
+                start = false;
+            }
+            i++;
+            continue;
+        }
+
+        size_t total = 1; // STAP-A NALU header
+        size_t j = i;
+        while (j < nalus.size() && j - i < MAX_AGGREGATION && total + 2 + nalus[j].size <= maxPayload) {
+            total += 2 + nalus[j].size;
+            j++;
+        }
+        uint32_t firstPiece = (uint32_t)pieces_.size();
+        if (j - i < 2) {
+            pieces_.push_back(nalu);
+            AddPacket(sendTime, timestamp, true, i + 1 == nalus.size(), firstPiece);
+            i++;
+            continue;
+        }
+
+        // STAP-A: F and the highest NRI of the aggregated NALUs, each NALU behind its 16 bits size
+        uint8_t forbidden = 0;
+        uint8_t nri = 0;
+        for (size_t k = i; k < j; ++k) {
+            forbidden |= nalus[k].data[0] & 0x80;
+            nri = std::max<uint8_t>(nri, nalus[k].data[0] & 0x60);
+        }
+        uint8_t header = forbidden | nri | NALU_TYPE_STAP_A;
+        uint8_t first[3] = {header, uint8_t(nalus[i].size >> 8), uint8_t(nalus[i].size)};
+        pieces_.push_back(Keep(first, sizeof(first)));
+        pieces_.push_back(nalus[i]);
+        for (size_t k = i + 1; k < j; ++k) {
+            uint8_t naluSize[2] = {uint8_t(nalus[k].size >> 8), uint8_t(nalus[k].size)};
+            pieces_.push_back(Keep(naluSize, sizeof(naluSize)));
+            pieces_.push_back(nalus[k]);
+        }
+        AddPacket(sendTime, timestamp, true, j == nalus.size(), firstPiece);
+        i = j;
+    }
+    hasVideo_ = true;
+}
+
+void RtpPacketizer::PacketizeAAC(uint32_t sendTime, uint32_t timestamp, const uint8_t *data, size_t size) {
+    if (size == 0 || size > MAX_AU_SIZE) {
+        return;
+    }
+    // AU-headers-length in bits, then one AU header: 13 bits size, 3 bits index. Fragments of an AU all carry
+    // the header with the size of the whole AU.
+    uint8_t auHeader[4] = {0x00, 0x10, uint8_t(size >> 5), uint8_t(size << 3)};
+    ByteSpan header = Keep(auHeader, sizeof(auHeader));
+    const size_t maxChunk = options_.maxPacketSize - RTP_HEADER_SIZE - sizeof(auHeader);
+    while (size > 0) {
+        size_t chunk = std::min(size, maxChunk);
+        uint32_t firstPiece = (uint32_t)pieces_.size();
+        pieces_.push_back(header);
+        pieces_.emplace_back(data, chunk);
+        AddPacket(sendTime, timestamp, false, chunk == size, firstPiece);
+        data += chunk;
+        size -= chunk;
+    }
+    hasAudio_ = true;
+}
+
+ByteSpan RtpPacketizer::Keep(const uint8_t *data, size_t size) {
+    auto copy = (uint8_t *)arena_.allocate(size, 1);
+    memcpy(copy, data, size);
+    return {copy, size};
+}
+
+void RtpPacketizer::AddPacket(uint32_t sendTime, uint32_t timestamp, bool video, bool marker, uint32_t firstPiece) {
+    Packet packet;
+    packet.sendTime = sendTime;
+    packet.timestamp = timestamp;
+    packet.video = video;
+    packet.marker = marker;
+    packet.pieceCount = (uint16_t)(pieces_.size() - firstPiece);
+    packet.firstPiece = firstPiece;
+    packet.size = 0;
+    for (size_t i = firstPiece; i < pieces_.size(); ++i) {
+        packet.size += (uint32_t)pieces_[i].size;
+    }
+    packets_.push_back(packet);
+}
+
+std::string RtpPacketizer::GetSDP(const std::string &host, uint16_t videoPort, uint16_t audioPort) const {
+    std::string sdp = "v=0\r\no=- 0 0 IN IP4 " + host + "\r\ns=flv-media\r\nc=IN IP4 " + host + "\r\nt=0 0\r\n";
+    if (hasVideo_) {
+        std::string pt = std::to_string(options_.videoPayloadType);
+        sdp += "m=video " + std::to_string(videoPort) + " RTP/AVP " + pt + "\r\n";
+        sdp += "a=rtpmap:" + pt + " H264/90000\r\n";
+        sdp += "a=fmtp:" + pt + " packetization-mode=1";
+        if (sps_.size() >= 4) {
+            sdp += ";profile-level-id=" + Hex((const uint8_t *)sps_.data() + 1, 3);
+            sdp += ";sprop-parameter-sets=" + Base64(sps_) + "," + Base64(pps_);
+        }
+        sdp += "\r\n";
+    }
+    if (hasAudio_) {
+        std::string pt = std::to_string(options_.audioPayloadType);
+        sdp += "m=audio " + std::to_string(audioPort) + " RTP/AVP " + pt + "\r\n";
+        sdp += "a=rtpmap:" + pt + " MPEG4-GENERIC/" + std::to_string(audioClockRate_) + "/" +
+               std::to_string(audioChannels_) + "\r\n";
+        sdp += "a=fmtp:" + pt + " streamtype=5;profile-level-id=1;mode=AAC-hbr;sizelength=13;indexlength=3;"
+               "indexdeltalength=3;config=" + Hex((const uint8_t *)audioConfig_.data(), audioConfig_.size()) + "\r\n";
+    }
+    return sdp;
+}
@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_RTP_PACKETIZER_H
+#define FLV_MEDIA_RTP_PACKETIZER_H
+
+#include "Span.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+static const size_t RTP_HEADER_SIZE = 12;
+
+/// The RTP packets of an FLV file, H.264 video and AAC audio, planned once and sent by any number of streams.
+///
+/// H.264 is packetized in non-interleaved mode (RFC 6184): a NALU that fits goes alone, consecutive small
+/// ones are aggregated into STAP-A, bigger ones are split into FU-A fragments. SPS and PPS go in front of
+/// every IDR. AAC goes as AAC-hbr (RFC 3640), one access unit per packet behind its AU header, fragmented
+/// when it does not fit.
+///
+/// A packet is its payload headers (STAP-A sizes, FU indicator and header, AU header) followed by pieces of
+/// the tag bodies, nothing is copied out of the file. What differs between streams, the 12 bytes fixed header
+/// with sequence number, timestamp and SSRC, is left to the sender. The file data has to outlive the plan.
+class RtpPacketizer {
+public:
+    /// NALUs aggregated into one STAP-A at most
+    static const int MAX_AGGREGATION = 8;
+    /// Pieces of one packet at most: a size and a NALU per aggregated NALU
+    static const int MAX_PIECES = 2 * MAX_AGGREGATION;
+
+    static const uint32_t VIDEO_CLOCK_RATE = 90000;
+
+    struct Options {
+        size_t maxPacketSize = 1200; // RTP header included, leaves room for tunnels under a 1500 bytes MTU
+        uint8_t videoPayloadType = 96;
+        uint8_t audioPayloadType = 97;
+    };
+
+    struct Packet {
+        uint32_t sendTime;  // milliseconds, the timestamp of the tag it came from
+        uint32_t timestamp; // RTP timestamp in the clock rate of its stream
+        bool video;
+        bool marker; // last packet of an access unit
+        uint16_t pieceCount;
+        uint32_t firstPiece; // in GetPieces()
+        uint32_t size;       // payload bytes, without the fixed header
+    };
+
+    /// Walks the tags of a whole file. Video other than H.264 and audio other than AAC is skipped.
+    RtpPacketizer(const uint8_t *data, size_t size, const Options &options);
+    RtpPacketizer(const RtpPacketizer &) = delete;
+    RtpPacketizer &operator=(const RtpPacketizer &) = delete;
+
+    const Options &GetOptions() const { return options_; }
+    /// In tag order
+    const std::vector<Packet> &GetPackets() const { return packets_; }
+    const std::vector<ByteSpan> &GetPieces() const { return pieces_; }
+    uint32_t GetAudioClockRate() const { return audioClockRate_; }
+    uint32_t GetDuration() const { return duration_; }
+    bool HasVideo() const { return hasVideo_; }
+    bool HasAudio() const { return hasAudio_; }
+
+    /// Session description for one stream sending video to `videoPort` and audio to `audioPort` of `host`
+    std::string GetSDP(const std::string &host, uint16_t videoPort, uint16_t audioPort) const;
+
+private:
+    void PacketizeAccessUnit(uint32_t sendTime, uint32_t timestamp, const std::vector<ByteSpan> &nalus);
+    void PacketizeAAC(uint32_t sendTime, uint32_t timestamp, const uint8_t *data, size_t size);
+    /// Copies `size` bytes into the arena, the piece stays valid as long as the packetizer
+    ByteSpan Keep(const uint8_t *data, size_t size);
+    void AddPacket(uint32_t sendTime, uint32_t timestamp, bool video, bool marker, uint32_t firstPiece);
+
+private:
+    Options options_;
+    std::vector<Packet> packets_;
+    std::vector<ByteSpan> pieces_;
+    std::pmr::monotonic_buffer_resource arena_; // payload headers and parameter sets
+    uint32_t audioClockRate_ = 0;
+    int audioChannels_ = 0;
+    uint32_t duration_ = 0;
+    bool hasVideo_ = false;
+    bool hasAudio_ = false;
+
+    std::vector<ByteSpan> parameterSets_; // of the current configuration, in the arena
+    std::string sps_;                     // the first ones, for the session description
+    std::string pps_;
+    std::string audioConfig_;
+};
+
+#endif // FLV_MEDIA_RTP_PACKETIZER_H
@@ -0,0 +1,239 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "RtpSender.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <netinet/in.h>
+#include <queue>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/// Pause between two plays of a looped file, about a frame, milliseconds
+const uint32_t LOOP_GAP = 40;
+
+uint64_t Now() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void SleepUntil(uint64_t due) {
+    timespec ts{};
+    ts.tv_sec = (time_t)(due / 1000000000);
+    ts.tv_nsec = (long)(due % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+struct Stream {
+    uint64_t start = 0;  // nanoseconds, when the current play began
+    size_t next = 0;     // packet index in the plan
+    uint32_t loopMs = 0; // media time of the plays before the current one
+    uint16_t sequence[2] = {};
+    sockaddr_in address[2] = {};
+    uint8_t header[2][RTP_HEADER_SIZE] = {}; // V=2, payload type and SSRC, [0] video and [1] audio
+};
+
+/// Messages waiting for one sendmmsg(); the iovecs of a slot point at its own header and at pieces of the plan
+class Ring {
+public:
+    Ring(int fd, size_t size) : fd_(fd), slots_(size), messages_(size) {
+        for (size_t i = 0; i < size; ++i) {
+            slots_[i].iov[0].iov_base = slots_[i].header;
+            slots_[i].iov[0].iov_len = RTP_HEADER_SIZE;
+            messages_[i].msg_hdr.msg_iov = slots_[i].iov;
+            messages_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+    }
+
+    void Push(Stream &stream, const RtpPacketizer &packetizer, const RtpPacketizer::Packet &packet,
+              uint32_t timestamp, RtpSender::Stats &stats) {
+        if (count_ == slots_.size()) {
+            Flush(stats);
+        }
+        int index = packet.video ? 0 : 1;
+        uint16_t sequence = stream.sequence[index]++;
+        Slot &slot = slots_[count_];
+        memcpy(slot.header, stream.header[index], RTP_HEADER_SIZE);
+        slot.header[1] |= packet.marker ? 0x80 : 0;
+        slot.header[2] = (uint8_t)(sequence >> 8);
+        slot.header[3] = (uint8_t)sequence;
+        slot.header[4] = (uint8_t)(timestamp >> 24);
+        slot.header[5] = (uint8_t)(timestamp >> 16);
+        slot.header[6] = (uint8_t)(timestamp >> 8);
+        slot.header[7] = (uint8_t)timestamp;
+        const ByteSpan *pieces = packetizer.GetPieces().data() + packet.firstPiece;
+        for (uint16_t i = 0; i < packet.pieceCount; ++i) {
+            slot.iov[1 + i].iov_base = (void *)pieces[i].data;
+            slot.iov[1 + i].iov_len = pieces[i].size;
+        }
+        msghdr &message = messages_[count_].msg_hdr;
+        message.msg_name = &stream.address[index];
+        message.msg_iovlen = 1 + packet.pieceCount;
+        count_++;
+    }
+
+    /// A message the socket refuses is counted as an error and skipped, the rest still go out
+    void Flush(RtpSender::Stats &stats) {
+        size_t sent = 0;
+        while (sent < count_) {
+            int n = sendmmsg(fd_, messages_.data() + sent, (unsigned int)(count_ - sent), 0);
+            stats.calls++;
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                stats.errors++;
+                sent++;
+                continue;
+            }
+            for (int i = 0; i < n; ++i) {
+                stats.bytes += messages_[sent + i].msg_len;
+            }
+            stats.packets += n;
+            sent += n;
+        }
+        count_ = 0;
+    }
+
+private:
+    struct Slot {
+        uint8_t header[RTP_HEADER_SIZE];
+        iovec iov[1 + RtpPacketizer::MAX_PIECES];
+    };
+
+    int fd_;
+    std::vector<Slot> slots_;
+    std::vector<mmsghdr> messages_;
+    size_t count_ = 0;
+};
+
+void BuildHeader(uint8_t *header, uint8_t payloadType, uint32_t ssrc) {
+    memset(header, 0, RTP_HEADER_SIZE);
+    header[0] = 0x80; // version 2, no padding, no extension, no CSRC
+    header[1] = payloadType & 0x7f;
+    header[8] = (uint8_t)(ssrc >> 24);
+    header[9] = (uint8_t)(ssrc >> 16);
+    header[10] = (uint8_t)(ssrc >> 8);
+    header[11] = (uint8_t)ssrc;
+}
+
+} // namespace
+
+bool RtpSender::Run(const RtpPacketizer &packetizer, const Options &options, Stats &stats) {
+    const auto &packets = packetizer.GetPackets();
+    if (packets.empty() || options.streams <= 0) {
+        printf("RTP: nothing to send\n");
+        return false;
+    }
+
+    in_addr host{};
+    if (inet_pton(AF_INET, options.host.c_str(), &host) != 1) {
+        printf("RTP: bad IPv4 address %s\n", options.host.c_str());
+        return false;
+    }
+    if (options.port + 4 * (options.streams - 1) + 2 > 65535) {
+        printf("RTP: not enough ports above %u for %d streams\n", options.port, options.streams);
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+    // key frames of many streams can land in the same millisecond
+    int bufferSize = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+    const RtpPacketizer::Options &packetizerOptions = packetizer.GetOptions();
+    const uint32_t firstTime = packets.front().sendTime;
+    const uint32_t loopLength = packetizer.GetDuration() + LOOP_GAP;
+    const uint64_t begin = Now();
+    const uint64_t end = options.seconds > 0 ? begin + (uint64_t)(options.seconds * 1e9) : UINT64_MAX;
+
+    std::vector<Stream> streams(options.streams);
+    for (int i = 0; i < options.streams; ++i) {
+        Stream &stream = streams[i];
+        stream.start = begin + (uint64_t)options.spread * 1000000 * i / options.streams;
+        for (int k = 0; k < 2; ++k) {
+            stream.address[k].sin_family = AF_INET;
+            stream.address[k].sin_addr = host;
+            stream.address[k].sin_port = htons((uint16_t)(options.port + 4 * i + 2 * k));
+            // distinct per stream and kind, and the same from run to run so captures can be compared
+            uint32_t ssrc = (uint32_t)(2 * i + k + 1) * 2654435761u;
+            BuildHeader(stream.header[k], k == 0 ? packetizerOptions.videoPayloadType
+                                                 : packetizerOptions.audioPayloadType, ssrc);
+            stream.sequence[k] = (uint16_t)ssrc;
+        }
+    }
+
+    auto dueTime = [&](const Stream &stream) {
+        uint32_t sendTime = packets[stream.next].sendTime;
+        return stream.start + (uint64_t)(sendTime > firstTime ? sendTime - firstTime : 0) * 1000000;
+    };
+    using Entry = std::pair<uint64_t, int>; // due time, stream
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (int i = 0; i < options.streams; ++i) {
+        queue.emplace(dueTime(streams[i]), i);
+    }
+
+    Ring ring(fd, (size_t)std::max(1, options.batch));
+    double totalLate = 0;
+    uint64_t wakeups = 0;
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        if (entry.first >= end) {
+            break;
+        }
+        uint64_t now = Now();
+        if (entry.first > now) {
+            ring.Flush(stats);
+            SleepUntil(entry.first);
+            now = Now();
+        }
+        queue.pop();
+        double late = (double)(now - entry.first) / 1e6;
+        stats.maxLate = std::max(stats.maxLate, late);
+        totalLate += late;
+        wakeups++;
+
+        // everything of this stream that is due by now, a tag's packets or more when the sender fell behind
+        Stream &stream = streams[entry.second];
+        uint64_t due = entry.first;
+        bool done = false;
+        while (due <= now) {
+            const RtpPacketizer::Packet &packet = packets[stream.next];
+            uint32_t clockRate = packet.video ? RtpPacketizer::VIDEO_CLOCK_RATE : packetizer.GetAudioClockRate();
+            uint32_t timestamp = packet.timestamp + (uint32_t)((uint64_t)stream.loopMs * clockRate / 1000);
+            ring.Push(stream, packetizer, packet, timestamp, stats);
+            if (++stream.next == packets.size()) {
+                if (options.seconds <= 0) {
+                    done = true;
+                    break;
+                }
+                stream.next = 0;
+                stream.loopMs += loopLength;
+                stream.start += (uint64_t)loopLength * 1000000;
+            }
+            due = dueTime(stream);
+        }
+        if (!done) {
+            queue.emplace(due, entry.second);
+        }
+    }
+    ring.Flush(stats);
+    stats.seconds = (double)(Now() - begin) / 1e9;
+    stats.meanLate = wakeups ? totalLate / wakeups : 0;
+    close(fd);
+    return true;
+}
@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_RTP_SENDER_H
+#define FLV_MEDIA_RTP_SENDER_H
+
+#include "RtpPacketizer.h"
+#include <cstdint>
+#include <string>
+
+/// Plays the packets of an RtpPacketizer as any number of simultaneous RTP streams over UDP, in real time.
+///
+/// Everything runs on the calling thread. Each stream sends its packets when their tag timestamp is due, the
+/// streams wait in a heap ordered by their next due time and the thread sleeps in clock_nanosleep() until the
+/// first one. Packets due together, of one stream or many, are queued into a ring of prebuilt messages: the
+/// iovecs of a slot point at its fixed header and at the payload pieces of the plan, so a packet costs a 12
+/// bytes header copy and no payload copy. The ring goes out with one sendmmsg() when it is full or before
+/// sleeping. Stream i sends video to `port + 4 * i` and audio to `port + 4 * i + 2`, RTCP ports left free.
+class RtpSender {
+public:
+    struct Options {
+        std::string host = "127.0.0.1";
+        uint16_t port = 5004;
+        int streams = 1;
+        int batch = 64;      // messages per sendmmsg() at most
+        double seconds = 0;  // play for this long, looping the file; 0 plays it once
+        int spread = 1000;   // milliseconds over which the stream starts are spread, so key frames do not line up
+    };
+
+    struct Stats {
+        uint64_t packets = 0;
+        uint64_t bytes = 0; // RTP headers included
+        uint64_t calls = 0; // sendmmsg() calls
+        uint64_t errors = 0; // packets that could not be sent
+        double seconds = 0;
+        double maxLate = 0;  // milliseconds a stream was woken after its packets were due
+        double meanLate = 0;
+    };
+
+    /// False when the socket can not be set up
+    static bool Run(const RtpPacketizer &packetizer, const Options &options, Stats &stats);
+};
+
+#endif // FLV_MEDIA_RTP_SENDER_H
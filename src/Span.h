@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_SPAN_H
+#define FLV_MEDIA_SPAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Non-owning view of bytes, the tree is C++17 so there is no std::span
+struct ByteSpan {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    ByteSpan() = default;
+    ByteSpan(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    const uint8_t *begin() const { return data; }
+    const uint8_t *end() const { return data + size; }
+    bool empty() const { return size == 0; }
+
+    /// FNV-1a, good enough to tell configuration records apart
+    uint64_t Hash() const {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ data[i]) * 0x100000001b3ULL;
+        }
+        return hash;
+    }
+};
+
+#endif // FLV_MEDIA_SPAN_H
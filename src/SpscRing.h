@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_SPSC_RING_H
+#define FLV_MEDIA_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+/// Spins first, then yields, then sleeps, for threads waiting on a ring
+class Backoff {
+public:
+    void Wait() {
+        if (count_ < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else if (count_ < 128) {
+            std::this_thread::yield();
+        } else {
+            timespec ts = {0, 50 * 1000};
+            nanosleep(&ts, nullptr);
+        }
+        count_++;
+    }
+
+    void Reset() { count_ = 0; }
+
+private:
+    uint32_t count_ = 0;
+};
+
+/// Bounded lock-free ring for exactly one producer and one consumer thread.
+///
+/// Items move in batches: a Push() or Pop() of n items publishes its index once. Each side caches the other
+/// side's index and only reloads it when the cached one says the ring is full or empty, so the two threads
+/// share a cache line only when they really have to.
+template <typename T>
+class SpscRing {
+public:
+    /// Capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        slots_.resize(n);
+        mask_ = n - 1;
+    }
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    /// Producer side, moves up to `count` items in and returns how many fit
+    size_t Push(T *items, size_t count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (slots_.size() - (tail - headCache_) < count) {
+            headCache_ = head_.load(std::memory_order_acquire);
+        }
+        size_t n = std::min(count, slots_.size() - (tail - headCache_));
+        for (size_t i = 0; i < n; ++i) {
+            slots_[(tail + i) & mask_] = std::move(items[i]);
+        }
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Producer side, waits for room until all `count` items are in. Returns how many times it had to wait.
+    size_t PushAll(T *items, size_t count) {
+        Backoff backoff;
+        size_t stalls = 0;
+        while (count > 0) {
+            size_t n = Push(items, count);
+            items += n;
+            count -= n;
+            if (count > 0) {
+                backoff.Wait();
+                stalls++;
+            }
+        }
+        return stalls;
+    }
+
+    /// Consumer side, moves up to `count` items out and returns how many there were
+    size_t Pop(T *items, size_t count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (tailCache_ - head < count) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+        }
+        size_t n = std::min(count, tailCache_ - head);
+        for (size_t i = 0; i < n; ++i) {
+            items[i] = std::move(slots_[(head + i) & mask_]);
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /// Consumer side, waits for at least one item. Returns 0 only once the ring is closed and drained.
+    size_t PopWait(T *items, size_t count, size_t *stalls = nullptr) {
+        Backoff backoff;
+        while (true) {
+            size_t n = Pop(items, count);
+            if (n > 0) {
+                return n;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                // items pushed before Close() are visible now
+                return Pop(items, count);
+            }
+            backoff.Wait();
+            if (stalls) {
+                (*stalls)++;
+            }
+        }
+    }
+
+    /// Producer side, nothing is pushed after this
+    void Close() { closed_.store(true, std::memory_order_release); }
+
+    size_t GetCapacity() const { return slots_.size(); }
+    /// A snapshot from either side, the other one may have moved on already
+    size_t GetSize() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    std::atomic<bool> closed_{false};
+
+    alignas(CACHE_LINE) std::atomic<size_t> head_{0}; // written by the consumer
+    size_t tailCache_ = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{0}; // written by the producer
+    size_t headCache_ = 0;
+};
+
+#endif // FLV_MEDIA_SPSC_RING_H
@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_TAG_RANGE_H
+#define FLV_MEDIA_TAG_RANGE_H
+
+#include "FLV.h"
+#include "File.h"
+#include "Span.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+/// One tag of FLV data in memory, pointing into that memory
+struct TagView {
+    TagType type;
+    uint32_t timestamp;
+    uint64_t offset; // of the tag header, from the start of the data
+    ByteSpan payload;
+
+    const FlvTagHeader *GetHeader() const { return (const FlvTagHeader *)(payload.data - sizeof(FlvTagHeader)); }
+};
+
+/// Forward iterator over the tags of FLV data in memory.
+///
+/// Only the bounds are checked: a tag whose header, body or PreviousTagSize would reach past the end of the
+/// data ends the iteration, like the end of the data does. The end iterator is a null position, so comparing
+/// against it is one pointer compare. Nothing is allocated.
+class TagIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = TagView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const TagView *;
+    using reference = const TagView &;
+
+    TagIterator() = default;
+    TagIterator(const uint8_t *base, const uint8_t *position, const uint8_t *end) : base_(base), end_(end) {
+        Load(position);
+    }
+
+    reference operator*() const { return view_; }
+    pointer operator->() const { return &view_; }
+
+    TagIterator &operator++() {
+        Load(view_.payload.end() + PREVIOUS_TAG_SIZE_LENGTH);
+        return *this;
+    }
+    TagIterator operator++(int) {
+        TagIterator it = *this;
+        ++*this;
+        return it;
+    }
+
+    bool operator==(const TagIterator &other) const { return position_ == other.position_; }
+    bool operator!=(const TagIterator &other) const { return position_ != other.position_; }
+
+private:
+    static const int PREVIOUS_TAG_SIZE_LENGTH = 4;
+
+    void Load(const uint8_t *p) {
+        if ((size_t)(end_ - p) < sizeof(FlvTagHeader) + PREVIOUS_TAG_SIZE_LENGTH) {
+            position_ = nullptr;
+            return;
+        }
+        auto tag = (const FlvTagHeader *)p;
+        size_t length = tag->GetDataSize();
+        if ((size_t)(end_ - p) - sizeof(FlvTagHeader) - PREVIOUS_TAG_SIZE_LENGTH < length) {
+            position_ = nullptr;
+            return;
+        }
+        position_ = p;
+        view_.type = tag->type;
+        view_.timestamp = tag->GetTimestamp();
+        view_.offset = p - base_;
+        view_.payload = ByteSpan(tag->data, length);
+    }
+
+private:
+    const uint8_t *base_ = nullptr;
+    const uint8_t *end_ = nullptr;
+    const uint8_t *position_ = nullptr; // current tag header, nullptr at the end
+    TagView view_{};
+};
+
+/// The tags of FLV data in memory, for range-for and the standard algorithms.
+///
+/// ```
+/// for (const TagView &tag : TagRange(reader->data, reader->size)) {
+///     ...
+/// }
+/// ```
+class TagRange {
+public:
+    /// `data` starts with the FLV header, the tags start where the header says
+    TagRange(const uint8_t *data, size_t size) : data_(data), end_(data + size) {
+        first_ = end_;
+        if (size >= sizeof(FLVHeader) + 4 && data[0] == 'F' && data[1] == 'L' && data[2] == 'V') {
+            auto offset = ((const FLVHeader *)data)->offset;
+            size_t dataOffset = (uint32_t)offset[0] << 24 | offset[1] << 16 | offset[2] << 8 | offset[3];
+            if (dataOffset + 4 <= size) {
+                first_ = data + dataOffset + 4;
+            }
+        }
+    }
+    explicit TagRange(ByteSpan file) : TagRange(file.data, file.size) {}
+    explicit TagRange(const FileReader &reader) : TagRange(reader.data, reader.size) {}
+
+    /// Tags only, without the FLV header in front, e.g. the rest of a stream after some known offset
+    static TagRange FromTags(const uint8_t *tags, size_t size) { return TagRange(tags, tags, tags + size); }
+
+    TagIterator begin() const { return TagIterator(data_, first_, end_); }
+    TagIterator end() const { return TagIterator(); }
+
+private:
+    TagRange(const uint8_t *data, const uint8_t *first, const uint8_t *end) : data_(data), first_(first), end_(end) {}
+
+private:
+    const uint8_t *data_;
+    const uint8_t *first_;
+    const uint8_t *end_;
+};
+
+#endif // FLV_MEDIA_TAG_RANGE_H
@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_TIMER_WHEEL_H
+#define FLV_MEDIA_TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Hashed timing wheel for many timers of one thread.
+///
+/// Time is cut in ticks, a timer goes into the slot of its tick modulo the wheel size, so scheduling is an
+/// append and expiring a tick only looks at one slot, whatever the number of timers. Timers more than a turn
+/// ahead share the slot with nearer ones and stay there until their turn comes. A timer fires at the first
+/// tick boundary at or after its due time, never early.
+class TimerWheel {
+public:
+    /// `start` and `tick` in nanoseconds, `slots` is best a power of two covering the usual delays
+    TimerWheel(uint64_t start, uint64_t tick, size_t slots) : tick_(tick), current_(start / tick), slots_(slots) {}
+
+    /// A due time already past fires with the next tick
+    void Schedule(uint32_t id, uint64_t due) {
+        uint64_t tick = (due + tick_ - 1) / tick_;
+        if (tick < current_) {
+            tick = current_;
+        }
+        slots_[tick % slots_.size()].push_back({tick, id});
+        size_++;
+    }
+
+    /// Fires every timer of the ticks up to `now`, in tick order. `onExpired(id)` may schedule again, a timer
+    /// due in a tick already gone through goes into the next one.
+    template <typename Callback>
+    void Advance(uint64_t now, Callback &&onExpired) {
+        uint64_t last = now / tick_;
+        while (current_ <= last) {
+            uint64_t tick = current_++;
+            std::vector<Timer> &slot = slots_[tick % slots_.size()];
+            expired_.clear();
+            size_t kept = 0;
+            for (const Timer &timer : slot) {
+                if (timer.tick <= tick) {
+                    expired_.push_back(timer.id);
+                } else {
+                    slot[kept++] = timer;
+                }
+            }
+            slot.resize(kept);
+            size_ -= expired_.size();
+            for (uint32_t id : expired_) {
+                onExpired(id);
+            }
+            if (size_ == 0) {
+                current_ = last + 1;
+                break;
+            }
+        }
+    }
+
+    /// When the next tick starts, nanoseconds
+    uint64_t GetNextTick() const { return current_ * tick_; }
+    size_t GetSize() const { return size_; }
+
+private:
+    struct Timer {
+        uint64_t tick;
+        uint32_t id;
+    };
+
+    uint64_t tick_;
+    uint64_t current_; // the next tick to go through
+    size_t size_ = 0;
+    std::vector<std::vector<Timer>> slots_;
+    std::vector<uint32_t> expired_;
+};
+
+#endif // FLV_MEDIA_TIMER_WHEEL_H
@@ -0,0 +1,43 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#include "VP9Configuration.h"
+#include "Log.h"
+
+/*
+ * vpcC
+ * bits
+ * 8   version ( 1 )
+ * 24  flags ( 0 )
+ * 8   profile
+ * 8   level
+ * 4   bitDepth
+ * 3   chromaSubsampling
+ * 1   videoFullRangeFlag
+ * 8   colourPrimaries
+ * 8   transferCharacteristics
+ * 8   matrixCoefficients
+ * 16  codecIntializationDataSize ( always 0 for VP9 )
+ */
+
+VP9Configuration::VP9Configuration(const uint8_t *packet, size_t size) {
+    SetConfigurationPacket(packet, size);
+}
+
+bool VP9Configuration::SetConfigurationPacket(const uint8_t *pack, size_t size) {
+    if (size < 12) {
+        Log("Invalid VP9 configuration record");
+        return false;
+    }
+
+    profile_ = pack[4];
+    level_ = pack[5];
+    bitDepth_ = pack[6] >> 4;
+    uint64_t hash = ByteSpan(pack, size).Hash();
+    if (generation_ == 0 || hash != packetHash_) {
+        packetHash_ = hash;
+        generation_++;
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
+//
+
+#ifndef FLV_MEDIA_VP9_CONFIGURATION_H
+#define FLV_MEDIA_VP9_CONFIGURATION_H
+
+#include "Span.h"
+#include <cstddef>
+#include <cstdint>
+
+/// [VPCodecConfigurationRecord](https://www.webmproject.org/vp9/mp4/#vp-codec-configuration-box),
+/// carried with the 4 bytes version and flags of the vpcC box in front
+class VP9Configuration {
+public:
+    VP9Configuration() = default;
+    VP9Configuration(const uint8_t *packet, size_t size);
+
+    bool SetConfigurationPacket(const uint8_t *pack, size_t size);
+
+    int GetProfile() const { return profile_; }
+    int GetLevel() const { return level_; }
+    int GetBitDepth() const { return bitDepth_; }
+    /// Bumped whenever the record changes
+    uint32_t GetGeneration() const { return generation_; }
+
+private:
+    int profile_ = 0;
+    int level_ = 0;
+    int bitDepth_ = 8;
+    uint64_t packetHash_ = 0;
+    uint32_t generation_ = 0;
+};
+
+#endif // FLV_MEDIA_VP9_CONFIGURATION_H
@@ -5,6 +5,7 @@
 #ifndef FLV_MEDIA_VIDEO_TAG_H
 #define FLV_MEDIA_VIDEO_TAG_H
 
+#include <cstddef>
 #include <cstdint>
 
 enum VideoFrameType : uint8_t {
@@ -25,6 +26,25 @@ enum VideoCodec : uint8_t {
     CODEC_AVC              // H.264/AVC
 };
 
+/// Enhanced RTMP: IsExHeader set in the first bit, the codec is a FourCC instead of VideoCodec
+enum VideoPacketType : uint8_t {
+    PACKET_SEQUENCE_START = 0,        // codec configuration record
+    PACKET_CODED_FRAMES,              // frames with a 3 bytes composition time offset
+    PACKET_SEQUENCE_END,              // end of sequence
+    PACKET_CODED_FRAMES_X,            // frames without composition time offset, it is 0
+    PACKET_METADATA,                  // AMF encoded video metadata
+    PACKET_MPEG2TS_SEQUENCE_START = 5 // MPEG-2 TS descriptors instead of a configuration record
+};
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+
+enum VideoFourCC : uint32_t {
+    FOURCC_AVC = FOURCC('a', 'v', 'c', '1'),
+    FOURCC_HEVC = FOURCC('h', 'v', 'c', '1'),
+    FOURCC_AV1 = FOURCC('a', 'v', '0', '1'),
+    FOURCC_VP9 = FOURCC('v', 'p', '0', '9'),
+};
+
 enum AVCPacketType : uint8_t {
     AVC_HEADER = 0, // AVC sequence header, SPS+PPS
     AVC_NALU,       // AVC NALU
@@ -46,6 +66,46 @@ struct AVCVideoTagHeader {
     uint8_t data[0];
 };
 
+struct ExVideoTagHeader {
+    VideoPacketType packetType : 4;
+    VideoFrameType frameType : 3;
+    uint8_t isExHeader : 1; // 1 for enhanced RTMP
+    uint8_t fourCC[4];
+    uint8_t data[0];
+
+    uint32_t GetFourCC() const { return FOURCC(fourCC[0], fourCC[1], fourCC[2], fourCC[3]); }
+};
+
+/// Seekable frame, legacy or enhanced header, sequence headers excluded
+inline bool IsVideoKeyFrame(const uint8_t *data, size_t size) {
+    if (size < 2) {
+        return false;
+    }
+
+    if (data[0] & 0x80) {
+        auto header = (const ExVideoTagHeader *)data;
+        return header->frameType == KEY_FRAME && header->packetType != PACKET_SEQUENCE_START &&
+               header->packetType != PACKET_MPEG2TS_SEQUENCE_START && header->packetType != PACKET_METADATA;
+    }
+
+    auto header = (const AVCVideoTagHeader *)data;
+    return header->frameType == KEY_FRAME && !(header->codec == CODEC_AVC && header->packetType == AVC_HEADER);
+}
+
+/// End of sequence packet, legacy AVC or enhanced header
+inline bool IsVideoEndOfSequence(const uint8_t *data, size_t size) {
+    if (size < 2) {
+        return false;
+    }
+
+    if (data[0] & 0x80) {
+        return ((const ExVideoTagHeader *)data)->packetType == PACKET_SEQUENCE_END;
+    }
+
+    auto header = (const AVCVideoTagHeader *)data;
+    return header->codec == CODEC_AVC && header->packetType == AVC_END;
+}
+
 struct AVCDecoderConfigurationRecord {
     uint8_t version = 1;
     uint8_t profileIndication;      // SPS[1]
@@ -2,35 +2,77 @@
 // Copyright (c) 2023 SHAO Liming<lmshao@163.com>. All rights reserved.
 //
 
-#include "ADTSHeader.h"
+#include "AllocationCounter.h"
 #include "AMF.h"
-#include "AVCConfiguration.h"
-#include "AudioSpecificConfig.h"
 #include "AudioTag.h"
+#include "ByteSource.h"
+#include "CodecTraits.h"
+#include "DemuxBenchmark.h"
+#include "DemuxPipeline.h"
 #include "FLV.h"
 #include "File.h"
+#include "FileFollower.h"
+#include "FlvCatalog.h"
+#include "FlvDemuxer.h"
+#include "FlvWriter.h"
+#include "FlvProbe.h"
+#include "FlvSalvager.h"
+#include "FlvTagParser.h"
+#include "FlvValidator.h"
+#include "FrameDropper.h"
+#include "JsonWriter.h"
+#include "LoadGenerator.h"
+#include "Log.h"
+#include "MediaPacket.h"
+#include "MetadataInjector.h"
+#include "PacketFanOut.h"
+#include "Recorder.h"
+#include "ReverseTagReader.h"
+#include "RtpPacketizer.h"
+#include "RtpSender.h"
 #include "VideoTag.h"
-#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <fcntl.h>
 #include <functional>
 #include <getopt.h>
 #include <iostream>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 void ShowUsage(char *exe) {
-    printf("Usage:\n%s -i <file.flv> -m <video.h264,audio.aac> -d <file.flv> -h\n", exe);
+    printf("Usage:\n%s -i <file.flv> -m <video.h264,audio.aac> -d <file.flv> -k <file.flv> -r <file.flv|-> -R <file.flv> -P <file.flv> [cpus] -v <file.flv|-> [files] -s <file.flv> -p <file.flv> -t <file.flv> [files] -b <file.flv> [passes] [baseline.json] -F <file.flv> -f <file.flv> [idle seconds] -c <catalog> [dirs] -q <catalog> [filters] -u <file.flv> [host:port] [streams] [seconds] -L <file.flv,...> [streams] [seconds] [threads] [target] -h\n", exe);
     printf("\t-i info *.flv\n");
     printf("\t-m mux (*.h264,*.aac -> *.flv)\n");
-    printf("\t-d demux (*.flv -> *.h264)\n");
+    printf("\t-d demux (*.flv -> *.h264/*.h265/*.obu/*.ivf, *.aac)\n");
+    printf("\t-k inject keyframes into onMetaData (*.flv -> *.flv)\n");
+    printf("\t-r remux with finalized onMetaData (*.flv -> *.flv), - records a live stream from stdin\n");
+    printf("\t-R recover a crashed recording in place\n");
+    printf("\t-P pipelined demux, optionally pinning the reader,parser,video,audio stages to cpus, e.g. 0,1,2,3\n");
+    printf("\t-v validate the structure of *.flv files, one JSON report per file, - reads file names from stdin\n");
+    printf("\t-s salvage the intact tags of a damaged file (*.flv -> *.flv), skipped ranges are reported as JSON\n");
+    printf("\t-p probe stream statistics from the tag headers only, as JSON\n");
+    printf("\t-t duration and tail of *.flv files from their last few KB, one JSON line per file\n");
+    printf("\t-b benchmark demuxing into memory through inlined and type-erased sinks, with hardware counters;\n"
+           "\t   compares against baseline.json when it exists, else saves it\n");
+    printf("\t-F demux once to several consumers: *.h264/..., *.aac and a key frame every 10 s, stats as JSON\n");
+    printf("\t-f demux a file that is still being recorded as it grows, until it stays idle (10 s) or ends\n");
+    printf("\t-c build or refresh a catalog of the *.flv files under dirs, only new and changed files are probed\n");
+    printf("\t-q query a catalog, filters like videoCodec=H.264 width>=1920 duration<60000 path~/2023/\n");
+    printf("\t-u send H.264 and AAC as RTP over UDP in real time, as many streams, looped for seconds when given;\n"
+           "\t   stream i goes to port + 4 * i (video) and port + 4 * i + 2 (audio), the SDP of stream 0 is written\n");
+    printf("\t-L load test: every file replayed in real time as that many looping publishers per file, each with its\n"
+           "\t   own timestamps, to target host:port (TCP), a unix socket path, or - for pipes drained in-process\n");
     printf("\t-h help\n");
 }
 
 bool ProcessArgs(int argc, char *argv[], char &operation, char *&file) {
-    int ret = getopt(argc, argv, ":i:m:d:h");
+    int ret = getopt(argc, argv, ":i:m:d:k:r:R:P:v:s:p:t:b:F:f:c:q:u:L:h");
     switch (ret) {
         case ('i'):
             operation = 'i';
@@ -44,6 +86,66 @@ bool ProcessArgs(int argc, char *argv[], char &operation, char *&file) {
             operation = 'd';
             file = optarg;
             break;
+        case ('k'):
+            operation = 'k';
+            file = optarg;
+            break;
+        case ('r'):
+            operation = 'r';
+            file = optarg;
+            break;
+        case ('R'):
+            operation = 'R';
+            file = optarg;
+            break;
+        case ('P'):
+            operation = 'P';
+            file = optarg;
+            break;
+        case ('v'):
+            operation = 'v';
+            file = optarg;
+            break;
+        case ('s'):
+            operation = 's';
+            file = optarg;
+            break;
+        case ('p'):
+            operation = 'p';
+            file = optarg;
+            break;
+        case ('t'):
+            operation = 't';
+            file = optarg;
+            break;
+        case ('b'):
+            operation = 'b';
+            file = optarg;
+            break;
+        case ('F'):
+            operation = 'F';
+            file = optarg;
+            break;
+        case ('f'):
+            operation = 'f';
+            file = optarg;
+            break;
+        case ('c'):
+            operation = 'c';
+            file = optarg;
+            break;
+        case ('q'):
+            operation = 'q';
+            file = optarg;
+            break;
+        case ('u'):
+            operation = 'u';
+            file = optarg;
+            break;
+        case ('L'):
+            operation = 'L';
+            file = optarg;
+            break;
         case ':':
             printf("option [-%c] requires an argument\n", (char)optopt);
             break;
@@ -61,167 +163,233 @@ bool ProcessArgs(int argc, char *argv[], char &operation, char *&file) {
     return true;
 }
 
-#define ASSERT_LOG_RETURN(exp, msg)                                                                                    \
-    do {                                                                                                               \
-        if (!(exp)) {                                                                                                  \
-            printf("ERROR: %s\n", msg);                                                                                \
-            exit(1);                                                                                                   \
-        }                                                                                                              \
-    } while (0)
-
-using Callback = std::function<void(const uint8_t *data, size_t size)>;
-
-void ParseFlvFile(const uint8_t *data, size_t size, const Callback &videoCallback, const Callback &audioCallback) {
-    auto p = data;
-    auto end = data + size;
-    AVCConfiguration config;
-    ADTSHeader adtsHeader;
-    int avcCNALULengthSize = 4;
-    int preTagSizeLength = 4;
-
-    assert(size > sizeof(FLVHeader));
-
-    ASSERT_LOG_RETURN(p[0] == 'F' && p[1] == 'L' && p[2] == 'V', "Not a valid .flv file");
-    FLVHeader *header = (FLVHeader *)p;
-    if (header->flagAudio) {
-        printf("has audio\n");
+#ifdef FLV_MEDIA_COUNT_ALLOCATIONS
+/// Tags before this are allowed to allocate, stdio buffers and the like are set up lazily
+static const uint64_t ALLOCATION_WARMUP_TAGS = 16;
+
+/// Sequence headers rebuild the codec configuration and may allocate at any time
+static bool IsSequenceHeader(const FlvTagHeader *tag, size_t length) {
+    if (length < 2) {
+        return false;
     }
-    if (header->flagVideo) {
-        printf("has video\n");
+    if (tag->type == TAG_VIDEO) {
+        if (tag->data[0] & 0x80) {
+            return (tag->data[0] & 0x0f) == PACKET_SEQUENCE_START;
+        }
+        return ((const VideoTagHeader *)tag->data)->codec == CODEC_AVC && tag->data[1] == AVC_HEADER;
     }
-    p += sizeof(FLVHeader); // skip Flv header
-    p += preTagSizeLength;  // skip Previous Tag Size #0
-    printf("%02x %02x %02x %02x\n", p[0], p[10], p[2], p[3]);
-    ASSERT_LOG_RETURN(p[0] == TAG_AUDIO || p[0] == TAG_VIDEO || p[0] == TAG_SCRIPT, "invalid tag");
-
-    while (p + sizeof(FlvTagHeader) < end) {
-        FlvTagHeader *tag = (FlvTagHeader *)p;
-        int length = tag->size[0] << 16 | tag->size[1] << 8 | tag->size[2];
-        printf("Tag length: %d\n", length);
-        p += sizeof(FlvTagHeader);
-
-        if (p + length >= end) {
-            printf("Incomplete .flv file, %p - %p\n", p, end);
-            break;
+    return tag->type == TAG_AUDIO && ((const AudioTagHeader *)tag->data)->codec == CODEC_AAC &&
+           tag->data[1] == AAC_HEADER;
+}
+#endif
+
+/// Demuxes a whole file in memory. Built with FLV_MEDIA_COUNT_ALLOCATIONS, a tag that allocates ends the process.
+bool DemuxFile(FlvDemuxer &demuxer, const uint8_t *data, size_t size) {
+#ifdef FLV_MEDIA_COUNT_ALLOCATIONS
+    uint64_t tagCount = 0;
+    size_t largestScript = 0; // a bigger script tag grows the pool once
+    uint64_t allocations = GetAllocationCount();
+    return demuxer.DemuxFile(data, size, [&](const FlvTagHeader *tag) {
+        size_t length = tag->GetDataSize();
+        bool growing = tag->type == TAG_SCRIPT && length > largestScript;
+        largestScript = growing ? length : largestScript;
+        if (++tagCount > ALLOCATION_WARMUP_TAGS && !growing && !IsSequenceHeader(tag, length) &&
+            GetAllocationCount() != allocations) {
+            printf("ERROR: %lu allocations in tag %lu at %lu\n", (unsigned long)(GetAllocationCount() - allocations),
+                   (unsigned long)tagCount, (unsigned long)((const uint8_t *)tag - data));
+            exit(1);
         }
+        allocations = GetAllocationCount();
+    });
+#else
+    return demuxer.DemuxFile(data, size);
+#endif
+}
 
-        if (tag->type == TAG_SCRIPT) {
-            AMFDecoder decoder(p, length);
-            std::vector<AMFValue> amfValues = decoder.GetValues();
-            for (auto &item : amfValues) {
-                std::cout << item.Dump() << std::endl;
-            }
+/// Drop pressure from how far the recording lags behind real time while stdin has data waiting.
+/// A file piped in runs ahead of the clock and a stalled source leaves nothing waiting, neither sheds frames.
+DropPressure StdinPressure(uint32_t mediaTime, std::chrono::steady_clock::duration wallTime) {
+    int queued = 0;
+    if (ioctl(STDIN_FILENO, FIONREAD, &queued) != 0 || queued == 0) {
+        return PRESSURE_NONE;
+    }
 
-            if (!videoCallback && !audioCallback) {
-                return;
-            }
-        } else if (tag->type == TAG_VIDEO) {
-            if (!videoCallback) {
-                continue;
-            }
+    int64_t lag = std::chrono::duration_cast<std::chrono::milliseconds>(wallTime).count() - (int64_t)mediaTime;
+    if (lag >= 2000) {
+        return PRESSURE_HIGH;
+    }
+    return lag >= 500 ? PRESSURE_LOW : PRESSURE_NONE;
+}
 
-            AVCVideoTagHeader *tagHeader = (AVCVideoTagHeader *)p;
-            assert(tagHeader->codec == CODEC_AVC);
-
-            if (tagHeader->packetType == 0) {
-                printf("video SPS/PPS frame\n");
-                config.SetConfigurationPacket(tagHeader->data, length - sizeof(AVCVideoTagHeader));
-                avcCNALULengthSize = config.GetNALULengthSize();
-            } else if (tagHeader->packetType == 1) {
-                const uint8_t *frameEnd = p + length;
-                const uint8_t *naluStart = tagHeader->data;
-                int naluSize = (naluStart[0] << 24) | (naluStart[1] << 16) | (naluStart[2] << 8) | naluStart[3];
-                static const uint8_t startCode[4] = {0x00, 0x00, 0x00, 0x01};
-
-                naluStart += avcCNALULengthSize; // skip nalu length field
-                if (tagHeader->frameType == 1) {
-                    printf("video key frame\n");
-                    if ((*naluStart & 0x1f) == 0x05) {
-                        std::string pps = config.GetPPS();
-                        std::string sps = config.GetSPS();
-
-                        assert(!pps.empty() && !sps.empty());
-                        videoCallback(startCode, 4);
-                        videoCallback((uint8_t *)sps.data(), sps.size());
-                        videoCallback(startCode, 4);
-                        videoCallback((uint8_t *)pps.data(), pps.size());
-
-                        videoCallback(startCode + 1, 3);
-                    } else {
-                        videoCallback(startCode, 4);
-                    }
-                    videoCallback(naluStart, naluSize);
-                } else if (tagHeader->frameType == 2) {
-                    printf("video common frame\n");
-                    videoCallback(startCode, 4);
-                    videoCallback(naluStart, naluSize);
-                }
+void PrintDropStats(const FrameDropper &dropper) {
+    printf("video frames: %lu key, %lu reference, %lu reference B, %lu disposable, %lu dropped\n",
+           (unsigned long)dropper.GetCount(FRAME_KEY), (unsigned long)dropper.GetCount(FRAME_REFERENCE),
+           (unsigned long)dropper.GetCount(FRAME_REFERENCE_B), (unsigned long)dropper.GetCount(FRAME_DISPOSABLE),
+           (unsigned long)dropper.GetDropped());
+}
 
-                naluStart += naluSize;
-                while (naluStart < frameEnd) {
-                    // has other nalu
-                    assert(naluStart + avcCNALULengthSize < frameEnd);
-                    naluSize = (naluStart[0] << 24) | (naluStart[1] << 16) | (naluStart[2] << 8) | naluStart[3];
-                    naluStart += avcCNALULengthSize;
-                    assert(naluStart + naluSize <= frameEnd);
-                    if ((*naluStart & 0x1f) == 0x05) {
-                        std::string pps = config.GetPPS();
-                        std::string sps = config.GetSPS();
-                        assert(!pps.empty() && !sps.empty());
-
-                        videoCallback(startCode, 4);
-                        videoCallback((uint8_t *)sps.data(), sps.size());
-                        videoCallback(startCode, 4);
-                        videoCallback((uint8_t *)pps.data(), pps.size());
-
-                        videoCallback(startCode + 1, 3);
-                    } else {
-                        videoCallback(startCode, 4);
-                    }
-                    videoCallback(naluStart, naluSize);
-                    naluStart += naluSize;
-                }
-            }
+/// `format` applied to a single double, - for NaN
+std::string FormatNumber(double value, const char *format) {
+    if (std::isnan(value)) {
+        return "-";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), format, value);
+    return buffer;
+}
 
-        } else if (tag->type == TAG_AUDIO) {
-            if (!audioCallback) {
-                continue;
-            }
+void PrintBenchmark(const std::vector<DemuxBenchmark::Result> &results) {
+    printf("%-10s %10s %10s %12s %12s\n", "case", "MB/s", "ns/frame", "frames", "output");
+    for (const auto &result : results) {
+        printf("%-10s %10.1f %10.1f %12lu %12lu\n", result.name.c_str(), result.GetInputRate() / 1e6,
+               result.GetNanosecondsPerFrame(), (unsigned long)result.frames, (unsigned long)result.outputBytes);
+    }
 
-            AACAudioTagHeader *tagHeader = (AACAudioTagHeader *)p;
-            printf("audio codec: %d\n", tagHeader->codec);
-            assert(tagHeader->codec == CODEC_AAC);
-            printf("audio channel: %d, rate: %d, bit: %d, packetType: %d\n", tagHeader->channels, tagHeader->rate,
-                   tagHeader->bits, tagHeader->packetType);
-
-            int dataSize = length - sizeof(AACAudioTagHeader);
-            if (tagHeader->packetType == AAC_HEADER) {
-                AudioSpecificConfig config((char *)tagHeader->data, dataSize);
-                printf("Audio specific config: %d-%d-%d\n", config.GetObjectType(), config.GetSampleRate(),
-                       config.GetChannels());
-                adtsHeader.SetChannel(config.GetChannels()).SetSamplingFrequency(config.GetSampleRate()).SetVBR();
-            } else {
-                adtsHeader.SetLength(dataSize + sizeof(ADTSHeader));
-                audioCallback((uint8_t *)&adtsHeader, sizeof(ADTSHeader)); // aac header
-                audioCallback(tagHeader->data, dataSize);                  // aac es data
-            }
+    // averages over all passes, so they do not match the fastest pass exactly; - for unavailable counters
+    printf("%-10s %12s %12s %8s %12s %12s %12s\n", "case", "cycles/tag", "instr/tag", "IPC", "brmiss/tag",
+           "llcmiss/KB", "faults/MB");
+    for (const auto &result : results) {
+        double ratios[] = {
+            result.PerTag(PerfCounters::CYCLES),
+            result.PerTag(PerfCounters::INSTRUCTIONS),
+            result.PerTag(PerfCounters::INSTRUCTIONS) / result.PerTag(PerfCounters::CYCLES),
+            result.PerTag(PerfCounters::BRANCH_MISSES),
+            result.PerByte(PerfCounters::CACHE_MISSES) * 1024,
+            result.PerByte(PerfCounters::PAGE_FAULTS) * 1024 * 1024,
+        };
+        printf("%-10s", result.name.c_str());
+        for (size_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); ++i) {
+            printf(" %*s", i == 2 ? 8 : 12, FormatNumber(ratios[i], i == 2 ? "%.2f" : "%.3f").c_str());
         }
+        printf("\n");
+    }
+}
 
-        p += length;
-        assert(p + preTagSizeLength <= end);
+/// Relative change of time and counters against a saved run, per case present in both
+void PrintBenchmarkDelta(const std::vector<DemuxBenchmark::Result> &results,
+                         const std::vector<DemuxBenchmark::Result> &baseline) {
+    auto delta = [](double now, double before) { return before > 0 ? (now / before - 1) * 100 : NAN; };
+    printf("%-10s %9s", "vs base", "time");
+    for (int i = 0; i < PerfCounters::COUNTER_COUNT; ++i) {
+        printf(" %13s", PerfCounters::GetName((PerfCounters::Counter)i));
+    }
+    printf("\n");
+    for (const auto &result : results) {
+        auto base = std::find_if(baseline.begin(), baseline.end(),
+                                 [&result](const DemuxBenchmark::Result &b) { return b.name == result.name; });
+        if (base == baseline.end()) {
+            continue;
+        }
+        if (base->inputBytes != result.inputBytes) {
+            printf("%-10s baseline taken on %lu bytes of input, not %lu\n", result.name.c_str(),
+                   (unsigned long)base->inputBytes, (unsigned long)result.inputBytes);
+            continue;
+        }
+        printf("%-10s %9s", result.name.c_str(), FormatNumber(delta(result.seconds, base->seconds), "%+.1f%%").c_str());
+        for (int i = 0; i < PerfCounters::COUNTER_COUNT; ++i) {
+            auto counter = (PerfCounters::Counter)i;
+            printf(" %13s", FormatNumber(delta(result.PerTag(counter), base->PerTag(counter)), "%+.1f%%").c_str());
+        }
+        printf("\n");
+    }
+}
 
-        int preTagSize = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
-        assert(preTagSize == length + sizeof(FlvTagHeader));
-        p += preTagSizeLength; // skip Previous Tag Size
+/// The whole input file mapped, or read into memory when it is a pipe or "-"; nullptr when it is empty or can
+/// not be read
+std::shared_ptr<ByteSource> OpenInput(const char *file) {
+    auto input = ByteSource::Open(file, ByteSource::MAP);
+    if (input && input->GetSize() == 0) {
+        printf("Empty input: %s\n", file);
+        return nullptr;
     }
+    return input;
+}
+
+/// Least time between two key frames the fan-out demux writes out, milliseconds
+static const uint32_t KEY_FRAME_INTERVAL = 10000;
 
-    if (p != end) {
-        printf("Incomplete .flv file\n");
+/// Tags walked back from the end looking for the last key frame
+static const int MAX_TAIL_TAGS = 10000;
+
+/// Duration, last timestamps and last key frame of a file from its tail, one line of JSON
+bool PrintTail(const char *file) {
+    JsonWriter json;
+    json.BeginObject().Key("file").Value(file);
+    auto reader = ReverseTagReader::Open(file);
+    if (!reader) {
+        printf("%s\n", json.Key("error").Value("can not open").EndObject().GetString().c_str());
+        return false;
     }
+
+    ReverseTagReader::Tag tag{};
+    ReverseTagReader::Tag keyFrame{};
+    bool hasKeyFrame = false;
+    bool hasVideo = false;
+    bool hasAudio = false;
+    uint32_t lastVideo = 0;
+    uint32_t lastAudio = 0;
+    uint32_t lastTimestamp = 0;
+    int tags = 0;
+    // a key frame and both streams' last timestamps are near the end, unless a stream is missing altogether
+    while ((!hasKeyFrame && reader->HasVideo()) || (!hasAudio && reader->HasAudio()) || tags == 0) {
+        if (tags == MAX_TAIL_TAGS || !reader->Previous(tag)) {
+            break;
+        }
+        tags++;
+        lastTimestamp = std::max(lastTimestamp, tag.timestamp);
+        if (tag.type == TAG_VIDEO && !hasVideo) {
+            hasVideo = true;
+            lastVideo = tag.timestamp;
+        } else if (tag.type == TAG_AUDIO && !hasAudio) {
+            hasAudio = true;
+            lastAudio = tag.timestamp;
+        }
+        if (tag.keyFrame && !hasKeyFrame) {
+            hasKeyFrame = true;
+            keyFrame = tag;
+        }
+    }
+
+    uint32_t firstTimestamp = 0;
+    bool hasFirst = reader->GetFirstTimestamp(firstTimestamp);
+    json.Key("size").Value(reader->GetFileSize());
+    json.Key("read").Value(reader->GetBytesRead());
+    json.Key("reads").Value(reader->GetReads());
+    json.Key("tailValid").Value((tags > 0 || reader->GetBrokenAt() == 0) && reader->GetTruncatedAt() == 0);
+    if (reader->GetTruncatedAt()) {
+        // what follows the last complete tag, the timestamps below are from before it
+        json.Key("truncatedAt").Value(reader->GetTruncatedAt());
+    }
+    if (reader->GetBrokenAt()) {
+        json.Key("brokenAt").Value(reader->GetBrokenAt());
+    }
+    json.Key("tags").Value(tags);
+    if (tags > 0) {
+        json.Key("lastTimestamp").Value(lastTimestamp);
+        if (hasFirst && lastTimestamp >= firstTimestamp) {
+            json.Key("duration").Value(lastTimestamp - firstTimestamp);
+        }
+    }
+    if (hasVideo) {
+        json.Key("lastVideo").Value(lastVideo);
+    }
+    if (hasAudio) {
+        json.Key("lastAudio").Value(lastAudio);
+    }
+    if (hasKeyFrame) {
+        json.Key("lastKeyFrame").BeginObject();
+        json.Key("timestamp").Value(keyFrame.timestamp).Key("offset").Value(keyFrame.offset);
+        json.EndObject();
+    }
+    json.EndObject();
+    printf("%s\n", json.GetString().c_str());
+    return tags > 0;
 }
 
 int main(int argc, char *argv[]) {
     printf("flv-media\n");
+    // the library is silent, what it has to say about the input is part of this tool's output
+    SetLogCallback([](void *, const char *message) { printf("%s\n", message); }, nullptr);
 
     char operation = 0;
     char *infile = nullptr;
@@ -231,24 +399,29 @@ int main(int argc, char *argv[]) {
 
     if (operation == 'i') {
         printf("info %s\n", infile);
-        auto reader = FileReader::Open(infile);
-        if (reader == nullptr) {
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
             return 1;
         }
-        ParseFlvFile(reader->data, reader->size, nullptr, nullptr);
+        PacketPool packetPool;
+        FlvDemuxer demuxer(packetPool, nullptr);
+        if (!DemuxFile(demuxer, input->GetData(), input->GetSize())) {
+            return 1;
+        }
+        FlvDemuxer::LogVideoInfo(input->GetData(), input->GetSize());
     } else if (operation == 'm') {
         printf("mux %s\n", infile);
     } else if (operation == 'd') {
         printf("demux %s\n", infile);
-        auto reader = FileReader::Open(infile);
-        if (reader == nullptr) {
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
             return 1;
         }
 
         std::string name = std::string(infile);
         std::string prefix =
             name.substr(0, std::string(infile).find_last_of('.')) + '-' + std::to_string(time(nullptr));
-        std::string videoName = prefix + ".h264";
+        std::string videoName = prefix + FlvDemuxer::GetVideoExtension(input->GetData(), input->GetSize());
         std::string audioName = prefix + ".aac";
         auto videoFile = FileWriter::Open(videoName);
         auto audioFile = FileWriter::Open(audioName);
@@ -257,16 +430,550 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
-        ParseFlvFile(
-            reader->data, reader->size,
-            [&](const uint8_t *data, size_t size) {
-                printf("read video frame\n");
-                videoFile->Write(data, size);
+        FrameDropper dropper;
+        PacketPool packetPool;
+        FlvDemuxer demuxer(
+            packetPool,
+            [&](const MediaPacketPtr &packet) {
+                if (packet->stream == TAG_VIDEO) {
+                    printf("read video frame\n");
+                    videoFile->Write(packet->data(), packet->size);
+                } else {
+                    printf("read audio frame\n");
+                    audioFile->Write(packet->data(), packet->size);
+                }
             },
-            [&](const uint8_t *data, size_t size) {
-                printf("read audio frame\n");
-                audioFile->Write(data, size);
+            &dropper);
+        bool ok = DemuxFile(demuxer, input->GetData(), input->GetSize());
+        PrintDropStats(dropper);
+        if (!ok) {
+            return 1;
+        }
+    } else if (operation == 'k') {
+        printf("inject keyframes %s\n", infile);
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
+            return 1;
+        }
+
+        std::string name = std::string(infile);
+        std::string outName =
+            name.substr(0, name.find_last_of('.')) + '-' + std::to_string(time(nullptr)) + ".flv";
+        auto outFile = FileWriter::Open(outName);
+        if (!outFile) {
+            return 1;
+        }
+
+        MetadataInjector injector(input->GetData(), input->GetSize());
+        if (!injector.Scan() || !injector.Inject(*outFile) || !outFile->Close()) {
+            return 1;
+        }
+        printf("write %s\n", outName.c_str());
+    } else if (operation == 'r' && std::string(infile) == "-") {
+        std::string outName = "record-" + std::to_string(time(nullptr)) + ".flv";
+        printf("record stdin to %s\n", outName.c_str());
+
+        bool hasVideo = false;
+        bool hasAudio = false;
+        bool ok = true;
+        std::shared_ptr<Recorder> recorder;
+        VideoConfigurations configs;
+        FrameDropper dropper;
+        auto start = std::chrono::steady_clock::now();
+        uint32_t firstTimestamp = UINT32_MAX;
+        uint32_t mediaTime = 0;
+        FlvTagParser parser(
+            [&](const FLVHeader *header) {
+                hasVideo = header->flagVideo;
+                hasAudio = header->flagAudio;
+            },
+            [&](const FlvTagHeader *tag) {
+                size_t length = tag->GetDataSize();
+                if (!recorder) {
+                    // onMetaData in front of the stream seeds the reserved one
+                    AMFValue metadata(AMF_ECMA_ARRAY);
+                    if (tag->type == TAG_SCRIPT) {
+                        AMFDecoder decoder(tag->data, length);
+                        AMFDecoder::Values values;
+                        AMFStatus status = decoder.Decode(values);
+                        if (!status.Ok()) {
+                            printf("Bad onMetaData: %s\n", status.ToString().c_str());
+                        } else if (values.size() >= 2 &&
+                                   (values[1].Type() == AMF_ECMA_ARRAY || values[1].Type() == AMF_OBJECT)) {
+                            metadata = values[1];
+                        }
+                    }
+                    recorder = Recorder::Open(outName, hasVideo, hasAudio, metadata);
+                    if (!recorder) {
+                        ok = false;
+                        return;
+                    }
+                }
+                if (tag->type != TAG_SCRIPT) {
+                    if (firstTimestamp == UINT32_MAX) {
+                        firstTimestamp = tag->GetTimestamp();
+                    }
+                    // audio often starts a few ms ahead of video, a tag behind the first one must not wrap around
+                    uint32_t timestamp = tag->GetTimestamp();
+                    mediaTime = std::max(mediaTime, timestamp > firstTimestamp ? timestamp - firstTimestamp : 0);
+                }
+
+                FrameClass frameClass;
+                if (tag->type == TAG_VIDEO && ClassifyVideoTag(tag->data, length, configs, frameClass) &&
+                    !dropper.Admit(frameClass)) {
+                    return;
+                }
+                if (tag->type != TAG_SCRIPT && ok) {
+                    ok = recorder->WriteTag(tag->type, tag->GetTimestamp(), tag->data, length);
+                }
             });
+
+        static uint8_t buffer[64 * 1024];
+        ssize_t n;
+        while (ok) {
+            // sampled before reading, the chunk about to be parsed is the backlog
+            dropper.SetPressure(StdinPressure(mediaTime, std::chrono::steady_clock::now() - start));
+            if ((n = read(STDIN_FILENO, buffer, sizeof(buffer))) <= 0) {
+                break;
+            }
+            if (!parser.Push(buffer, n)) {
+                break;
+            }
+        }
+
+        if (parser.GetPending()) {
+            printf("Incomplete tag at end of stream, %zu bytes dropped\n", parser.GetPending());
+        }
+        PrintDropStats(dropper);
+        if (!recorder || !recorder->Close() || !ok) {
+            return 1;
+        }
+        printf("write %s\n", outName.c_str());
+    } else if (operation == 'R') {
+        printf("recover %s\n", infile);
+        if (!Recorder::Recover(infile)) {
+            return 1;
+        }
+    } else if (operation == 'r') {
+        printf("remux %s\n", infile);
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
+            return 1;
+        }
+
+        MetadataInjector scanner(input->GetData(), input->GetSize());
+        if (!scanner.Scan()) {
+            return 1;
+        }
+
+        std::string name = std::string(infile);
+        std::string outName =
+            name.substr(0, name.find_last_of('.')) + '-' + std::to_string(time(nullptr)) + ".flv";
+        auto header = (const FLVHeader *)input->GetData();
+        auto writer = FlvWriter::Open(outName, header->flagVideo, header->flagAudio, scanner.GetMetadata());
+        if (!writer) {
+            return 1;
+        }
+
+        const uint8_t *p = input->GetData() + sizeof(FLVHeader) + 4;
+        const uint8_t *end = input->GetData() + input->GetSize();
+        while (p + sizeof(FlvTagHeader) <= end) {
+            auto tag = (const FlvTagHeader *)p;
+            size_t length = tag->GetDataSize();
+            if (p + sizeof(FlvTagHeader) + length + 4 > end) {
+                printf("Incomplete .flv file\n");
+                break;
+            }
+            if (tag->type != TAG_SCRIPT && !writer->WriteTag(tag->type, tag->GetTimestamp(), tag->data, length)) {
+                return 1;
+            }
+            p += sizeof(FlvTagHeader) + length + 4;
+        }
+
+        if (!writer->Close()) {
+            return 1;
+        }
+        printf("write %s\n", outName.c_str());
+    } else if (operation == 'P') {
+        printf("pipelined demux %s\n", infile);
+        std::string videoExtension;
+        {
+            auto input = OpenInput(infile);
+            if (input == nullptr) {
+                return 1;
+            }
+            videoExtension = FlvDemuxer::GetVideoExtension(input->GetData(), input->GetSize());
+        }
+
+        DemuxPipeline::Options options;
+        if (optind < argc) {
+            char *cpu = argv[optind];
+            for (int i = 0; i < 4 && *cpu; ++i) {
+                options.cpus[i] = (int)strtol(cpu, &cpu, 10);
+                cpu += *cpu == ',';
+            }
+        }
+
+        std::string name = std::string(infile);
+        std::string prefix = name.substr(0, name.find_last_of('.')) + '-' + std::to_string(time(nullptr));
+        auto pipeline = DemuxPipeline::Open(infile, prefix + videoExtension, prefix + ".aac", options);
+        if (!pipeline) {
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = pipeline->Run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const DemuxPipeline::Stats &stats = pipeline->GetStats();
+        printf("%lu bytes, %lu tags, %lu video / %lu audio packets in %.3f s, %.1f MB/s\n",
+               (unsigned long)stats.bytes, (unsigned long)stats.tags, (unsigned long)stats.videoPackets,
+               (unsigned long)stats.audioPackets, seconds, stats.bytes / seconds / 1e6);
+        printf("stalls: reader %lu, parser %lu, video %lu, audio %lu\n", (unsigned long)stats.readerStalls,
+               (unsigned long)stats.parserStalls, (unsigned long)stats.videoStalls,
+               (unsigned long)stats.audioStalls);
+        if (!ok) {
+            return 1;
+        }
+    } else if (operation == 'v') {
+        std::vector<std::string> files;
+        if (std::string(infile) == "-") {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                if (!line.empty()) {
+                    files.push_back(line);
+                }
+            }
+        } else {
+            files.push_back(infile);
+            for (int i = optind; i < argc; ++i) {
+                files.push_back(argv[i]);
+            }
+        }
+
+        uint64_t invalid = 0;
+        FlvValidator::Validate(files, 0, [&invalid](const FlvValidator::Report &report) {
+            invalid += !report.valid;
+            printf("%s\n", report.ToJson().c_str());
+        });
+        printf("validated %lu files, %lu invalid\n", (unsigned long)files.size(), (unsigned long)invalid);
+        if (invalid > 0) {
+            return 1;
+        }
+    } else if (operation == 's') {
+        printf("salvage %s\n", infile);
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
+            return 1;
+        }
+
+        std::string name = std::string(infile);
+        std::string outName =
+            name.substr(0, name.find_last_of('.')) + '-' + std::to_string(time(nullptr)) + ".flv";
+        auto writer = FileWriter::Open(outName, 1024 * 1024);
+        if (!writer) {
+            return 1;
+        }
+
+        FlvSalvager::Report report;
+        auto start = std::chrono::steady_clock::now();
+        if (!FlvSalvager::Salvage(input->GetData(), input->GetSize(), *writer, report)) {
+            return 1;
+        }
+        if (!writer->Close()) {
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%s\n", report.ToJson().c_str());
+        printf("write %s, %lu tags kept, %lu bytes in %lu ranges skipped, %.3f s\n", outName.c_str(),
+               (unsigned long)report.tags, (unsigned long)report.skippedBytes, (unsigned long)report.skipped.size(),
+               seconds);
+    } else if (operation == 't') {
+        bool ok = PrintTail(infile);
+        for (int i = optind; i < argc; ++i) {
+            ok &= PrintTail(argv[i]);
+        }
+        if (!ok) {
+            return 1;
+        }
+    } else if (operation == 'p') {
+        FlvProbe::Report report = FlvProbe::Probe(infile);
+        printf("%s\n", report.ToJson().c_str());
+        if (report.tags == 0) {
+            return 1;
+        }
+    } else if (operation == 'b') {
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
+            return 1;
+        }
+        uint32_t passes = optind < argc ? (uint32_t)std::max(1L, strtol(argv[optind], nullptr, 10)) : 10;
+        auto results = DemuxBenchmark::Run(input->GetData(), input->GetSize(), passes);
+        PrintBenchmark(results);
+
+        // an existing baseline is compared against, a missing one is written
+        if (optind + 1 < argc) {
+            std::vector<DemuxBenchmark::Result> baseline;
+            if (DemuxBenchmark::LoadBaseline(argv[optind + 1], baseline)) {
+                PrintBenchmarkDelta(results, baseline);
+            } else if (DemuxBenchmark::SaveBaseline(argv[optind + 1], results)) {
+                printf("baseline saved to %s\n", argv[optind + 1]);
+            } else {
+                return 1;
+            }
+        }
+    } else if (operation == 'F') {
+        printf("fan-out demux %s\n", infile);
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
+            return 1;
+        }
+
+        std::string name = std::string(infile);
+        std::string prefix = name.substr(0, name.find_last_of('.')) + '-' + std::to_string(time(nullptr));
+        std::string videoExtension = FlvDemuxer::GetVideoExtension(input->GetData(), input->GetSize());
+        auto videoFile = FileWriter::Open(prefix + videoExtension, 1024 * 1024);
+        auto audioFile = FileWriter::Open(prefix + ".aac", 1024 * 1024);
+        if (!videoFile || !audioFile) {
+            return 1;
+        }
+
+        // packets go back to the pool from the consumer threads, so the pool outlives the fan-out
+        PacketPool packetPool;
+        PacketFanOut fanOut;
+        PacketFanOut::ConsumerOptions options;
+        options.name = "flv-video";
+        options.audio = false;
+        fanOut.AddConsumer(options, [&](const MediaPacketPtr &packet) {
+            return videoFile->Write(packet->data(), packet->size);
+        });
+        options.name = "flv-audio";
+        options.video = false;
+        options.audio = true;
+        fanOut.AddConsumer(options, [&](const MediaPacketPtr &packet) {
+            return audioFile->Write(packet->data(), packet->size);
+        });
+        // a thumbnail source, late key frames are worthless so it never holds up the others
+        options.name = "flv-keyframes";
+        options.video = true;
+        options.audio = false;
+        options.keyFramesOnly = true;
+        options.ringSize = 16;
+        options.backpressure = PacketFanOut::BACKPRESSURE_SHED;
+        uint32_t nextKeyFrame = 0;
+        fanOut.AddConsumer(options, [&](const MediaPacketPtr &packet) {
+            if (packet->pts < nextKeyFrame) {
+                return true;
+            }
+            nextKeyFrame = packet->pts + KEY_FRAME_INTERVAL;
+            auto keyFile = FileWriter::Open(prefix + "-key-" + std::to_string(packet->pts) + videoExtension);
+            return keyFile && keyFile->Write(packet->data(), packet->size);
+        });
+
+        fanOut.Start();
+        FlvDemuxer demuxer(packetPool, [&](const MediaPacketPtr &packet) { fanOut.Dispatch(packet); });
+        bool ok = DemuxFile(demuxer, input->GetData(), input->GetSize());
+        ok = fanOut.Finish() && ok;
+        for (const auto &stats : fanOut.GetStats()) {
+            JsonWriter json;
+            json.BeginObject().Key("consumer").Value(stats.name);
+            json.Key("packets").Value(stats.packets).Key("dropped").Value(stats.dropped);
+            json.Key("producerStalls").Value(stats.producerStalls).Key("consumerStalls").Value(stats.consumerStalls);
+            json.Key("failed").Value(stats.failed).EndObject();
+            printf("%s\n", json.GetString().c_str());
+        }
+        if (!ok) {
+            return 1;
+        }
+    } else if (operation == 'f') {
+        printf("follow %s\n", infile);
+        FileFollower::Options options;
+        if (optind < argc) {
+            options.idleTimeout = (int)(strtod(argv[optind], nullptr) * 1000);
+        }
+        auto follower = FileFollower::Open(infile, options);
+        if (!follower) {
+            return 1;
+        }
+
+        std::string name = std::string(infile);
+        std::string prefix = name.substr(0, name.find_last_of('.')) + '-' + std::to_string(time(nullptr));
+        auto audioFile = FileWriter::Open(prefix + ".aac");
+        std::shared_ptr<FileWriter> videoFile; // the codec is known with the first video tag
+        if (!audioFile) {
+            return 1;
+        }
+
+        bool ok = true;
+        bool endOfStream = false;
+        uint64_t tags = 0;
+        PacketPool packetPool;
+        FlvDemuxer demuxer(packetPool, [&](const MediaPacketPtr &packet) {
+            auto &file = packet->stream == TAG_VIDEO ? videoFile : audioFile;
+            if (file) {
+                ok &= file->Write(packet->data(), packet->size);
+            }
+        });
+        FlvTagParser parser(nullptr, [&](const FlvTagHeader *tag) {
+            size_t length = tag->GetDataSize();
+            if (tag->type == TAG_VIDEO && !videoFile) {
+                const char *extension = VideoTagExtension(tag->data, length);
+                videoFile = extension ? FileWriter::Open(prefix + extension) : nullptr;
+                ok &= extension == nullptr || videoFile != nullptr;
+            }
+            demuxer.Demux(tag);
+            tags++;
+            endOfStream |= tag->type == TAG_VIDEO && IsVideoEndOfSequence(tag->data, length);
+        });
+        FileFollower::StopReason reason = follower->Follow([&](const uint8_t *data, size_t size) {
+            if (!parser.Push(data, size)) {
+                ok = false;
+            }
+            // written files are readable right away, like the input they follow
+            ok = audioFile->Flush() && ok;
+            if (videoFile) {
+                ok = videoFile->Flush() && ok;
+            }
+            return ok && !endOfStream;
+        });
+
+        JsonWriter json;
+        json.BeginObject().Key("file").Value(infile);
+        json.Key("stop").Value(endOfStream ? "endOfSequence" : FileFollower::GetStopReasonName(reason));
+        json.Key("bytes").Value(follower->GetOffset()).Key("tags").Value(tags);
+        json.Key("pending").Value(parser.GetPending()).EndObject();
+        printf("%s\n", json.GetString().c_str());
+        if (!ok || reason == FileFollower::STOP_ERROR) {
+            return 1;
+        }
+    } else if (operation == 'c') {
+        std::vector<std::string> roots(argv + optind, argv + argc);
+        if (roots.empty()) {
+            roots.push_back(".");
+        }
+        auto start = std::chrono::steady_clock::now();
+        FlvCatalog::BuildStats stats;
+        if (!FlvCatalog::Build(infile, roots, 0, stats)) {
+            return 1;
+        }
+        JsonWriter json;
+        json.BeginObject().Key("catalog").Value(infile).Key("files").Value(stats.files);
+        json.Key("probed").Value(stats.probed).Key("reused").Value(stats.reused).Key("removed").Value(stats.removed);
+        json.Key("seconds").Value(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        printf("%s\n", json.EndObject().GetString().c_str());
+    } else if (operation == 'q') {
+        auto start = std::chrono::steady_clock::now();
+        auto catalog = FlvCatalog::Open(infile);
+        if (!catalog) {
+            return 1;
+        }
+        std::vector<uint32_t> rows;
+        std::string error;
+        if (!catalog->Select(std::vector<std::string>(argv + optind, argv + argc), rows, error)) {
+            printf("%s\n", error.c_str());
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (uint32_t row : rows) {
+            printf("%s\n", catalog->GetEntry(row).ToJson().c_str());
+        }
+        JsonWriter json;
+        json.BeginObject().Key("rows").Value(catalog->GetRows()).Key("matched").Value(rows.size());
+        printf("%s\n", json.Key("milliseconds").Value(seconds * 1000).EndObject().GetString().c_str());
+    } else if (operation == 'u') {
+        auto input = OpenInput(infile);
+        if (input == nullptr) {
+            return 1;
+        }
+        RtpSender::Options options;
+        if (optind < argc) {
+            std::string address = argv[optind];
+            size_t colon = address.find(':');
+            options.host = address.substr(0, colon);
+            if (colon != std::string::npos) {
+                options.port = (uint16_t)strtoul(address.c_str() + colon + 1, nullptr, 10);
+            }
+        }
+        if (optind + 1 < argc) {
+            options.streams = std::max(1, atoi(argv[optind + 1]));
+        }
+        if (optind + 2 < argc) {
+            options.seconds = strtod(argv[optind + 2], nullptr);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        RtpPacketizer packetizer(input->GetData(), input->GetSize(), RtpPacketizer::Options());
+        double planSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::string name = std::string(infile);
+        std::string sdpName = name.substr(0, name.find_last_of('.')) + ".sdp";
+        auto sdpFile = FileWriter::Open(sdpName);
+        std::string sdp = packetizer.GetSDP(options.host, options.port, options.port + 2);
+        if (!sdpFile || !sdpFile->Write(sdp)) {
+            return 1;
+        }
+        sdpFile.reset();
+        printf("RTP %s to %s:%u, %d streams, %lu packets each play, SDP in %s\n", infile, options.host.c_str(),
+               options.port, options.streams, (unsigned long)packetizer.GetPackets().size(), sdpName.c_str());
+
+        RtpSender::Stats stats;
+        if (!RtpSender::Run(packetizer, options, stats)) {
+            return 1;
+        }
+        JsonWriter json;
+        json.BeginObject().Key("file").Value(infile).Key("streams").Value(options.streams);
+        json.Key("planMilliseconds").Value(planSeconds * 1000).Key("seconds").Value(stats.seconds);
+        json.Key("packets").Value(stats.packets).Key("bytes").Value(stats.bytes).Key("errors").Value(stats.errors);
+        json.Key("sendmmsg").Value(stats.calls);
+        json.Key("packetsPerSecond").Value(stats.seconds > 0 ? stats.packets / stats.seconds : 0.0);
+        json.Key("mbitPerSecond").Value(stats.seconds > 0 ? stats.bytes * 8 / stats.seconds / 1e6 : 0.0);
+        json.Key("maxLateMs").Value(stats.maxLate).Key("meanLateMs").Value(stats.meanLate).EndObject();
+        printf("%s\n", json.GetString().c_str());
+        if (stats.errors > 0) {
+            return 1;
+        }
+    } else if (operation == 'L') {
+        std::vector<std::shared_ptr<ByteSource>> files;
+        std::string names = infile;
+        for (size_t begin = 0, end; begin <= names.size(); begin = end + 1) {
+            end = std::min(names.find(',', begin), names.size());
+            auto input = OpenInput(names.substr(begin, end - begin).c_str());
+            if (input == nullptr) {
+                return 1;
+            }
+            files.push_back(input);
+        }
+        LoadGenerator::Options options;
+        if (optind < argc) {
+            options.streams = std::max(1, atoi(argv[optind]));
+        }
+        if (optind + 1 < argc) {
+            options.seconds = strtod(argv[optind + 1], nullptr);
+        }
+        if (optind + 2 < argc) {
+            options.threads = std::max(1, atoi(argv[optind + 2]));
+        }
+        if (optind + 3 < argc) {
+            options.target = argv[optind + 3];
+        }
+        printf("load %s: %d streams per file, %.1f s, %d threads, to %s\n", infile, options.streams,
+               options.seconds, options.threads, options.target.empty() ? "pipes" : options.target.c_str());
+
+        LoadGenerator::Stats stats;
+        if (!LoadGenerator::Run(files, options, stats)) {
+            return 1;
+        }
+        JsonWriter json;
+        json.BeginObject().Key("files").Value(files.size()).Key("streams").Value(stats.streams);
+        json.Key("failed").Value(stats.failed).Key("seconds").Value(stats.seconds);
+        json.Key("tags").Value(stats.tags).Key("due").Value(stats.due).Key("bytes").Value(stats.bytes);
+        json.Key("stalls").Value(stats.stalls);
+        json.Key("tagsPerSecond").Value(stats.seconds > 0 ? stats.tags / stats.seconds : 0.0);
+        json.Key("mbitPerSecond").Value(stats.seconds > 0 ? stats.bytes * 8 / stats.seconds / 1e6 : 0.0);
+        json.Key("lateUs").BeginObject().Key("mean").Value(stats.meanLate).Key("p50").Value(stats.p50Late);
+        json.Key("p99").Value(stats.p99Late).Key("max").Value(stats.maxLate).EndObject();
+        printf("%s\n", json.EndObject().GetString().c_str());
+        if (stats.failed > 0) {
+            return 1;
+        }
     }
 
     printf("----\n");